@@ -6,6 +6,7 @@
 %token AND OR NOT
 %token DOT2 SLASH C2
 %token INVALID_STRING
+%token SHORTSTRING
 
 %type<string> STRING PARTIALSTRING IDENTIFIER name
 %type<integer> INTEGER INVALID_STRING SLASH
@@ -38,6 +39,7 @@
 %union {
   int64_t         integer;
   const char     *string;
+  char            inl[8];   // of a SHORTSTRING, zero padded
   double          real;
   joqe_ast_expr   expr;
   joqe_ast_path   path;
@@ -199,7 +201,14 @@ name        : IDENTIFIER
 filter      : /* empty */                       {$$ = ast.pefilter(ast.true_value);}
             | expr                              {$$ = ast.pefilter($1);}
             ;
-function    : name '(' params ')'               {$$ = ast.pefunction($1,$3);}
+function    : name '(' params ')'               {
+                                                  const char *msg;
+                                                  $$ = ast.pefunction($1,$3);
+                                                  if(joqe_ast_function_check(&$$, &msg)) {
+                                                    joqe_yyerror(build, msg);
+                                                    return -1;
+                                                  }
+                                                }
             | name '(' ')'                      {$$ = ast.pefunction($1,
                                                   ast.params());}
             ;
@@ -0,0 +1,265 @@
+#include "arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+/* Slabs are all of a size, carved in turn from chunks mapped for the
+   arena and aligned to their size, so the chunk a pointer would be in
+   is had by masking the pointer. Each arena keeps a set of the chunks
+   it has, which tells whether it owns a pointer without looking at the
+   memory it points to, that may not be the arena's. Pages of a chunk
+   take up memory once a slab on them is used. */
+#define CHUNK_SIZE 0x100000
+#define SLAB_SIZE  0x10000
+// slabs are taken up a word at a time, a node takes five.
+#define SLAB_CAP  ((SLAB_SIZE - sizeof(arena_slab)) / sizeof(uint64_t))
+#define WORDS(size) (((size) + sizeof(uint64_t) - 1) / sizeof(uint64_t))
+// words taken in a row at most, see joqe_arena_block.
+#define BLOCK_MAX WORDS(0x100 * sizeof(joqe_nodels))
+
+typedef struct arena_slab {
+  struct arena_slab *nxt;
+  size_t             used;
+  uint64_t           words[];
+} arena_slab;
+
+typedef struct arena_adopted {
+  void  *p;
+  void (*release)(void*);
+} arena_adopted;
+
+struct joqe_arena {
+  arena_slab    *first;
+  arena_slab    *current;
+  arena_adopted *adopted;
+  int            nadopted;
+  int            sadopted;
+  uintptr_t     *chunks; // open addressed, 0 where empty
+  uint32_t       mask;
+  uint32_t       nchunks;
+  uintptr_t      chunk;   // slabs are carved from
+  uint32_t       carved;
+};
+
+// each thread evaluates with an arena of its own, generations are shared
+// as hoisted values may be evaluated from any of them.
+static __thread joqe_arena *current;
+static uint32_t             generation;
+
+static inline void
+next_generation()
+{
+  __atomic_add_fetch(&generation, 1, __ATOMIC_RELAXED);
+}
+
+static void
+release_adopted(joqe_arena *a, int from)
+{
+  for(int i = from; i < a->nadopted; ++i)
+    a->adopted[i].release(a->adopted[i].p);
+  a->nadopted = from;
+}
+
+joqe_arena*
+joqe_arena_create()
+{
+  return calloc(1, sizeof(joqe_arena));
+}
+
+void
+joqe_arena_destroy(joqe_arena *a)
+{
+  if(!a)
+    return;
+  if(current == a)
+    current = 0;
+  release_adopted(a, 0);
+  free(a->adopted);
+  for(uint32_t i = 0; a->nchunks && i <= a->mask; ++i)
+    if(a->chunks[i])
+      munmap((void*)a->chunks[i], CHUNK_SIZE);
+  free(a->chunks);
+  free(a);
+  next_generation();
+}
+
+void
+joqe_arena_reset(joqe_arena *a)
+{
+  release_adopted(a, 0);
+  // slabs are kept for reuse, each is cleared as it's taken up again.
+  if((a->current = a->first))
+    a->first->used = 0;
+  next_generation();
+}
+
+void
+joqe_arena_use(joqe_arena *a)
+{
+  current = a;
+}
+
+static uint32_t
+chunk_hash(uintptr_t chunk)
+{
+  return (uint32_t)(chunk / CHUNK_SIZE * 0x9e3779b97f4a7c15ull >> 32);
+}
+
+static void
+chunk_insert(uintptr_t *chunks, uint32_t mask, uintptr_t chunk)
+{
+  uint32_t at = chunk_hash(chunk) & mask;
+  while(chunks[at])
+    at = (at + 1) & mask;
+  chunks[at] = chunk;
+}
+
+// maps a chunk aligned to its size, one of the chunks of a from now on.
+static uintptr_t
+chunk_map(joqe_arena *a)
+{
+  char *p = mmap(0, 2*CHUNK_SIZE, PROT_READ|PROT_WRITE,
+                 MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+  if(p == MAP_FAILED)
+    abort();
+  uintptr_t chunk = ((uintptr_t)p + CHUNK_SIZE - 1)
+                  & ~(uintptr_t)(CHUNK_SIZE - 1);
+  if(chunk > (uintptr_t)p)
+    munmap(p, chunk - (uintptr_t)p);
+  if(chunk + CHUNK_SIZE < (uintptr_t)p + 2*CHUNK_SIZE)
+    munmap((void*)(chunk + CHUNK_SIZE),
+           (uintptr_t)p + 2*CHUNK_SIZE - (chunk + CHUNK_SIZE));
+
+  if(2*(a->nchunks + 1) > a->mask + 1) {
+    uintptr_t *old = a->chunks;
+    uint32_t size = old ? 2*(a->mask + 1) : 16;
+    a->chunks = calloc(size, sizeof(*a->chunks));
+    a->mask = size - 1;
+    for(uint32_t i = 0; old && i < size/2; ++i)
+      if(old[i])
+        chunk_insert(a->chunks, a->mask, old[i]);
+    free(old);
+  }
+  chunk_insert(a->chunks, a->mask, chunk);
+  a->nchunks++;
+  return chunk;
+}
+
+static arena_slab*
+slab_alloc(joqe_arena *a)
+{
+  if(!a->chunk || a->carved == CHUNK_SIZE / SLAB_SIZE) {
+    a->chunk = chunk_map(a);
+    a->carved = 0;
+  }
+  return (arena_slab*)(a->chunk + SLAB_SIZE * a->carved++);
+}
+
+// count words in a row, count is no more than BLOCK_MAX.
+static void*
+arena_take(joqe_arena *a, size_t count)
+{
+  arena_slab *s = a->current;
+  if(!s || s->used + count > SLAB_CAP) {
+    if(s && s->nxt) {
+      s = s->nxt;
+      s->used = 0;
+    } else {
+      arena_slab *n = slab_alloc(a);
+      n->nxt = 0;
+      n->used = 0;
+      if(s)
+        s->nxt = n;
+      else
+        a->first = n;
+      s = n;
+    }
+    a->current = s;
+  }
+  s->used += count;
+  return &s->words[s->used - count];
+}
+
+joqe_nodels*
+joqe_arena_nodels()
+{
+  if(!current)
+    return calloc(1, sizeof(joqe_nodels));
+  joqe_nodels *n = arena_take(current, WORDS(sizeof(*n)));
+  memset(n, 0, sizeof(*n));
+  return n;
+}
+
+void*
+joqe_arena_block(size_t size)
+{
+  if(!current || WORDS(size) > BLOCK_MAX)
+    return 0;
+  return arena_take(current, WORDS(size));
+}
+
+int
+joqe_arena_owns(const void *p)
+{
+  joqe_arena *a = current;
+  if(!a || !a->nchunks)
+    return 0;
+  uintptr_t chunk = (uintptr_t)p & ~(uintptr_t)(CHUNK_SIZE - 1);
+  for(uint32_t at = chunk_hash(chunk) & a->mask; a->chunks[at];
+      at = (at + 1) & a->mask)
+    if(a->chunks[at] == chunk)
+      return 1;
+  return 0;
+}
+
+int
+joqe_arena_adopt(void *p, void (*release)(void*))
+{
+  joqe_arena *a = current;
+  if(!a)
+    return 0;
+  if(a->nadopted == a->sadopted) {
+    a->sadopted = a->sadopted ? 2*a->sadopted : 16;
+    a->adopted = realloc(a->adopted, sizeof(*a->adopted) * a->sadopted);
+  }
+  a->adopted[a->nadopted++] = (arena_adopted){p, release};
+  return 1;
+}
+
+joqe_arena_pos
+joqe_arena_position()
+{
+  joqe_arena_pos pos = {};
+  if(current) {
+    pos.slab = current->current;
+    pos.used = pos.slab ? pos.slab->used : 0;
+    pos.adopted = current->nadopted;
+  }
+  return pos;
+}
+
+int
+joqe_arena_rewind(joqe_arena_pos pos)
+{
+  joqe_arena *a = current;
+  if(!a)
+    return 0;
+  // what was kept may refer to what's released, as across a reset.
+  if(a->nadopted > pos.adopted) {
+    release_adopted(a, pos.adopted);
+    next_generation();
+  }
+  // later slabs are kept for reuse, as with a reset.
+  if((a->current = pos.slab))
+    pos.slab->used = pos.used;
+  else if((a->current = a->first))
+    a->first->used = 0;
+  return 1;
+}
+
+uint32_t
+joqe_arena_generation()
+{
+  return __atomic_load_n(&generation, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,49 @@
+#ifndef __JOQE_ARENA_H__
+#define __JOQE_ARENA_H__
+
+#include "json.h"
+
+#include <stddef.h>
+
+/* Node storage for the evaluation of one document. While an arena is in
+   use, parsed document nodes, result nodes and the ref count sentinels
+   of lists allocated from it are carved out of the arena. They are never
+   freed one by one, instead the arena is reset in one go once the
+   document and everything evaluated from it is done with. The arena has
+   to stay in use until then, so that nodes released in the meantime are
+   recognized as its own. The arena in use is set per thread. */
+
+typedef struct joqe_arena joqe_arena;
+
+joqe_arena*   joqe_arena_create     ();
+void          joqe_arena_destroy    (joqe_arena *a);
+void          joqe_arena_reset      (joqe_arena *a);
+// use a for node allocations from here on, 0 to go back to the heap.
+void          joqe_arena_use        (joqe_arena *a);
+
+// a zeroed node, from the arena in use or the heap.
+joqe_nodels*  joqe_arena_nodels     ();
+// size bytes in a row, from the arena in use. 0 if none is in use, or if
+// size is too large for it, the caller is then to allocate it.
+void*         joqe_arena_block      (size_t size);
+// whether p was allocated from the arena in use.
+int           joqe_arena_owns       (const void *p);
+// have release(p) called on the next reset, as p belongs with the nodes.
+// Returns 0, leaving p to the caller, when no arena is in use.
+int           joqe_arena_adopt      (void *p, void (*release)(void*));
+/* A point to rewind the arena to, giving back the nodes taken and
+   releasing what was adopted since. */
+typedef struct joqe_arena_pos {
+  struct arena_slab *slab;
+  size_t             used;
+  int                adopted;
+} joqe_arena_pos;
+
+joqe_arena_pos  joqe_arena_position ();
+// returns 0, having done nothing, if no arena is in use.
+int             joqe_arena_rewind   (joqe_arena_pos pos);
+
+// changes with every reset, anything kept across one must be dropped.
+uint32_t      joqe_arena_generation ();
+
+#endif /* idempotent include guard */
@@ -1,4 +1,9 @@
 #include "ast.h"
+#include "nodehash.h"
+#include "keyindex.h"
+#include "arena.h"
+#include "sort.h"
+#include "match.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -8,10 +13,18 @@
 
 #define IMPLODE 0, 0, 0
 
+static void nodevec_take(joqe_nodevec *v, joqe_nodels *ls, joqe_result *r);
+static void fold_take(joqe_fold *f, joqe_nodels *ls, joqe_result *r);
+
 static inline void
 joqe_result_append(joqe_result *r, joqe_nodels *n)
 {
-  joqe_list_append((joqe_list**)&r->ls, &n->ll);
+  if(r->fold)
+    fold_take(r->fold, n, r);
+  else if(r->vec)
+    nodevec_take(r->vec, n, r);
+  else
+    joqe_list_append((joqe_list**)&r->ls, &n->ll);
 }
 
 joqe_nodels*
@@ -22,7 +35,7 @@ joqe_result_alloc_node (joqe_result *r)
     n = (joqe_nodels*)
       joqe_list_detach((joqe_list**)&r->freels, r->freels->ll.n);
   } else {
-    n = malloc(sizeof(joqe_nodels));
+    n = joqe_arena_nodels();
   }
 
   memset(n, 0, sizeof(*n));
@@ -32,6 +45,10 @@ joqe_result_alloc_node (joqe_result *r)
 joqe_node
 joqe_result_copy_node (joqe_node *n)
 {
+  // views are copied as is, the document is never touched.
+  if(JOQE_TYPE_VIEW(n->type))
+    return *n;
+
   switch(JOQE_TYPE_VALUE(n->type)) {
     case joqe_type_none_object:
     case joqe_type_none_array:
@@ -42,8 +59,10 @@ joqe_result_copy_node (joqe_node *n)
         } else {
           // No ref count object implies a ref count of 1. This is the
           // second reference.
+          // lists outside the arena may outlive it, as may their sentinel.
           joqe_nodels refCnt = {.n = {joqe_type_ref_cnt, .u = {.i = 2}}},
-                     *e = malloc(sizeof(*e));
+                     *e = joqe_arena_owns(n->u.ls) ? joqe_arena_nodels()
+                                                   : malloc(sizeof(*e));
 
           *e = refCnt;
           joqe_list_append((joqe_list**)&n->u.ls, &e->ll);
@@ -55,7 +74,7 @@ joqe_result_copy_node (joqe_node *n)
   return copy;
 }
 
-static void
+void
 joqe_result_free_list (joqe_nodels *list, joqe_result *r)
 {
   joqe_nodels *i, *next;
@@ -78,6 +97,9 @@ joqe_result_free_list (joqe_nodels *list, joqe_result *r)
 void
 joqe_result_clear_node (joqe_node n, joqe_result *r)
 {
+  if(JOQE_TYPE_VIEW(n.type))
+    return;
+
   switch(JOQE_TYPE_VALUE(n.type)) {
     case joqe_type_none_object:
     case joqe_type_none_array:
@@ -108,7 +130,7 @@ nodels_free(joqe_nodels *ls)
     fprintf(stderr, "freeing: ");
     switch(JOQE_TYPE_KEY(i->n.type)) {
       case joqe_type_string_none:
-        fprintf(stderr, "'%s': ", i->n.k.key);
+        fprintf(stderr, "'%s': ", joqe_member_key(&i->n));
         break;
       case joqe_type_int_none:
         fprintf(stderr, "%d: ", i->n.k.idx);
@@ -119,7 +141,7 @@ nodels_free(joqe_nodels *ls)
     }
     switch(JOQE_TYPE_VALUE(i->n.type)) {
       case joqe_type_none_string:
-        fprintf(stderr, "%s\n", i->n.u.s);
+        fprintf(stderr, "%s\n", joqe_node_string(&i->n));
         break;
       case joqe_type_none_integer:
         fprintf(stderr, "%d\n", i->n.u.i);
@@ -141,7 +163,8 @@ nodels_free(joqe_nodels *ls)
     }
 #endif
     nxt = (joqe_nodels*) i->ll.n;
-    free(i);
+    if(!joqe_arena_owns(i))
+      free(i);
   } while((i = nxt) != end);
 }
 
@@ -152,7 +175,65 @@ joqe_result_destroy (joqe_result *r)
   nodels_free(r->freels);
 }
 
-static joqe_result
+void
+joqe_nodevec_push(joqe_nodevec *v, joqe_node n)
+{
+  if(v->len == (v->cap ? v->cap : JOQE_NODEVEC_INLINE)) {
+    int cap = v->len * 2;
+    joqe_node *heap = malloc(sizeof(*heap) * cap);
+    memcpy(heap, joqe_nodevec_nodes(v), sizeof(*heap) * v->len);
+    free(v->heap);
+    v->heap = heap;
+    v->cap = cap;
+  }
+  joqe_nodevec_nodes(v)[v->len++] = n;
+}
+
+// moves the nodes of a result list into the vector.
+static void
+nodevec_take(joqe_nodevec *v, joqe_nodels *ls, joqe_result *r)
+{
+  joqe_nodels *i, *next;
+  if((i = ls)) do {
+    next = (joqe_nodels*)i->ll.n;
+    joqe_nodevec_push(v, i->n);
+    i->ll.p = i->ll.n = &i->ll;
+    i->n.type = joqe_type_broken; // the vector owns the value now
+    joqe_result_free_node(i, r);
+  } while((i = next) != ls);
+}
+
+static void
+fold_take(joqe_fold *f, joqe_nodels *ls, joqe_result *r)
+{
+  joqe_nodels *i, *next;
+  if((i = ls)) do {
+    next = (joqe_nodels*)i->ll.n;
+    f->step(f, &i->n);
+    i->ll.p = i->ll.n = &i->ll;
+    joqe_result_free_node(i, r);
+  } while((i = next) != ls);
+}
+
+void
+joqe_nodevec_reset(joqe_nodevec *v, joqe_result *r)
+{
+  joqe_node *x = joqe_nodevec_nodes(v);
+  for(int i = 0; i < v->len; ++i)
+    joqe_result_clear_node(x[i], r);
+  v->len = 0;
+}
+
+void
+joqe_nodevec_destroy(joqe_nodevec *v, joqe_result *r)
+{
+  joqe_nodevec_reset(v, r);
+  free(v->heap);
+  v->heap = 0;
+  v->cap = 0;
+}
+
+joqe_result
 joqe_result_push(joqe_result *r)
 {
   if(r) {
@@ -172,7 +253,7 @@ joqe_result_free_transfer(joqe_result *target, joqe_result *src)
   src->freels = 0;
 }
 
-static void
+void
 joqe_result_pop(joqe_result *base, joqe_result *r)
 {
   if(base) {
@@ -184,23 +265,108 @@ joqe_result_pop(joqe_result *base, joqe_result *r)
   }
 }
 
-static void
-joqe_result_transfer(joqe_result *base, joqe_result *r)
-{
-  joqe_result_append(base, r->ls);
-  r->ls = 0;
+static int
+ord_cmp(const void *a, const void *b)
+{
+  uint32_t x = (*(joqe_nodels**)a)->n.ord,
+           y = (*(joqe_nodels**)b)->n.ord;
+  return x < y ? -1 : x > y;
+}
+
+/* Turn a list of nodes into a set: document nodes are put in document
+   order with duplicates released into r, values that aren't part of the
+   document (ordinal 0) can't be told apart and follow in their original
+   order. Returns the number of nodes left. */
+int
+joqe_result_union(joqe_nodels **ls, joqe_result *r)
+{
+  joqe_nodels *i, *nxt, *rest = 0, *inl[32], **v = inl;
+  int k, count = 0, ids = 0;
+
+  if((i = *ls)) do {
+    count++;
+  } while((i = (joqe_nodels*)i->ll.n) != *ls);
+
+  if(count > sizeof(inl)/sizeof(*inl))
+    v = malloc(sizeof(*v) * count);
+
+  if((i = *ls)) do {
+    nxt = (joqe_nodels*)i->ll.n;
+    i->ll.n = i->ll.p = &i->ll;
+    if(i->n.ord)
+      v[ids++] = i;
+    else
+      joqe_list_append((joqe_list**)&rest, &i->ll);
+  } while((i = nxt) != *ls);
+
+  qsort(v, ids, sizeof(*v), ord_cmp);
+
+  *ls = 0;
+  for(k = 0; k < ids; ++k) {
+    if(k && v[k]->n.ord == v[k-1]->n.ord) {
+      joqe_result_free_node(v[k], r);
+      count--;
+    } else {
+      joqe_list_append((joqe_list**)ls, &v[k]->ll);
+    }
+  }
+  joqe_list_append((joqe_list**)ls, rest ? &rest->ll : 0);
+
+  if(v != inl)
+    free(v);
+  return count;
 }
 
+// whether a producer should go on: in test mode until the first hit, in
+// value mode unless the consumer only wants the first node.
+static inline int
+result_more (joqe_result *r, int found)
+{
+  return r ? !((r->first && (r->ls || (r->vec && r->vec->len)))
+               || (r->fold && r->fold->done))
+           : !found;
+}
 
-static joqe_nodels *
-result_nodels (joqe_result *r, joqe_type type)
+static void
+result_node (joqe_result *r, joqe_node n)
 {
-  joqe_nodels *ls = joqe_result_alloc_node(r);
-  ls->n.type = type;
-  joqe_result_append(r, ls);
-  return ls;
+  if(r->fold) {
+    r->fold->step(r->fold, &n);
+    joqe_result_clear_node(n, r);
+  } else if(r->vec) {
+    joqe_nodevec_push(r->vec, n);
+  } else {
+    joqe_nodels *ls = joqe_result_alloc_node(r);
+    ls->n = n;
+    joqe_list_append((joqe_list**)&r->ls, &ls->ll);
+  }
+}
+
+// hands over count nodes at once, straight into a vector if collecting.
+static void
+result_nodes (joqe_result *r, joqe_node *x, int count)
+{
+  joqe_nodevec *v = r->vec;
+  if(v && !r->fold) {
+    int cap = v->cap ? v->cap : JOQE_NODEVEC_INLINE;
+    if(v->len + count > cap) {
+      while(v->len + count > cap)
+        cap *= 2;
+      joqe_node *heap = malloc(sizeof(*heap) * cap);
+      memcpy(heap, joqe_nodevec_nodes(v), sizeof(*heap) * v->len);
+      free(v->heap);
+      v->heap = heap;
+      v->cap = cap;
+    }
+    memcpy(joqe_nodevec_nodes(v) + v->len, x, sizeof(*x) * count);
+    v->len += count;
+  } else {
+    for(int i = 0; i < count; ++i)
+      result_node(r, x[i]);
+  }
 }
 
+
 static int
 strlscmp(joqe_node l, joqe_node r)
 {
@@ -220,15 +386,16 @@ strlscmp(joqe_node l, joqe_node r)
   if(!ri) { endr = ri = &emptyls; }
   else if(ri->n.type == joqe_type_ref_cnt) { ri = (joqe_nodels*)ri->ll.n; }
 
-  le = strlen(li->n.u.s);
-  re = strlen(ri->n.u.s);
+  le = strlen(joqe_node_string(&li->n));
+  re = strlen(joqe_node_string(&ri->n));
 
   do {
     e = min(le-lo, re-ro);
     assert(e >= 0);
 
     if(e) {
-      if((d = strncmp(li->n.u.s + lo, ri->n.u.s + ro, e)))
+      if((d = strncmp(joqe_node_string(&li->n) + lo,
+                      joqe_node_string(&ri->n) + ro, e)))
         return d;
     }
 
@@ -239,14 +406,14 @@ strlscmp(joqe_node l, joqe_node r)
       lo = 0;
       do {
         li = (joqe_nodels*)li->ll.n;
-        le = (li == endl) ? -1 : strlen(li->n.u.s);
+        le = (li == endl) ? -1 : strlen(joqe_node_string(&li->n));
       } while(le == 0);
     }
     if(ro == re) {
       ro = 0;
       do {
         ri = (joqe_nodels*)ri->ll.n;
-        re = (ri == endr) ? -1 : strlen(ri->n.u.s);
+        re = (ri == endr) ? -1 : strlen(joqe_node_string(&ri->n));
       } while(re == 0);
     }
   } while(le >= 0 && re >= 0);
@@ -314,14 +481,14 @@ ast_binary_implode(joqe_ast_expr *e)
   return 0;
 }
 
-static int
-bool_eval_node(joqe_node rx, joqe_node *n)
+int
+joqe_ast_bool_node(joqe_node rx, joqe_node *n)
 {
   joqe_type v = JOQE_TYPE_VALUE(rx.type);
   switch(JOQE_TYPE_KEY(n->type)) {
     case joqe_type_string_none:
       return (v == joqe_type_none_string
-          && 0 == strcmp(rx.u.s, n->k.key));
+          && 0 == strcmp(joqe_node_string(&rx), joqe_member_key(n)));
     case joqe_type_int_none:
       return (v == joqe_type_none_integer
           && rx.u.i == n->k.idx);
@@ -349,8 +516,8 @@ eval_fix_value(joqe_ast_expr *e, joqe_node *n, joqe_ctx *c, joqe_result *r)
       case 0: t = joqe_type_none_false; break;
       case -1: t = joqe_type_none_null; break;
     }
-    joqe_nodels *ls = result_nodels(r, t);
-    ls->n.u.i = e->u.i;
+    joqe_node x = {t, .u = {.i = e->u.i}};
+    result_node(r, x);
   }
   return e->u.i > 0;
 }
@@ -361,12 +528,12 @@ eval_string_value(joqe_ast_expr *e, joqe_node *n, joqe_ctx *c, joqe_result *r)
   if(!n) return 0;
 
   if(r) {
-    joqe_nodels *ls = result_nodels(r, joqe_type_none_string);
-    ls->n.u.s = e->u.s;
-    return !!*ls->n.u.s;
+    joqe_node x = {joqe_type_none_string, .u = {.s = e->u.s}};
+    result_node(r, x);
+    return !!*e->u.s;
   } else {
     return JOQE_TYPE_KEY(n->type) == joqe_type_string_none
-      && n->k.key && 0 == strcmp(n->k.key, e->u.s);
+      && joqe_member_key(n) && 0 == strcmp(joqe_member_key(n), e->u.s);
   }
 }
 static joqe_ast_expr
@@ -386,14 +553,14 @@ eval_stringls_value(joqe_ast_expr *e, joqe_node *n, joqe_ctx *ctx,
     return 0;
   }
   if(r) {
-    joqe_nodels *ls = result_nodels(r, joqe_type_none_stringls);
-    ls->n = joqe_result_copy_node(&e->u.n);
+    result_node(r, joqe_result_copy_node(&e->u.n));
     return e->u.n.u.ls ? 1 : 0;
   } else {
     /* reversed strlsstrcmp arguments, so result should be negated,
        but it compares to 0 anyway. */
     return JOQE_TYPE_KEY(n->type) == joqe_type_string_none
-      && n->k.key && 0 == strlsstrcmp(e->u.n, n->k.key);
+      && joqe_member_key(n)
+      && 0 == strlsstrcmp(e->u.n, joqe_member_key(n));
   }
 }
 
@@ -425,15 +592,15 @@ eval_integer_value(joqe_ast_expr *e, joqe_node *n, joqe_ctx *c, joqe_result *r)
   if(!n) return 0;
 
   if(r) {
-    joqe_nodels *ls = result_nodels(r, joqe_type_none_integer);
-    ls->n.u.i = e->u.i;
-    return ls->n.u.i;
+    joqe_node x = {joqe_type_none_integer, .u = {.i = e->u.i}};
+    result_node(r, x);
+    return e->u.i != 0;
   } else {
     return JOQE_TYPE_KEY(n->type) == joqe_type_int_none && n->k.idx == e->u.i;
   }
 }
 static joqe_ast_expr
-ast_integer_value(int i)
+ast_integer_value(int64_t i)
 {
   joqe_ast_expr e = {eval_integer_value};
   e.u.i = i;
@@ -446,8 +613,8 @@ eval_real_value(joqe_ast_expr *e, joqe_node *n, joqe_ctx *c, joqe_result *r)
   if(!n) return 0;
 
   if(r) {
-    joqe_nodels *ls = result_nodels(r, joqe_type_none_real);
-    ls->n.u.d = e->u.d;
+    joqe_node x = {joqe_type_none_real, .u = {.d = e->u.d}};
+    result_node(r, x);
   }
   return 0;
 }
@@ -459,6 +626,87 @@ ast_real_value(double d)
   return e;
 }
 
+// --hoisted--
+
+/* A hoisted expression only depends on the context stack, which doesn't
+   change while its owning filter tests the children of a node. It's
+   evaluated once per filter invocation and the result is kept in the
+   cache until the owner's epoch moves on. */
+static joqe_nodevec*
+hoisted_refresh(joqe_ast_expr *e, joqe_node *n, joqe_ctx *c, int value)
+{
+  joqe_ast_expr *x = e->u.h.e;
+  joqe_result *cache = &e->u.h.cache;
+  uint32_t gen = joqe_arena_generation();
+  if(e->u.h.gen != gen) {
+    // the cached nodes were released along with an arena.
+    e->u.h.values->len = 0;
+    cache->ls = cache->freels = 0;
+    e->u.h.gen = gen;
+    e->u.h.epoch = e->u.h.owner->epoch - 1;
+  }
+  if(e->u.h.epoch != e->u.h.owner->epoch) {
+    joqe_nodevec_reset(e->u.h.values, cache);
+    cache->vec = e->u.h.values;
+    e->u.h.rv = x->evaluate(x, n, c, value ? cache : 0);
+    cache->vec = 0;
+    e->u.h.epoch = e->u.h.owner->epoch;
+  }
+  return e->u.h.values;
+}
+
+static int
+eval_hoisted(joqe_ast_expr *e, joqe_node *n, joqe_ctx *c, joqe_result *r)
+{
+  joqe_ast_expr *x = e->u.h.e;
+
+  if(!n) {
+    if(e->u.h.gen == joqe_arena_generation()) {
+      joqe_nodevec_destroy(e->u.h.values, &e->u.h.cache);
+      joqe_result_destroy(&e->u.h.cache);
+    } else {
+      // the cached nodes were released along with an arena.
+      free(e->u.h.values->heap);
+    }
+    free(e->u.h.values);
+    x->evaluate(x, IMPLODE);
+    return ast_expr_free(x);
+  }
+
+  joqe_nodevec *v = hoisted_refresh(e, n, c, r != 0);
+  if(r) {
+    r->status |= e->u.h.cache.status;
+    joqe_node *nodes = joqe_nodevec_nodes(v);
+    for(int i = 0; i < v->len; ++i)
+      result_node(r, joqe_result_copy_node(&nodes[i]));
+  }
+  return e->u.h.rv;
+}
+
+static joqe_ast_expr
+ast_hoisted(joqe_ast_expr e, joqe_ast_pathelem *owner)
+{
+  joqe_ast_expr *ep = ast_expr_alloc(),
+                ne = {eval_hoisted, .u = {.h = {.e = ep, .owner = owner}}};
+  *ep = e;
+  ne.u.h.values = calloc(1, sizeof(joqe_nodevec));
+  return ne;
+}
+
+// evaluate an operand into v, hoisted operands are used straight from the
+// cache.
+static joqe_nodevec*
+operand(joqe_ast_expr *e, joqe_node *n, joqe_ctx *c, joqe_result *r,
+        joqe_nodevec *v)
+{
+  if(e->evaluate == eval_hoisted)
+    return hoisted_refresh(e, n, c, 1);
+  r->vec = v;
+  e->evaluate(e, n, c, r);
+  r->vec = 0;
+  return v;
+}
+
 // --expressions--
 
 static joqe_ast_expr
@@ -476,9 +724,8 @@ ast_binary(joqe_ast_expr_eval eval, joqe_ast_expr l, joqe_ast_expr r)
 static void
 boolean_result(int val, joqe_result *r)
 {
-  joqe_nodels *o = joqe_result_alloc_node(r);
-  o->n.type = val ? joqe_type_none_true : joqe_type_none_false;
-  joqe_result_append(r, o);
+  joqe_node x = {val ? joqe_type_none_true : joqe_type_none_false};
+  result_node(r, x);
 }
 
 static int
@@ -499,8 +746,8 @@ eval_bor (joqe_ast_expr *e,
     joqe_nodels *ls = ir.ls;
     ir.ls = 0;
 
-    if(r)
-      joqe_list_append((joqe_list**) &r->ls, (joqe_list*)ls);
+    if(r && ls)
+      joqe_result_append(r, ls);
   } else {
     rv = rp->evaluate(rp, n, c, r);
   }
@@ -539,299 +786,922 @@ ast_band(joqe_ast_expr l, joqe_ast_expr r)
   return ast_binary(eval_band, l, r);
 }
 
+// --structural equality--
+
+// copies, as the members of a packed record aren't nodes.
 static int
-eval_compare(joqe_ast_expr *e, joqe_node *n, joqe_ctx *c, joqe_result *r)
+fill_members(joqe_node *v, joqe_node *n)
 {
-  joqe_ast_comp_op op = (joqe_ast_comp_op)e->u.b.op;
-
-  joqe_ast_expr *le = e->u.b.l,
-                *re = e->u.b.r;
-  joqe_result lr = joqe_result_push(r);
-  int rv = 0;
-
-  if(!n) return ast_binary_implode(e);
-
-  le->evaluate(le, n, c, &lr);
-  if(lr.ls) {
-    joqe_result rr = joqe_result_push(&lr);
-    re->evaluate(re, n, c, &rr);
-
-    joqe_nodels *li, *ri;
-    if((li = lr.ls)) do {
-      if((ri = rr.ls)) do {
-        int cmp, hit = 0;
-        joqe_node *a = &li->n,
-                  *b = &ri->n;
-
-        joqe_type at = JOQE_TYPE_VALUE(a->type),
-                  bt = JOQE_TYPE_VALUE(b->type);
-        switch(at) {
-          case joqe_type_none_true:
-          case joqe_type_none_false:
-          case joqe_type_none_null:
-            if(op == joqe_ast_comp_eq)
-              rv = (at == bt);
-            else if (op == joqe_ast_comp_neq)
-              rv = (at != bt);
-            break;
-          case joqe_type_none_string: switch(bt) {
-            case joqe_type_none_string:
-              cmp = strcmp(a->u.s, b->u.s);
-              hit = 1;
-              break;
-            case joqe_type_none_stringls:
-              cmp = -strlsstrcmp(*b, a->u.s);
-              hit = 1;
-              break;
-            default:;
-          } break;
-          case joqe_type_none_stringls: switch(bt) {
-            case joqe_type_none_string:
-              cmp = strlsstrcmp(*a, b->u.s);
-              hit = 1;
-              break;
-            case joqe_type_none_stringls:
-              cmp = strlscmp(*a, *b);
-              hit = 1;
-              break;
-            default:;
-          } break;
-          case joqe_type_none_integer: switch(bt) {
-            case joqe_type_none_integer:
-              cmp = a->u.i - b->u.i;
-              hit = 1;
-              break;
-            case joqe_type_none_real: {
-              double d = a->u.i - b->u.d;
-              cmp = d < 0 ? -1 : d > 0 ? 1 : 0;
-              hit = 1;
-            } break;
-            default:;
-          } break;
-          case joqe_type_none_real: switch(bt) {
-            case joqe_type_none_integer: {
-              double d = a->u.d - b->u.i;
-              cmp = d < 0 ? -1 : d > 0 ? 1 : 0;
-              hit = 1;
-            } break;
-            case joqe_type_none_real: {
-              double d = a->u.d - b->u.d;
-              cmp = d < 0 ? -1 : d > 0 ? 1 : 0;
-              hit = 1;
-            } break;
-            default:;
-          } break;
-            //TODO compare objects, arrays?
-          default:;
-        }
-        if(hit) {
-          switch(op) {
-            case joqe_ast_comp_eq: rv = !cmp; break;
-            case joqe_ast_comp_neq: rv = !!cmp; break;
-            case joqe_ast_comp_lt: rv = cmp<0; break;
-            case joqe_ast_comp_lte: rv = cmp<=0; break;
-            case joqe_ast_comp_gt: rv = cmp>0; break;
-            case joqe_ast_comp_gte: rv = cmp>=0; break;
-          }
-        }
-
-        if(rv) goto done;
-      } while((ri = (joqe_nodels*)ri->ll.n) != rr.ls);
-    } while((li = (joqe_nodels*)li->ll.n) != lr.ls);
-
-    done:
-    joqe_result_pop(&lr, &rr);
-  }
-  joqe_result_pop(r, &lr);
+  joqe_members it = joqe_members_of(n);
+  joqe_node *m;
+  int count = 0;
+  while((m = joqe_members_next(&it)))
+    v[count++] = *m;
+  return count;
+}
 
-  if(r) boolean_result(rv, r);
-  return rv;
+static int
+key_cmp(const void *a, const void *b)
+{
+  return strcmp(joqe_member_key(a), joqe_member_key(b));
 }
-static joqe_ast_expr
-ast_bcompare(joqe_ast_comp_op op, joqe_ast_expr l, joqe_ast_expr r)
+
+// a and b have the very same members, as a subtree and itself do.
+static int
+same_members(joqe_node *a, joqe_node *b)
 {
-  joqe_ast_expr b = ast_binary(eval_compare, l, r);
-  b.u.b.op = op;
-  return b;
+  return JOQE_TYPE_PACKED(a->type) == JOQE_TYPE_PACKED(b->type)
+      && a->u.ls == b->u.ls;
 }
 
+#define MEMBERS_INLINE 16
+#define EQUAL_INLINE   16
 
-static joqe_node
-calc_dbl(joqe_ast_calc_op op, double a, double b)
+/* Pairs of containers whose members are being compared. Arrays walk
+   theirs in step, objects have copies sorted by key, kept on a stack of
+   members of their own from at, a's count of them followed by b's. */
+typedef struct {
+  int           array;
+  joqe_members  ia, ib;
+  int           at, count, k;
+} equal_frame;
+
+typedef struct {
+  equal_frame   inl[EQUAL_INLINE], *st;
+  int           sp, cap;
+  joqe_node     minl[2*MEMBERS_INLINE], *m;
+  int           mlen, mcap;
+} equal_walk;
+
+// the members of a and b, containers of a type, to be compared next. 0
+// if they can't be equal, as their counts differ.
+static int
+equal_push(equal_walk *w, joqe_node *a, joqe_node *b)
 {
-  joqe_node rx = {joqe_type_none_real};
-  double d;
+  int count = joqe_members_count(a);
+  if(count != joqe_members_count(b))
+    return 0;
 
-  switch(op) {
-    case joqe_ast_calc_add: d = a + b; break;
-    case joqe_ast_calc_sub: d = a - b; break;
-    case joqe_ast_calc_mult: d = a * b; break;
-    case joqe_ast_calc_div: d = a / b; break;
-    case joqe_ast_calc_mod: d = fmod(a, b); break;
-    default: d = 0;
+  if(w->sp == w->cap) {
+    w->cap *= 2;
+    if(w->st == w->inl) {
+      w->st = malloc(sizeof(*w->st) * w->cap);
+      memcpy(w->st, w->inl, sizeof(w->inl));
+    } else {
+      w->st = realloc(w->st, sizeof(*w->st) * w->cap);
+    }
+  }
+  equal_frame *f = &w->st[w->sp++];
+  if((f->array = JOQE_TYPE_VALUE(a->type) == joqe_type_none_array)) {
+    f->ia = joqe_members_of(a);
+    f->ib = joqe_members_of(b);
+    return 1;
   }
 
-  rx.u.d = d;
-  return rx;
+  if(w->mlen + 2*count > w->mcap) {
+    while(w->mlen + 2*count > w->mcap)
+      w->mcap *= 2;
+    if(w->m == w->minl) {
+      w->m = malloc(sizeof(*w->m) * w->mcap);
+      memcpy(w->m, w->minl, sizeof(*w->m) * w->mlen);
+    } else {
+      w->m = realloc(w->m, sizeof(*w->m) * w->mcap);
+    }
+  }
+  joqe_node *x = w->m + w->mlen, *y = x + count;
+  fill_members(x, a);
+  fill_members(y, b);
+  qsort(x, count, sizeof(*x), key_cmp);
+  qsort(y, count, sizeof(*y), key_cmp);
+  f->at = w->mlen;
+  f->count = count;
+  f->k = 0;
+  w->mlen += 2*count;
+  return 1;
 }
 
-static joqe_node
-calc_int(joqe_ast_calc_op op, int a, int b)
-{
-  joqe_node rx = {joqe_type_none_integer};
-  int i;
+/* Arrays are equal member by member, objects by their members' keys.
+   Pairs of members are compared with a stack of their own rather than
+   recursing, as documents may nest deep. */
+static int
+members_equal(joqe_node *a, joqe_node *b)
+{
+  equal_walk w = {.cap = EQUAL_INLINE, .mcap = 2*MEMBERS_INLINE};
+  joqe_node x, y, *px, *py;
+  int rv;
+
+  w.st = w.inl;
+  w.m = w.minl;
+  rv = equal_push(&w, a, b);
+  while(rv && w.sp) {
+    equal_frame *f = &w.st[w.sp-1];
+    if(f->array) {
+      if(!(px = joqe_members_next(&f->ia))
+         || !(py = joqe_members_next(&f->ib))) {
+        w.sp--;
+        continue;
+      }
+      // copied, as members made in a walk go when the stack is grown.
+      x = *px;
+      y = *py;
+    } else {
+      if(f->k == f->count) {
+        w.mlen = f->at;
+        w.sp--;
+        continue;
+      }
+      x = w.m[f->at + f->k];
+      y = w.m[f->at + f->count + f->k];
+      f->k++;
+      if(strcmp(joqe_member_key(&x), joqe_member_key(&y))) {
+        rv = 0;
+        break;
+      }
+    }
 
-  switch(op) {
-    case joqe_ast_calc_add: i = a + b; break;
-    case joqe_ast_calc_sub: i = a - b; break;
-    case joqe_ast_calc_mult: i = a * b; break;
-    case joqe_ast_calc_div:
-      if(b == 0) return calc_dbl(op, a, b); // div-by-zero -> double inf/nan
-      i = a / b; break;
-    case joqe_ast_calc_mod:
-      if(b == 0) return calc_dbl(op, a, b); // div-by-zero -> double inf/nan
-      i = a % b; break;
-    default: i = 0;
+    joqe_type t = JOQE_TYPE_VALUE(x.type);
+    if(t != joqe_type_none_object && t != joqe_type_none_array)
+      rv = joqe_ast_compare_nodes(joqe_ast_comp_eq, &x, &y);
+    else if(t != JOQE_TYPE_VALUE(y.type))
+      rv = 0;
+    else if(!same_members(&x, &y))
+      rv = equal_push(&w, &x, &y);
   }
 
-  rx.u.i = i;
-  return rx;
+  if(w.st != w.inl)
+    free(w.st);
+  if(w.m != w.minl)
+    free(w.m);
+  return rv;
 }
 
+// hashes are cached for documents, most mismatches end here.
 static int
-eval_calc(joqe_ast_expr *e, joqe_node *n, joqe_ctx *c, joqe_result *r)
+structure_equal(joqe_node *a, joqe_node *b)
 {
-  joqe_ast_calc_op op = (joqe_ast_calc_op)e->u.b.op;
-
-  joqe_ast_expr *le = e->u.b.l,
-                *re = e->u.b.r;
-  joqe_result lr = joqe_result_push(r);
-  int rv = 0;
+  if(same_members(a, b))
+    return 1;
+  if(joqe_node_hashable(a) && joqe_node_hashable(b)
+     && joqe_node_hash(a) != joqe_node_hash(b))
+    return 0;
+  return members_equal(a, b);
+}
+
+int
+joqe_ast_compare_nodes(joqe_ast_comp_op op, joqe_node *a, joqe_node *b)
+{
+  int cmp, hit = 0, rv = 0;
+
+  joqe_type at = JOQE_TYPE_VALUE(a->type),
+            bt = JOQE_TYPE_VALUE(b->type);
+  switch(at) {
+    case joqe_type_none_true:
+    case joqe_type_none_false:
+    case joqe_type_none_null:
+      if(op == joqe_ast_comp_eq)
+        rv = (at == bt);
+      else if (op == joqe_ast_comp_neq)
+        rv = (at != bt);
+      break;
+    case joqe_type_none_string: switch(bt) {
+      case joqe_type_none_string:
+        cmp = strcmp(joqe_node_string(a), joqe_node_string(b));
+        hit = 1;
+        break;
+      case joqe_type_none_stringls:
+        cmp = -strlsstrcmp(*b, joqe_node_string(a));
+        hit = 1;
+        break;
+      default:;
+    } break;
+    case joqe_type_none_stringls: switch(bt) {
+      case joqe_type_none_string:
+        cmp = strlsstrcmp(*a, joqe_node_string(b));
+        hit = 1;
+        break;
+      case joqe_type_none_stringls:
+        cmp = strlscmp(*a, *b);
+        hit = 1;
+        break;
+      default:;
+    } break;
+    case joqe_type_none_integer: switch(bt) {
+      case joqe_type_none_integer:
+        cmp = a->u.i < b->u.i ? -1 : a->u.i > b->u.i ? 1 : 0;
+        hit = 1;
+        break;
+      case joqe_type_none_real: {
+        double d = a->u.i - b->u.d;
+        cmp = d < 0 ? -1 : d > 0 ? 1 : 0;
+        hit = 1;
+      } break;
+      default:;
+    } break;
+    case joqe_type_none_real: switch(bt) {
+      case joqe_type_none_integer: {
+        double d = a->u.d - b->u.i;
+        cmp = d < 0 ? -1 : d > 0 ? 1 : 0;
+        hit = 1;
+      } break;
+      case joqe_type_none_real: {
+        double d = a->u.d - b->u.d;
+        cmp = d < 0 ? -1 : d > 0 ? 1 : 0;
+        hit = 1;
+      } break;
+      default:;
+    } break;
+    case joqe_type_none_object:
+    case joqe_type_none_array:
+      // only equality is defined for objects and arrays.
+      if(at == bt && (op == joqe_ast_comp_eq || op == joqe_ast_comp_neq)) {
+        cmp = !structure_equal(a, b);
+        hit = 1;
+      }
+      break;
+    default:;
+  }
+  if(hit) {
+    switch(op) {
+      case joqe_ast_comp_eq: rv = !cmp; break;
+      case joqe_ast_comp_neq: rv = !!cmp; break;
+      case joqe_ast_comp_lt: rv = cmp<0; break;
+      case joqe_ast_comp_lte: rv = cmp<=0; break;
+      case joqe_ast_comp_gt: rv = cmp>0; break;
+      case joqe_ast_comp_gte: rv = cmp>=0; break;
+    }
+  }
 
-  if(!n) return ast_binary_implode(e);
+  return rv;
+}
 
-  le->evaluate(le, n, c, &lr);
-  if(lr.ls) {
-    joqe_result rr = joqe_result_push(&lr);
-    re->evaluate(re, n, c, &rr);
+// --set comparison--
 
-    if(r) joqe_result_free_transfer(r, &lr);
+/* Comparing node sets is true if any pair of nodes compares true. Small
+   sets are compared pair by pair, larger ones use a hash set for
+   equality, a summary of the right hand side for inequality and the
+   extreme values for ordering, all O(n+m). These rely on the comparison
+   being transitive, which it isn't with NaN (equal to every number) or
+   integers too large to be exactly represented as a double mixed with
+   reals; such sets always take the pairwise route. */
+#define COMPARE_PAIRS_MAX 64
+#define EXACT_INT_MAX     (INT64_C(1) << 53)
 
-    joqe_nodels *li, *ri;
-    if((li = lr.ls)) do {
-      if((ri = rr.ls)) do {
-        joqe_node *a = &li->n,
-                  *b = &ri->n;
-
-        joqe_node rx = {};
-
-        joqe_type at = JOQE_TYPE_VALUE(a->type),
-                  bt = JOQE_TYPE_VALUE(b->type);
-        switch(at) {
-          case joqe_type_none_integer: switch(bt) {
-            case joqe_type_none_integer:
-              rx = calc_int(op, a->u.i, b->u.i);
-              break;
-            case joqe_type_none_real:
-              rx = calc_dbl(op, a->u.i, b->u.d);
-              break;
-            default:
-              continue;
-          } break;
-          case joqe_type_none_real: switch(bt) {
-            case joqe_type_none_integer:
-              rx = calc_dbl(op, a->u.d, b->u.i);
-              break;
-            case joqe_type_none_real:
-              rx = calc_dbl(op, a->u.d, b->u.d);
-              break;
-            default:
-              continue;
-          } break;
-
-
-          default: // can't do calculations using these.
-            continue;
-        }
+typedef struct {
+  int nan;
+  int bigint;
+  int real;
+} set_summary;
 
-        if(r) {
-          rv++;
-          joqe_nodels *o = joqe_result_alloc_node(r);
-          o->n = rx;
-          joqe_result_append(r, o);
-        } else if(bool_eval_node(rx, n)) {
-          rv = 1;
-          goto done;
-        }
-      } while((ri = (joqe_nodels*)ri->ll.n) != rr.ls);
-    } while((li = (joqe_nodels*)li->ll.n) != lr.ls);
-    done:
-    joqe_result_pop(&lr, &rr);
+static set_summary
+summarize(joqe_node *v, int count)
+{
+  set_summary s = {};
+  for(int i = 0; i < count; ++i) {
+    switch(JOQE_TYPE_VALUE(v[i].type)) {
+      case joqe_type_none_integer:
+        if(v[i].u.i > EXACT_INT_MAX || v[i].u.i < -EXACT_INT_MAX)
+          s.bigint = 1;
+        break;
+      case joqe_type_none_real:
+        s.real = 1;
+        if(isnan(v[i].u.d))
+          s.nan = 1;
+        break;
+      case joqe_type_none_object:
+      case joqe_type_none_array:
+        if(!joqe_node_hashable(&v[i]))
+          s.nan = 1;
+        break;
+      default:;
+    }
   }
-  joqe_result_pop(r, &lr);
-  return rv;
+  return s;
 }
 
-static joqe_ast_expr
-ast_calc(joqe_ast_calc_op op, joqe_ast_expr l, joqe_ast_expr r)
+static int
+compare_pairs(joqe_ast_comp_op op, joqe_nodevec *l, joqe_nodevec *r)
 {
-  joqe_ast_expr b = ast_binary(eval_calc, l, r);
-  b.u.b.op = op;
-  return b;
+  joqe_node *lv = joqe_nodevec_nodes(l), *rv = joqe_nodevec_nodes(r);
+  for(int li = 0; li < l->len; ++li)
+    for(int ri = 0; ri < r->len; ++ri)
+      if(joqe_ast_compare_nodes(op, &lv[li], &rv[ri]))
+        return 1;
+  return 0;
 }
 
 static int
-eval_posneg(int mul, joqe_ast_expr *e, joqe_node *n, joqe_ctx *c, joqe_result *r)
+compare_hashed(joqe_nodevec *l, joqe_nodevec *r)
 {
-  joqe_ast_expr *pe = e->u.e;
-  joqe_nodels *i;
   int rv = 0;
 
-  if(!n) return ast_unary_implode(e);
-
-  joqe_result er = joqe_result_push(r);
-
-  pe->evaluate(pe, n, c, &er);
+  // equality is symmetric, hash the smaller side.
+  if(l->len < r->len) {
+    joqe_nodevec *t = l;
+    l = r;
+    r = t;
+  }
 
-  if(r) joqe_result_free_transfer(r, &er);
+  joqe_node *lv = joqe_nodevec_nodes(l), *rvs = joqe_nodevec_nodes(r);
+  joqe_nodeset set = joqe_nodeset_create(r->len);
+  for(int i = 0; i < r->len; ++i)
+    joqe_nodeset_add(&set, &rvs[i]);
 
-  if((i = er.ls)) do {
-    joqe_node *a = &i->n;
-    joqe_node rx = *a;
-    joqe_type t = JOQE_TYPE_VALUE(a->type);
-    switch(t) {
-      case joqe_type_none_integer: rx.u.i = mul * a->u.i; break;
-      case joqe_type_none_real: rx.u.d = mul * a->u.d; break;
-      default:
-        continue;
-    }
+  for(int i = 0; i < l->len && !rv; ++i)
+    rv = !!joqe_nodeset_find(&set, &lv[i]);
 
-    if(r) {
-      rv++;
-      joqe_nodels *o = joqe_result_alloc_node(r);
-      o->n = rx;
-      joqe_result_append(r, o);
-    } else if(bool_eval_node(rx, n)) {
-      rv = 1;
-      goto done;
-    }
-  } while((i = (joqe_nodels*)i->ll.n) != er.ls);
-  done:
-    ;
-  joqe_result_pop(r, &er);
+  joqe_nodeset_destroy(&set);
   return rv;
 }
 
-static int
-eval_positive(joqe_ast_expr *e, joqe_node *n, joqe_ctx *c, joqe_result *r)
+typedef enum {
+  class_fixed,
+  class_string,
+  class_number,
+  class_object,
+  class_array,
+  class_none
+} value_class;
+
+static value_class
+classify(joqe_node *n)
 {
-  return eval_posneg(1, e, n, c, r);
+  switch(JOQE_TYPE_VALUE(n->type)) {
+    case joqe_type_none_true:
+    case joqe_type_none_false:
+    case joqe_type_none_null:
+      return class_fixed;
+    case joqe_type_none_string:
+    case joqe_type_none_stringls:
+      return class_string;
+    case joqe_type_none_integer:
+    case joqe_type_none_real:
+      return class_number;
+    case joqe_type_none_object:
+      return class_object;
+    case joqe_type_none_array:
+      return class_array;
+    default:
+      return class_none;
+  }
 }
 
 static int
-eval_negative(joqe_ast_expr *e, joqe_node *n, joqe_ctx *c, joqe_result *r)
-{
-  return eval_posneg(-1, e, n, c, r);
+compare_unequal(joqe_nodevec *l, joqe_nodevec *r)
+{
+  // for each class on the right: a representative and whether any other
+  // node differs from it.
+  joqe_node *first[class_none] = {};
+  int differs[class_none] = {}, fixed[joqe_type_none_null+1] = {};
+  joqe_node *lv = joqe_nodevec_nodes(l), *rv = joqe_nodevec_nodes(r);
+  value_class k;
+
+  for(int i = 0; i < r->len; ++i) {
+    if((k = classify(&rv[i])) == class_none)
+      continue;
+    if(k == class_fixed)
+      fixed[JOQE_TYPE_VALUE(rv[i].type)]++;
+    if(!first[k])
+      first[k] = &rv[i];
+    else if(!differs[k])
+      differs[k] = joqe_ast_compare_nodes(joqe_ast_comp_neq, first[k], &rv[i]);
+  }
+
+  for(int i = 0; i < l->len; ++i) {
+    switch((k = classify(&lv[i]))) {
+      case class_fixed:
+        // true, false and null are unequal to anything of another type.
+        if(r->len > fixed[JOQE_TYPE_VALUE(lv[i].type)])
+          return 1;
+        break;
+      case class_string:
+      case class_number:
+      case class_object:
+      case class_array:
+        if(first[k] && (differs[k] || joqe_ast_compare_nodes(
+              joqe_ast_comp_neq, &lv[i], first[k])))
+          return 1;
+        break;
+      default:;
+    }
+  }
+  return 0;
+}
+
+// the least (or greatest) node of a class, by the comparison operator
+static joqe_node*
+extreme(joqe_nodevec *v, value_class k, joqe_ast_comp_op op)
+{
+  joqe_node *x = 0, *nodes = joqe_nodevec_nodes(v);
+  for(int i = 0; i < v->len; ++i)
+    if(classify(&nodes[i]) == k
+       && (!x || joqe_ast_compare_nodes(op, &nodes[i], x)))
+      x = &nodes[i];
+  return x;
+}
+
+static int
+compare_extremes(joqe_ast_comp_op op, joqe_nodevec *l, joqe_nodevec *r)
+{
+  int less = op == joqe_ast_comp_lt || op == joqe_ast_comp_lte;
+  value_class k;
+  for(k = class_string; k <= class_number; ++k) {
+    // l < r for some pair iff min(l) < max(r)
+    joqe_node *a = extreme(l, k, less ? joqe_ast_comp_lt : joqe_ast_comp_gt),
+              *b = extreme(r, k, less ? joqe_ast_comp_gt : joqe_ast_comp_lt);
+    if(a && b && joqe_ast_compare_nodes(op, a, b))
+      return 1;
+  }
+  return 0;
+}
+
+/* A single number against many is compared in bulk, in blocks that are
+   each scanned without a branch per node. The outcome of a comparison
+   is a bit per sign of the difference, picked from a mask by op. */
+#define COMPARE_BULK_BLOCK 64
+
+static int
+sign_mask(joqe_ast_comp_op op)
+{
+  // bit 0: less, bit 1: equal, bit 2: greater.
+  switch(op) {
+    case joqe_ast_comp_eq:  return 2;
+    case joqe_ast_comp_neq: return 5;
+    case joqe_ast_comp_lt:  return 1;
+    case joqe_ast_comp_lte: return 3;
+    case joqe_ast_comp_gt:  return 4;
+    case joqe_ast_comp_gte: return 6;
+    default:                return 0;
+  }
+}
+
+// v op s, or s op v if swapped; -1 if v aren't all numbers.
+static int
+compare_bulk(joqe_ast_comp_op op, joqe_node *v, int count, joqe_node *s,
+             int swap)
+{
+  joqe_type st = JOQE_TYPE_VALUE(s->type);
+  int ints = st == joqe_type_none_integer, i;
+  unsigned mask = sign_mask(op);
+
+  if(!ints && st != joqe_type_none_real)
+    return -1;
+  for(i = 0; i < count; ++i) {
+    joqe_type t = JOQE_TYPE_VALUE(v[i].type);
+    if(t == joqe_type_none_real)
+      ints = 0;
+    else if(t != joqe_type_none_integer)
+      return -1;
+  }
+  // s op v is v op' s, with the sign bits mirrored.
+  if(swap)
+    mask = (mask & 2) | (mask & 1) << 2 | (mask & 4) >> 2;
+
+  for(i = 0; i < count; i += COMPARE_BULK_BLOCK) {
+    int end = i + COMPARE_BULK_BLOCK < count ? i + COMPARE_BULK_BLOCK : count;
+    unsigned hit = 0;
+    if(ints) {
+      int64_t b = s->u.i;
+      for(int k = i; k < end; ++k) {
+        int64_t a = v[k].u.i;
+        hit |= mask >> ((a > b) - (a < b) + 1);
+      }
+    } else {
+      double b = st == joqe_type_none_integer ? s->u.i : s->u.d;
+      for(int k = i; k < end; ++k) {
+        double d = (JOQE_TYPE_VALUE(v[k].type) == joqe_type_none_integer
+                    ? v[k].u.i : v[k].u.d) - b;
+        hit |= mask >> ((d > 0) - (d < 0) + 1);
+      }
+    }
+    if(hit & 1)
+      return 1;
+  }
+  return 0;
+}
+
+static int
+compare_vecs(joqe_ast_comp_op op, joqe_nodevec *l, joqe_nodevec *r)
+{
+  if(!l->len || !r->len)
+    return 0;
+
+  set_summary ls = summarize(joqe_nodevec_nodes(l), l->len),
+              rs = summarize(joqe_nodevec_nodes(r), r->len);
+
+  if((l->len == 1) != (r->len == 1) && !ls.nan && !rs.nan
+     && !((ls.bigint || rs.bigint) && (ls.real || rs.real))) {
+    int swap = l->len == 1, rc = swap
+      ? compare_bulk(op, joqe_nodevec_nodes(r), r->len,
+                     joqe_nodevec_nodes(l), 1)
+      : compare_bulk(op, joqe_nodevec_nodes(l), l->len,
+                     joqe_nodevec_nodes(r), 0);
+    if(rc >= 0)
+      return rc;
+  }
+
+  if((int64_t)l->len * r->len <= COMPARE_PAIRS_MAX
+     || l->len == 1 || r->len == 1
+     || ls.nan || rs.nan
+     || ((ls.bigint || rs.bigint) && (ls.real || rs.real)))
+    return compare_pairs(op, l, r);
+
+  switch(op) {
+    case joqe_ast_comp_eq:
+      return compare_hashed(l, r);
+    case joqe_ast_comp_neq:
+      return compare_unequal(l, r);
+    default:
+      return compare_extremes(op, l, r);
+  }
+}
+
+// borrows the nodes of a list, the vector must not be reset.
+static void
+nodevec_borrow(joqe_nodevec *v, joqe_nodels *ls)
+{
+  joqe_nodels *i;
+  if((i = ls)) do {
+    joqe_nodevec_push(v, i->n);
+  } while((i = (joqe_nodels*)i->ll.n) != ls);
+}
+
+int
+joqe_ast_compare_sets(joqe_ast_comp_op op, joqe_nodels *l, joqe_nodels *r)
+{
+  joqe_nodevec lv = {}, rv = {};
+  int rc = 0;
+  if(l && r) {
+    nodevec_borrow(&lv, l);
+    nodevec_borrow(&rv, r);
+    rc = compare_vecs(op, &lv, &rv);
+  }
+  free(lv.heap);
+  free(rv.heap);
+  return rc;
+}
+
+static int
+eval_compare(joqe_ast_expr *e, joqe_node *n, joqe_ctx *c, joqe_result *r)
+{
+  joqe_ast_comp_op op = (joqe_ast_comp_op)e->u.b.op;
+
+  joqe_ast_expr *le = e->u.b.l,
+                *re = e->u.b.r;
+  joqe_result lr = joqe_result_push(r);
+  joqe_nodevec lvec = {}, rvec = {};
+  int rv = 0;
+
+  if(!n) return ast_binary_implode(e);
+
+  joqe_nodevec *lo = operand(le, n, c, &lr, &lvec), *ro;
+  if(lo->len) {
+    ro = operand(re, n, c, &lr, &rvec);
+    rv = compare_vecs(op, lo, ro);
+  }
+  joqe_nodevec_destroy(&lvec, &lr);
+  joqe_nodevec_destroy(&rvec, &lr);
+  joqe_result_pop(r, &lr);
+
+  if(r) boolean_result(rv, r);
+  return rv;
+}
+static joqe_ast_expr
+ast_bcompare(joqe_ast_comp_op op, joqe_ast_expr l, joqe_ast_expr r)
+{
+  joqe_ast_expr b = ast_binary(eval_compare, l, r);
+  b.u.b.op = op;
+  return b;
+}
+
+
+static joqe_node
+calc_dbl(joqe_ast_calc_op op, double a, double b)
+{
+  joqe_node rx = {joqe_type_none_real};
+  double d;
+
+  switch(op) {
+    case joqe_ast_calc_add: d = a + b; break;
+    case joqe_ast_calc_sub: d = a - b; break;
+    case joqe_ast_calc_mult: d = a * b; break;
+    case joqe_ast_calc_div: d = a / b; break;
+    case joqe_ast_calc_mod: d = fmod(a, b); break;
+    default: d = 0;
+  }
+
+  rx.u.d = d;
+  return rx;
+}
+
+static joqe_node
+calc_int(joqe_ast_calc_op op, int64_t a, int64_t b)
+{
+  joqe_node rx = {joqe_type_none_integer};
+  int64_t i;
+  int over = 0;
+
+  switch(op) {
+    case joqe_ast_calc_add: over = __builtin_add_overflow(a, b, &i); break;
+    case joqe_ast_calc_sub: over = __builtin_sub_overflow(a, b, &i); break;
+    case joqe_ast_calc_mult: over = __builtin_mul_overflow(a, b, &i); break;
+    case joqe_ast_calc_div:
+      if(b == 0) return calc_dbl(op, a, b); // div-by-zero -> double inf/nan
+      over = a == INT64_MIN && b == -1;
+      i = over ? 0 : a / b; break;
+    case joqe_ast_calc_mod:
+      if(b == 0) return calc_dbl(op, a, b); // div-by-zero -> double inf/nan
+      i = b == -1 ? 0 : a % b; break; // INT64_MIN % -1 traps
+    default: i = 0;
+  }
+
+  // results out of range are given as reals.
+  if(over)
+    return calc_dbl(op, a, b);
+  rx.u.i = i;
+  return rx;
+}
+
+int
+joqe_ast_calc_nodes(joqe_ast_calc_op op, joqe_node *a, joqe_node *b,
+                    joqe_node *rx)
+{
+  joqe_type at = JOQE_TYPE_VALUE(a->type),
+            bt = JOQE_TYPE_VALUE(b->type);
+  switch(at) {
+    case joqe_type_none_integer: switch(bt) {
+      case joqe_type_none_integer:
+        *rx = calc_int(op, a->u.i, b->u.i);
+        return 1;
+      case joqe_type_none_real:
+        *rx = calc_dbl(op, a->u.i, b->u.d);
+        return 1;
+      default:;
+    } break;
+    case joqe_type_none_real: switch(bt) {
+      case joqe_type_none_integer:
+        *rx = calc_dbl(op, a->u.d, b->u.i);
+        return 1;
+      case joqe_type_none_real:
+        *rx = calc_dbl(op, a->u.d, b->u.d);
+        return 1;
+      default:;
+    } break;
+    default:; // can't do calculations using these.
+  }
+  return 0;
+}
+
+int
+joqe_ast_sign_node(int mul, joqe_node *a, joqe_node *rx)
+{
+  *rx = *a;
+  rx->ord = 0;
+  switch(JOQE_TYPE_VALUE(a->type)) {
+    case joqe_type_none_integer:
+      if(mul < 0 && a->u.i == INT64_MIN) {
+        rx->type = joqe_type_none_real;
+        rx->u.d = -(double)a->u.i;
+      } else {
+        rx->u.i = mul * a->u.i;
+      }
+      return 1;
+    case joqe_type_none_real:
+      rx->u.d = mul * a->u.d;
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+/* One number against many of the same numeric type is calculated in
+   bulk, in a loop per operation rather than a call per pair. Integers
+   that would overflow, or be divided by zero, are left to the pairwise
+   route, which turns them real one at a time. */
+#define CALC_BULK_MIN 16
+
+static int
+calc_bulk_int(joqe_ast_calc_op op, joqe_node *v, int count, int64_t s,
+              int swap, joqe_node *out)
+{
+  int over = 0, i;
+  switch(op) {
+    case joqe_ast_calc_add:
+      for(i = 0; i < count; ++i)
+        over |= __builtin_add_overflow(v[i].u.i, s, &out[i].u.i);
+      break;
+    case joqe_ast_calc_sub:
+      if(swap)
+        for(i = 0; i < count; ++i)
+          over |= __builtin_sub_overflow(s, v[i].u.i, &out[i].u.i);
+      else
+        for(i = 0; i < count; ++i)
+          over |= __builtin_sub_overflow(v[i].u.i, s, &out[i].u.i);
+      break;
+    case joqe_ast_calc_mult:
+      for(i = 0; i < count; ++i)
+        over |= __builtin_mul_overflow(v[i].u.i, s, &out[i].u.i);
+      break;
+    case joqe_ast_calc_div:
+    case joqe_ast_calc_mod:
+      for(i = 0; i < count && !over; ++i) {
+        int64_t a = swap ? s : v[i].u.i, b = swap ? v[i].u.i : s;
+        if(b == 0 || b == -1)
+          over = 1;
+        else
+          out[i].u.i = op == joqe_ast_calc_div ? a / b : a % b;
+      }
+      break;
+    default:
+      return 0;
+  }
+  return !over;
+}
+
+static int
+calc_bulk_real(joqe_ast_calc_op op, joqe_node *v, int count, double s,
+               int swap, joqe_node *out)
+{
+  int integer = JOQE_TYPE_VALUE(v[0].type) == joqe_type_none_integer, i;
+  for(i = 0; i < count; ++i)
+    out[i].u.d = integer ? v[i].u.i : v[i].u.d;
+
+  switch(op) {
+    case joqe_ast_calc_add:
+      for(i = 0; i < count; ++i) out[i].u.d += s;
+      break;
+    case joqe_ast_calc_sub:
+      if(swap)
+        for(i = 0; i < count; ++i) out[i].u.d = s - out[i].u.d;
+      else
+        for(i = 0; i < count; ++i) out[i].u.d -= s;
+      break;
+    case joqe_ast_calc_mult:
+      for(i = 0; i < count; ++i) out[i].u.d *= s;
+      break;
+    case joqe_ast_calc_div:
+      if(swap)
+        for(i = 0; i < count; ++i) out[i].u.d = s / out[i].u.d;
+      else
+        for(i = 0; i < count; ++i) out[i].u.d /= s;
+      break;
+    case joqe_ast_calc_mod:
+      for(i = 0; i < count; ++i)
+        out[i].u.d = swap ? fmod(s, out[i].u.d) : fmod(out[i].u.d, s);
+      break;
+    default:
+      return 0;
+  }
+  return 1;
+}
+
+// v op s (or s op v, swapped) into out, 0 if it can't be done in bulk.
+static int
+calc_bulk(joqe_ast_calc_op op, joqe_node *v, int count, joqe_node *s,
+          int swap, joqe_node *out)
+{
+  joqe_type t = JOQE_TYPE_VALUE(v[0].type),
+            st = JOQE_TYPE_VALUE(s->type);
+  int i;
+
+  if(t != joqe_type_none_integer && t != joqe_type_none_real)
+    return 0;
+  if(st != joqe_type_none_integer && st != joqe_type_none_real)
+    return 0;
+  for(i = 1; i < count; ++i)
+    if(JOQE_TYPE_VALUE(v[i].type) != t)
+      return 0;
+
+  memset(out, 0, sizeof(*out) * count);
+  if(t == joqe_type_none_integer && st == joqe_type_none_integer) {
+    if(!calc_bulk_int(op, v, count, s->u.i, swap, out))
+      return 0;
+  } else {
+    double d = st == joqe_type_none_integer ? s->u.i : s->u.d;
+    if(!calc_bulk_real(op, v, count, d, swap, out))
+      return 0;
+    t = joqe_type_none_real;
+  }
+  for(i = 0; i < count; ++i)
+    out[i].type = t;
+  return 1;
+}
+
+static int
+eval_calc(joqe_ast_expr *e, joqe_node *n, joqe_ctx *c, joqe_result *r)
+{
+  joqe_ast_calc_op op = (joqe_ast_calc_op)e->u.b.op;
+
+  joqe_ast_expr *le = e->u.b.l,
+                *re = e->u.b.r;
+  joqe_result lr = joqe_result_push(r);
+  joqe_nodevec lvec = {}, rvec = {};
+  int rv = 0;
+
+  if(!n) return ast_binary_implode(e);
+
+  joqe_nodevec *lo = operand(le, n, c, &lr, &lvec), *ro;
+  if(lo->len) {
+    ro = operand(re, n, c, &lr, &rvec);
+
+    if(r) joqe_result_free_transfer(r, &lr);
+
+    joqe_node *ln = joqe_nodevec_nodes(lo), *rn = joqe_nodevec_nodes(ro);
+    if(r && !r->first && (lo->len == 1 || ro->len == 1)
+       && lo->len + ro->len > CALC_BULK_MIN) {
+      int swap = lo->len == 1, count = swap ? ro->len : lo->len;
+      joqe_node *x = malloc(sizeof(*x) * count);
+      if(calc_bulk(op, swap ? rn : ln, count, swap ? ln : rn, swap, x)) {
+        result_nodes(r, x, count);
+        rv = count;
+      }
+      free(x);
+      if(rv)
+        goto done;
+    }
+    for(int li = 0; li < lo->len; ++li) {
+      for(int ri = 0; ri < ro->len; ++ri) {
+        joqe_node rx;
+
+        if(!joqe_ast_calc_nodes(op, &ln[li], &rn[ri], &rx))
+          continue;
+
+        if(r) {
+          rv++;
+          result_node(r, rx);
+          if(r->first)
+            goto done;
+        } else if(joqe_ast_bool_node(rx, n)) {
+          rv = 1;
+          goto done;
+        }
+      }
+    }
+    done:
+    ;
+  }
+  joqe_nodevec_destroy(&lvec, &lr);
+  joqe_nodevec_destroy(&rvec, &lr);
+  joqe_result_pop(r, &lr);
+  return rv;
+}
+
+static joqe_ast_expr
+ast_calc(joqe_ast_calc_op op, joqe_ast_expr l, joqe_ast_expr r)
+{
+  joqe_ast_expr b = ast_binary(eval_calc, l, r);
+  b.u.b.op = op;
+  return b;
+}
+
+static int
+eval_posneg(int mul, joqe_ast_expr *e, joqe_node *n, joqe_ctx *c, joqe_result *r)
+{
+  joqe_ast_expr *pe = e->u.e;
+  joqe_nodevec ev = {};
+  int rv = 0;
+
+  if(!n) return ast_unary_implode(e);
+
+  joqe_result er = joqe_result_push(r);
+
+  er.vec = &ev;
+  pe->evaluate(pe, n, c, &er);
+  er.vec = 0;
+
+  if(r) joqe_result_free_transfer(r, &er);
+
+  joqe_node *x = joqe_nodevec_nodes(&ev);
+  for(int i = 0; i < ev.len; ++i) {
+    joqe_node rx;
+    if(!joqe_ast_sign_node(mul, &x[i], &rx))
+      continue;
+
+    if(r) {
+      rv++;
+      result_node(r, rx);
+      if(r->first)
+        goto done;
+    } else if(joqe_ast_bool_node(rx, n)) {
+      rv = 1;
+      goto done;
+    }
+  }
+  done:
+  joqe_nodevec_destroy(&ev, &er);
+  joqe_result_pop(r, &er);
+  return rv;
+}
+
+static int
+eval_positive(joqe_ast_expr *e, joqe_node *n, joqe_ctx *c, joqe_result *r)
+{
+  return eval_posneg(1, e, n, c, r);
+}
+
+static int
+eval_negative(joqe_ast_expr *e, joqe_node *n, joqe_ctx *c, joqe_result *r)
+{
+  return eval_posneg(-1, e, n, c, r);
 }
 
 static joqe_ast_expr
@@ -876,11 +1746,7 @@ eval_not(joqe_ast_expr *e, joqe_node *n, joqe_ctx *c, joqe_result *r)
 
   int rv = !ep->evaluate(ep, n, c, 0);
 
-  if(r) {
-    joqe_nodels *o = joqe_result_alloc_node(r);
-    o->n.type = rv ? joqe_type_none_true : joqe_type_none_false;
-    joqe_result_append(r, o);
-  }
+  if(r) boolean_result(rv, r);
 
   return rv;
 }
@@ -898,8 +1764,8 @@ ast_bnot(joqe_ast_expr e)
 static int
 eval_context(joqe_ast_expr *e, joqe_node *n, joqe_ctx *c, joqe_result *r)
 {
-  joqe_nodels *i;
   joqe_result jr = joqe_result_push(r);
+  joqe_nodevec cv = {};
   int rv = 0;
 
   if(!n) {
@@ -908,13 +1774,18 @@ eval_context(joqe_ast_expr *e, joqe_node *n, joqe_ctx *c, joqe_result *r)
     return ast_expr_free(e->u.c.e);
   }
 
+  jr.vec = &cv;
   e->u.c.ctx.construct(&e->u.c.ctx, n, c, &jr);
+  jr.vec = 0;
 
-  if((i = jr.ls)) do {
-    joqe_ctx stacked = {c, &i->n};
-    rv += e->u.c.e->evaluate(e->u.c.e, &i->n, &stacked, r);
-  } while((i = (joqe_nodels*)i->ll.n) != jr.ls);
+  // nothing is added to cv from here on, its nodes stay put.
+  joqe_node *x = joqe_nodevec_nodes(&cv);
+  for(int i = 0; i < cv.len && result_more(r, rv); ++i) {
+    joqe_ctx stacked = {c, &x[i]};
+    rv += e->u.c.e->evaluate(e->u.c.e, &x[i], &stacked, r);
+  }
 
+  joqe_nodevec_destroy(&cv, &jr);
   joqe_result_pop(r, &jr);
   return rv;
 }
@@ -932,7 +1803,27 @@ ast_expr_context(joqe_ast_expr e, joqe_ast_construct ctx)
 static int
 eval_path(joqe_ast_expr *e, joqe_node *n, joqe_ctx *c, joqe_result *r)
 {
-    return e->u.path.visit(&e->u.path, n, c, r);
+  joqe_ast_path *p = &e->u.path;
+  if(!n || !p->punion)
+    return p->visit(p, n, c, r);
+
+  if(!r) {
+    for(; p; p = p->punion)
+      if(p->visit(p, n, c, 0))
+        return 1;
+    return 0;
+  }
+
+  joqe_result ur = joqe_result_push(r);
+  for(; p; p = p->punion)
+    p->visit(p, n, c, &ur);
+
+  int rv = joqe_result_union(&ur.ls, &ur);
+  if(ur.ls)
+    joqe_result_append(r, ur.ls);
+  ur.ls = 0;
+  joqe_result_pop(r, &ur);
+  return rv;
 }
 
 static joqe_ast_expr
@@ -992,8 +1883,11 @@ ast_path_free(joqe_ast_path *p)
 static joqe_ast_path
 ast_union_path(joqe_ast_path l, joqe_ast_path r)
 {
-  l.punion = ast_path_alloc();
-  *l.punion = r;
+  joqe_ast_path **tail = &l.punion;
+  while(*tail)
+    tail = &(*tail)->punion;
+  *tail = ast_path_alloc();
+  **tail = r;
   return l;
 }
 
@@ -1008,14 +1902,13 @@ visit_local_path (joqe_ast_path *p,
     if(!n)
       ast_pathelem_free(p->pes);
   } else if(n) {
-    if(r) result_nodels(r, n->type)->n = joqe_result_copy_node(n);
+    if(r) result_node(r, joqe_result_copy_node(n));
     v = 1; //bool_eval_node(*n, n); // heh..
   }
-  if(p->punion) {
-    // TODO union the result, not just concatenate.
-    v += p->punion->visit(p->punion, n, c, r);
-    if(!n)
-      ast_path_free(p->punion);
+  if(p->punion && !n) {
+    // union branches are visited by eval_path, this only frees them.
+    p->punion->visit(p->punion, n, c, r);
+    ast_path_free(p->punion);
   }
 
   return v;
@@ -1051,84 +1944,638 @@ visit_context_path (joqe_ast_path *p,
     }
   } else if(n) {
     if(cc) {
-      if(r) result_nodels(r, cc->node->type)->n = *cc->node;
+      if(r) result_node(r, joqe_result_copy_node(cc->node));
       v = 1; //bool_eval_node(*cc, n);
     } else {
       v = 0;
     }
   }
-  if(p->punion) {
-    // TODO union the result, not just concatenate.
-    v += p->punion->visit(p->punion, n, c, r);
-    if(!n)
-      ast_path_free(p->punion);
+  if(p->punion && !n) {
+    // union branches are visited by eval_path, this only frees them.
+    p->punion->visit(p->punion, n, c, r);
+    ast_path_free(p->punion);
+  }
+
+  return v;
+}
+static joqe_ast_path
+ast_context_path(int depth)
+{
+  joqe_ast_path p = {visit_context_path};
+  p.i = depth;
+  return p;
+}
+
+static joqe_ast_path
+ast_path_chain(joqe_ast_path p, joqe_ast_pathelem pe)
+{
+  joqe_ast_pathelem *nxt = ast_pathelem_alloc();
+  *nxt = pe;
+  joqe_list_append((joqe_list**)&p.pes, &nxt->ll);
+  return p;
+}
+
+static int
+visit_pe_free (joqe_ast_pathelem *p, joqe_ast_pathelem *end)
+{
+  if(p->ll.n != &end->ll) {
+    joqe_ast_pathelem *nxt = (joqe_ast_pathelem*) p->ll.n;
+    nxt->visit(nxt, IMPLODE, end);
+    return ast_pathelem_free(nxt);
+  }
+  return 0;
+}
+
+static int
+call_concat (joqe_ast_pathelem *pe,
+             joqe_node *n, joqe_ctx *c,
+             joqe_nodels **ps, joqe_result *r)
+{
+  int pi, pcount = pe->u.func.ps.count;
+
+  joqe_node rn = {joqe_type_none_stringls};
+  for(pi = 0; pi < pcount; ++pi) {
+    joqe_nodels *i;
+    if((i = ps[pi])) do {
+      if (JOQE_TYPE_VALUE(i->n.type) != joqe_type_none_string)
+        continue;
+      joqe_nodels *sn = joqe_result_alloc_node(r);
+      sn->n = joqe_result_copy_node(&i->n);
+      joqe_list_append((joqe_list**)&rn.u.ls, &sn->ll);
+    } while((i = (joqe_nodels*)i->ll.n) != ps[pi]);
+  }
+  if(!rn.u.ls)
+    return 0;
+  result_node(r, rn);
+  return 1;
+}
+
+static int
+call_name (joqe_ast_pathelem *pe,
+           joqe_node *n, joqe_ctx *c,
+           joqe_nodels **ps, joqe_result *r)
+{
+  if(JOQE_TYPE_KEY(n->type) == joqe_type_string_none) {
+      joqe_node x = {joqe_type_none_string, .u = {.s = n->k.key}};
+      // an inline key gives an inline string, it goes with the node too.
+      if(JOQE_TYPE_KEY_INLINE(n->type)) {
+        x.type |= JOQE_TYPE_INLINE_MASK;
+        memcpy(x.u.c, n->k.c, sizeof(x.u.c));
+      }
+      if (r) result_node(r, x);
+      return 1;
+  }
+  return 0;
+}
+
+// evaluates e, folding its values into f as they're produced.
+static void
+fold_values(joqe_ast_expr *e, joqe_node *n, joqe_ctx *c,
+            joqe_result *r, joqe_fold *f)
+{
+  joqe_result fr = joqe_result_push(r);
+  fr.fold = f;
+  if(!f->done)
+    e->evaluate(e, n, c, &fr);
+  fr.fold = 0;
+  joqe_result_pop(r, &fr);
+}
+
+// --aggregates--
+
+/* Aggregates fold the values of their single parameter as they're
+   produced, the values are never collected. count counts all of them,
+   the others only take numbers into account. Integer sums turn real
+   when they'd overflow. */
+typedef struct {
+  joqe_fold fold;
+  int64_t   count;
+  int64_t   numbers;
+  int       real;
+  int64_t   i;
+  double    d;
+  joqe_node min, max;
+} aggregate;
+
+static void
+aggregate_step(joqe_fold *f, joqe_node *n)
+{
+  aggregate *a = (aggregate*)f;
+  int64_t sum;
+  a->count++;
+  switch(JOQE_TYPE_VALUE(n->type)) {
+    case joqe_type_none_integer:
+      if(a->real)
+        a->d += n->u.i;
+      else if(__builtin_add_overflow(a->i, n->u.i, &sum)) {
+        a->real = 1;
+        a->d = (double)a->i + (double)n->u.i;
+      } else
+        a->i = sum;
+      break;
+    case joqe_type_none_real:
+      if(!a->real) {
+        a->real = 1;
+        a->d = a->i;
+      }
+      a->d += n->u.d;
+      break;
+    default:
+      return;
+  }
+
+  joqe_node x = {JOQE_TYPE_VALUE(n->type), .u = n->u};
+  if(!a->numbers++) {
+    a->min = a->max = x;
+  } else {
+    if(joqe_ast_compare_nodes(joqe_ast_comp_lt, &x, &a->min))
+      a->min = x;
+    if(joqe_ast_compare_nodes(joqe_ast_comp_gt, &x, &a->max))
+      a->max = x;
+  }
+}
+
+static int
+aggregate_params(joqe_ast_pathelem *pe,
+                 joqe_node *n, joqe_ctx *c,
+                 joqe_result *r, aggregate *a)
+{
+  if(pe->u.func.ps.count != 1) {
+    r->status |= joqe_result_fail;
+    return 0;
+  }
+
+  a->fold.step = aggregate_step;
+  fold_values(&pe->u.func.ps.ls->e, n, c, r, &a->fold);
+  return 1;
+}
+
+static int
+call_count (joqe_ast_pathelem *pe,
+            joqe_node *n, joqe_ctx *c,
+            joqe_nodels **ps, joqe_result *r)
+{
+  aggregate a = {};
+  if(!aggregate_params(pe, n, c, r, &a))
+    return 0;
+  joqe_node x = {joqe_type_none_integer, .u = {.i = a.count}};
+  result_node(r, x);
+  return 1;
+}
+
+static int
+call_sum (joqe_ast_pathelem *pe,
+          joqe_node *n, joqe_ctx *c,
+          joqe_nodels **ps, joqe_result *r)
+{
+  aggregate a = {};
+  if(!aggregate_params(pe, n, c, r, &a))
+    return 0;
+  joqe_node x = {joqe_type_none_integer, .u = {.i = a.i}};
+  if(a.real) {
+    x.type = joqe_type_none_real;
+    x.u.d = a.d;
+  }
+  result_node(r, x);
+  return 1;
+}
+
+static int
+call_min (joqe_ast_pathelem *pe,
+          joqe_node *n, joqe_ctx *c,
+          joqe_nodels **ps, joqe_result *r)
+{
+  aggregate a = {};
+  if(!aggregate_params(pe, n, c, r, &a) || !a.numbers)
+    return 0;
+  result_node(r, a.min);
+  return 1;
+}
+
+static int
+call_max (joqe_ast_pathelem *pe,
+          joqe_node *n, joqe_ctx *c,
+          joqe_nodels **ps, joqe_result *r)
+{
+  aggregate a = {};
+  if(!aggregate_params(pe, n, c, r, &a) || !a.numbers)
+    return 0;
+  result_node(r, a.max);
+  return 1;
+}
+
+static int
+call_avg (joqe_ast_pathelem *pe,
+          joqe_node *n, joqe_ctx *c,
+          joqe_nodels **ps, joqe_result *r)
+{
+  aggregate a = {};
+  if(!aggregate_params(pe, n, c, r, &a) || !a.numbers)
+    return 0;
+  joqe_node x = {joqe_type_none_real,
+                 .u = {.d = (a.real ? a.d : (double)a.i) / a.numbers}};
+  result_node(r, x);
+  return 1;
+}
+
+// --sorting--
+
+/* sort() and sort_by(k) order the members of the node they're called on,
+   sort(x) and sort_by(x, k) the values of x; sort_by by the first value
+   of k evaluated on each. The result is a new array. */
+
+// the members of an object or array.
+static int
+sort_members(joqe_node *n, joqe_nodels **ls)
+{
+  switch(JOQE_TYPE_VALUE(n->type)) {
+    case joqe_type_none_object:
+    case joqe_type_none_array:
+      *ls = joqe_node_members(n);
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+static joqe_sortitem*
+sort_items(joqe_nodels *ls, int *count)
+{
+  joqe_nodels *i;
+  joqe_sortitem *v;
+  int k = 0;
+
+  if((i = ls)) do {
+    k++;
+  } while((i = (joqe_nodels*)i->ll.n) != ls);
+
+  v = malloc(sizeof(*v) * (k ? k : 1));
+  k = 0;
+  if((i = ls)) do {
+    if(i->n.type == joqe_type_ref_cnt)
+      continue;
+    joqe_sortitem x = {.value = joqe_result_copy_node(&i->n)};
+    v[k++] = x;
+  } while((i = (joqe_nodels*)i->ll.n) != ls);
+  *count = k;
+  return v;
+}
+
+static void
+sorted_result(joqe_sortitem *v, int count, joqe_result *r)
+{
+  joqe_node o = {joqe_type_none_array};
+  for(int k = 0; k < count; ++k) {
+    joqe_nodels *ls = joqe_result_alloc_node(r);
+    ls->n = v[k].value;
+    ls->n.type = JOQE_TYPE(joqe_type_int_none, ls->n.type);
+    ls->n.k.idx = k;
+    ls->n.ord = 0;
+    joqe_list_append((joqe_list**)&o.u.ls, &ls->ll);
+    joqe_result_clear_node(v[k].key, r);
+  }
+  free(v);
+  result_node(r, o);
+}
+
+static int
+call_sort (joqe_ast_pathelem *pe,
+           joqe_node *n, joqe_ctx *c,
+           joqe_nodels **ps, joqe_result *r)
+{
+  int count, pcount = pe->u.func.ps.count;
+  joqe_nodels *ls = pcount ? ps[0] : 0;
+  joqe_sortitem *v;
+
+  if(pcount > 1) {
+    r->status |= joqe_result_fail;
+    return 0;
+  }
+  if(!pcount && !sort_members(n, &ls))
+    return 0;
+
+  v = sort_items(ls, &count);
+  // values are their own keys, only the values are released.
+  for(int k = 0; k < count; ++k)
+    v[k].key = v[k].value;
+  joqe_sort(v, count);
+  for(int k = 0; k < count; ++k)
+    v[k].key.type = joqe_type_broken;
+  sorted_result(v, count, r);
+  return 1;
+}
+
+static int
+call_sort_by (joqe_ast_pathelem *pe,
+              joqe_node *n, joqe_ctx *c,
+              joqe_nodels **ps, joqe_result *r)
+{
+  int count, pcount = pe->u.func.ps.count;
+  joqe_ast_paramls *p = pe->u.func.ps.ls;
+  joqe_nodels *ls = 0;
+  joqe_sortitem *v;
+
+  if(pcount < 1 || pcount > 2) {
+    r->status |= joqe_result_fail;
+    return 0;
+  }
+  if(pcount == 1 && !sort_members(n, &ls))
+    return 0;
+
+  joqe_result xr = joqe_result_push(r);
+  if(pcount == 2) {
+    p->e.evaluate(&p->e, n, c, &xr);
+    p = (joqe_ast_paramls*)p->ll.n;
+    ls = xr.ls;
+  }
+  v = sort_items(ls, &count);
+  joqe_result_pop(r, &xr);
+
+  for(int k = 0; k < count; ++k) {
+    joqe_result kr = joqe_result_push(r);
+    kr.first = 1;
+    p->e.evaluate(&p->e, &v[k].value, c, &kr);
+    if(kr.ls)
+      v[k].key = joqe_result_copy_node(&kr.ls->n);
+    joqe_result_pop(r, &kr);
+  }
+  joqe_sort(v, count);
+  sorted_result(v, count, r);
+  return 1;
+}
+
+// --top k and limit--
+
+/* top(k, key, x) and bottom(k, key, x) give the k values of x with the
+   greatest (least) first value of key, evaluated on each, as an array
+   best first. Only k values are held on to while x is produced.
+   limit(n, x) gives the first n values of x and stops x from producing
+   any more. */
+
+// the count a parameter evaluates to, -1 if it isn't one.
+static int64_t
+param_count(joqe_ast_expr *e, joqe_node *n, joqe_ctx *c, joqe_result *r)
+{
+  int64_t k = -1;
+  joqe_result kr = joqe_result_push(r);
+  kr.first = 1;
+  e->evaluate(e, n, c, &kr);
+  if(kr.ls && JOQE_TYPE_VALUE(kr.ls->n.type) == joqe_type_none_integer
+     && kr.ls->n.u.i >= 0)
+    k = kr.ls->n.u.i;
+  joqe_result_pop(r, &kr);
+  return k;
+}
+
+typedef struct {
+  joqe_fold      fold;
+  joqe_topk      heap;
+  joqe_ast_expr *key;
+  joqe_ctx      *c;
+  joqe_result   *r;
+} topk_fold;
+
+static void
+topk_step(joqe_fold *f, joqe_node *n)
+{
+  topk_fold *t = (topk_fold*)f;
+  joqe_sortitem x = {.value = joqe_result_copy_node(n)}, out;
+  joqe_result kr = joqe_result_push(t->r);
+  kr.first = 1;
+  t->key->evaluate(t->key, n, t->c, &kr);
+  if(kr.ls)
+    x.key = joqe_result_copy_node(&kr.ls->n);
+  joqe_result_pop(t->r, &kr);
+
+  if(joqe_topk_push(&t->heap, &x, &out)) {
+    joqe_result_clear_node(out.key, t->r);
+    joqe_result_clear_node(out.value, t->r);
+  }
+}
+
+static int
+call_topk (joqe_ast_pathelem *pe,
+           joqe_node *n, joqe_ctx *c,
+           joqe_result *r, int least)
+{
+  joqe_ast_paramls *p = pe->u.func.ps.ls;
+  int64_t k;
+  int count;
+
+  if(pe->u.func.ps.count != 3) {
+    r->status |= joqe_result_fail;
+    return 0;
+  }
+  if((k = param_count(&p->e, n, c, r)) < 0)
+    return 0;
+
+  p = (joqe_ast_paramls*)p->ll.n;
+  topk_fold t = {{topk_step, !k}, joqe_topk_create(k, least), &p->e, c, r};
+  p = (joqe_ast_paramls*)p->ll.n;
+  fold_values(&p->e, n, c, r, &t.fold);
+
+  joqe_sortitem *v = joqe_topk_finish(&t.heap, &count);
+  sorted_result(v, count, r);
+  return 1;
+}
+
+static int
+call_top (joqe_ast_pathelem *pe,
+          joqe_node *n, joqe_ctx *c,
+          joqe_nodels **ps, joqe_result *r)
+{
+  return call_topk(pe, n, c, r, 0);
+}
+
+static int
+call_bottom (joqe_ast_pathelem *pe,
+             joqe_node *n, joqe_ctx *c,
+             joqe_nodels **ps, joqe_result *r)
+{
+  return call_topk(pe, n, c, r, 1);
+}
+
+typedef struct {
+  joqe_fold    fold;
+  int64_t      left;
+  joqe_result *r;
+} limit_fold;
+
+static void
+limit_step(joqe_fold *f, joqe_node *n)
+{
+  limit_fold *l = (limit_fold*)f;
+  if(l->left > 0) {
+    result_node(l->r, joqe_result_copy_node(n));
+    l->left--;
+  }
+  f->done = !l->left;
+}
+
+static int
+call_limit (joqe_ast_pathelem *pe,
+            joqe_node *n, joqe_ctx *c,
+            joqe_nodels **ps, joqe_result *r)
+{
+  joqe_ast_paramls *p = pe->u.func.ps.ls;
+  int64_t k;
+
+  if(pe->u.func.ps.count != 2) {
+    r->status |= joqe_result_fail;
+    return 0;
+  }
+  if((k = param_count(&p->e, n, c, r)) < 0)
+    return 0;
+
+  limit_fold l = {{limit_step, !k}, k, r};
+  p = (joqe_ast_paramls*)p->ll.n;
+  fold_values(&p->e, n, c, r, &l.fold);
+  return l.left < k;
+}
+
+// --string predicates--
+
+/* contains, starts_with, ends_with and matches give the string they're
+   called on when any of the strings their parameter evaluates to is found
+   in it (or a pattern matching it, for matches), nothing otherwise. */
+
+typedef int (*string_test) (joqe_ast_pathelem *pe,
+                            const char *s, size_t len,
+                            const char *x, size_t xlen);
+
+// the string of n, joined into *buf (to be freed) if it's in parts.
+static const char*
+flat_string(joqe_node *n, size_t *len, char **buf)
+{
+  joqe_nodels *i;
+  size_t at = 0;
+
+  *buf = 0;
+  switch(JOQE_TYPE_VALUE(n->type)) {
+    case joqe_type_none_string:
+      *len = strlen(joqe_node_string(n));
+      return joqe_node_string(n);
+    case joqe_type_none_stringls:
+      if((i = n->u.ls)) do
+        at += strlen(joqe_node_string(&i->n));
+      while((i = (joqe_nodels*)i->ll.n) != n->u.ls);
+      *buf = malloc(at + 1);
+      *len = at;
+      at = 0;
+      if((i = n->u.ls)) do {
+        size_t l = strlen(joqe_node_string(&i->n));
+        memcpy(*buf + at, joqe_node_string(&i->n), l);
+        at += l;
+      } while((i = (joqe_nodels*)i->ll.n) != n->u.ls);
+      (*buf)[at] = 0;
+      return *buf;
+    default:
+      return 0;
+  }
+}
+
+static int
+call_string_test (joqe_ast_pathelem *pe,
+                  joqe_node *n, joqe_ctx *c,
+                  joqe_nodels **ps, joqe_result *r,
+                  string_test test)
+{
+  const char *s, *x;
+  char *buf, *xbuf;
+  size_t len, xlen;
+  joqe_nodels *i;
+  int hit = 0;
+
+  if(pe->u.func.ps.count != 1) {
+    r->status |= joqe_result_fail;
+    return 0;
   }
+  if(!(s = flat_string(n, &len, &buf)))
+    return 0;
 
-  return v;
+  if((i = ps[0])) do {
+    if((x = flat_string(&i->n, &xlen, &xbuf)))
+      hit = test(pe, s, len, x, xlen);
+    free(xbuf);
+  } while(!hit && (i = (joqe_nodels*)i->ll.n) != ps[0]);
+  free(buf);
+
+  if(hit < 0) {
+    r->status |= joqe_result_fail;
+    return 0;
+  }
+  if(hit && r)
+    result_node(r, joqe_result_copy_node(n));
+  return hit;
 }
-static joqe_ast_path
-ast_context_path(int depth)
+
+static int
+test_contains(joqe_ast_pathelem *pe,
+              const char *s, size_t len, const char *x, size_t xlen)
 {
-  joqe_ast_path p = {visit_context_path};
-  p.i = depth;
-  return p;
+  return !!joqe_strstr(s, len, x, xlen);
 }
 
-static joqe_ast_path
-ast_path_chain(joqe_ast_path p, joqe_ast_pathelem pe)
+static int
+test_starts_with(joqe_ast_pathelem *pe,
+                 const char *s, size_t len, const char *x, size_t xlen)
 {
-  joqe_ast_pathelem *nxt = ast_pathelem_alloc();
-  *nxt = pe;
-  joqe_list_append((joqe_list**)&p.pes, &nxt->ll);
-  return p;
+  return xlen <= len && !memcmp(s, x, xlen);
 }
 
 static int
-visit_pe_free (joqe_ast_pathelem *p, joqe_ast_pathelem *end)
+test_ends_with(joqe_ast_pathelem *pe,
+               const char *s, size_t len, const char *x, size_t xlen)
 {
-  if(p->ll.n != &end->ll) {
-    joqe_ast_pathelem *nxt = (joqe_ast_pathelem*) p->ll.n;
-    nxt->visit(nxt, IMPLODE, end);
-    return ast_pathelem_free(nxt);
+  return xlen <= len && !memcmp(s + len - xlen, x, xlen);
+}
+
+// the last pattern compiled is kept with the call, literal ones are
+// compiled along with the query.
+static int
+test_matches(joqe_ast_pathelem *pe,
+             const char *s, size_t len, const char *x, size_t xlen)
+{
+  joqe_regex **re = &pe->u.func.regex;
+  if(!*re || strcmp(joqe_regex_pattern(*re), x)) {
+    joqe_regex_destroy(*re);
+    *re = joqe_regex_compile(x);
   }
-  return 0;
+  if(!joqe_regex_valid(*re))
+    return -1;
+  return joqe_regex_match(*re, s, len);
 }
 
 static int
-call_concat (joqe_ast_pathelem *pe,
-             joqe_node *n, joqe_ctx *c,
-             joqe_nodels **ps, joqe_result *r)
+call_contains (joqe_ast_pathelem *pe,
+               joqe_node *n, joqe_ctx *c,
+               joqe_nodels **ps, joqe_result *r)
 {
-  int pi, pcount = pe->u.func.ps.count;
+  return call_string_test(pe, n, c, ps, r, test_contains);
+}
 
-  joqe_nodels *rn = result_nodels(r, joqe_type_none_stringls);
-  for(pi = 0; pi < pcount; ++pi) {
-    joqe_nodels *i;
-    if((i = ps[pi])) do {
-      if (JOQE_TYPE_VALUE(i->n.type) != joqe_type_none_string)
-        continue;
-      joqe_nodels *sn = joqe_result_alloc_node(r);
-      sn->n = joqe_result_copy_node(&i->n);
-      joqe_list_append((joqe_list**)&rn->n.u.ls, &sn->ll);
-    } while((i = (joqe_nodels*)i->ll.n) != ps[pi]);
-  }
-  if(!rn->n.u.ls) {
-    joqe_result_free_node(rn, r);
-    return 0;
-  }
-  return 1;
+static int
+call_starts_with (joqe_ast_pathelem *pe,
+                  joqe_node *n, joqe_ctx *c,
+                  joqe_nodels **ps, joqe_result *r)
+{
+  return call_string_test(pe, n, c, ps, r, test_starts_with);
 }
 
 static int
-call_name (joqe_ast_pathelem *pe,
-           joqe_node *n, joqe_ctx *c,
-           joqe_nodels **ps, joqe_result *r)
+call_ends_with (joqe_ast_pathelem *pe,
+                joqe_node *n, joqe_ctx *c,
+                joqe_nodels **ps, joqe_result *r)
 {
-  if(JOQE_TYPE_KEY(n->type) == joqe_type_string_none) {
-      if (r) result_nodels(r, joqe_type_none_string)->n.u.s = n->k.key;
-      return 1;
-  }
-  return 0;
+  return call_string_test(pe, n, c, ps, r, test_ends_with);
+}
+
+static int
+call_matches (joqe_ast_pathelem *pe,
+              joqe_node *n, joqe_ctx *c,
+              joqe_nodels **ps, joqe_result *r)
+{
+  return call_string_test(pe, n, c, ps, r, test_matches);
 }
 
 static int
@@ -1163,17 +2610,28 @@ ast_params_evaluate(joqe_ast_params *p, joqe_node *n, joqe_ctx *c,
   return 0;
 }
 
+int
+joqe_ast_function_check(joqe_ast_pathelem *pe, const char **msg)
+{
+  if(!pe->u.func.regex || joqe_regex_valid(pe->u.func.regex))
+    return 0;
+  *msg = "Invalid regular expression";
+  ast_params_destroy(&pe->u.func.ps);
+  joqe_regex_destroy(pe->u.func.regex);
+  return -1;
+}
+
 static int
 visit_pefunction (joqe_ast_pathelem *p,
                   joqe_node *n, joqe_ctx *c,
                   joqe_result *r, joqe_ast_pathelem *end)
 {
-  joqe_nodels *i, *e;
   int pi, pcount = p->u.func.ps.count;
   int found = 0;
 
   if(!n) {
     ast_params_destroy(&p->u.func.ps);
+    joqe_regex_destroy(p->u.func.regex);
     return visit_pe_free(p, end);
   }
 
@@ -1183,24 +2641,35 @@ visit_pefunction (joqe_ast_pathelem *p,
   }
 
   joqe_nodels **params = alloca(sizeof(joqe_nodels*) * pcount);
-  ast_params_evaluate(&p->u.func.ps, n, c, r, params);
+  if(p->u.func.streamed)
+    memset(params, 0, sizeof(joqe_nodels*) * pcount);
+  else
+    ast_params_evaluate(&p->u.func.ps, n, c, r, params);
 
   joqe_result fr = joqe_result_push(r);
+  joqe_nodevec fv = {};
+  fr.vec = &fv;
   found = p->u.func.call(p, n, c, params, &fr);
+  fr.vec = 0;
 
-  for(pi = 0; pi < pcount; ++pi) joqe_result_free_list(params[pi], r);
+  // r is null under a filter, fr is released in its place.
+  for(pi = 0; pi < pcount; ++pi) joqe_result_free_list(params[pi], &fr);
 
+  joqe_node *x = joqe_nodevec_nodes(&fv);
   if(p->ll.n != &end->ll) {
     found = 0;
-    if((e = i = fr.ls)) do {
+    for(int i = 0; i < fv.len && result_more(r, found); ++i) {
       joqe_ast_pathelem *nxt = (joqe_ast_pathelem*) p->ll.n;
-      found += nxt->visit(nxt, &i->n, c, r, end);
-    } while((!found || r) && (i = (joqe_nodels*)i->ll.n) != e);
-  } else {
-    if(r)
-      joqe_result_transfer(r, &fr);
+      found += nxt->visit(nxt, &x[i], c, r, end);
+    }
+  } else if(r) {
+    // hand the values over as they are.
+    for(int i = 0; i < fv.len; ++i)
+      result_node(r, x[i]);
+    fv.len = 0;
   }
 
+  joqe_nodevec_destroy(&fv, &fr);
   joqe_result_pop(r, &fr);
   return found;
 }
@@ -1211,9 +2680,24 @@ ast_pefunction(const char *name, joqe_ast_params p)
   struct {
     const char *name;
     joqe_function_call call;
+    int streamed;
   } funcs[] = {
     {"concat", call_concat},
     {"name", call_name},
+    {"count", call_count, 1},
+    {"sum", call_sum, 1},
+    {"min", call_min, 1},
+    {"max", call_max, 1},
+    {"avg", call_avg, 1},
+    {"sort", call_sort},
+    {"sort_by", call_sort_by, 1},
+    {"top", call_top, 1},
+    {"bottom", call_bottom, 1},
+    {"limit", call_limit, 1},
+    {"contains", call_contains},
+    {"starts_with", call_starts_with},
+    {"ends_with", call_ends_with},
+    {"matches", call_matches},
     {0}
   }, *f;
 
@@ -1222,35 +2706,128 @@ ast_pefunction(const char *name, joqe_ast_params p)
 
   joqe_ast_pathelem pefunction = {
     .visit = visit_pefunction,
-    .u = {.func = {f->call, p}}
+    .u = {.func = {f->call, p, f->streamed}}
   };
 
+  if(f->call == call_matches && p.count == 1
+     && p.ls->e.evaluate == eval_string_value)
+    pefunction.u.func.regex = joqe_regex_compile(p.ls->e.u.s);
+
   return pefunction;
 }
 
+static int visit_pename   (joqe_ast_pathelem *p,
+                           joqe_node *n, joqe_ctx *c,
+                           joqe_result *r, joqe_ast_pathelem *end);
+static int visit_pefilter (joqe_ast_pathelem *p,
+                           joqe_node *n, joqe_ctx *c,
+                           joqe_result *r, joqe_ast_pathelem *end);
+
+joqe_index*
+joqe_ctx_index(joqe_ctx *c)
+{
+  while(c && !c->index)
+    c = c->stack;
+  return c ? c->index : 0;
+}
+
+// runs nxt over the descendants of n found through the key index, -1 if
+// the index can't answer it and the tree has to be walked.
+static int
+visit_peflex_indexed (joqe_ast_pathelem *nxt,
+                      joqe_node *n, joqe_ctx *c,
+                      joqe_result *r, joqe_ast_pathelem *end,
+                      joqe_index *idx)
+{
+  const char *key;
+  int parents = 0, filter = nxt->visit == visit_pefilter;
+
+  if(nxt->visit == visit_pename)
+    key = nxt->u.key;
+  else if(!filter || !joqe_ast_filter_key(&nxt->u.expr, &key, &parents))
+    return -1;
+  if(!joqe_index_node(idx, n))
+    return -1;
+
+  joqe_node **ls;
+  int count = joqe_index_descendants(idx, n, key, parents, &ls), found = 0;
+
+  if(filter)
+    nxt->epoch++;
+  for(int i = 0; i < count && result_more(r, found); ++i) {
+    if(filter && !nxt->u.expr.evaluate(&nxt->u.expr, ls[i], c, 0))
+      continue;
+    if(nxt->ll.n != &end->ll) {
+      joqe_ast_pathelem *follow = (joqe_ast_pathelem*) nxt->ll.n;
+      found += follow->visit(follow, ls[i], c, r, end);
+    } else {
+      if(r) result_node(r, joqe_result_copy_node(ls[i]));
+      found = 1;
+    }
+  }
+  free(ls);
+  return found;
+}
+
+// descendants left to visit, kept inline while the nesting is shallow.
+#define FLEX_INLINE 16
+
+// the next member of the innermost container that has one left.
+static joqe_node*
+flex_next(joqe_members *st, int *sp)
+{
+  joqe_node *m;
+  for(; *sp; --*sp)
+    if((m = joqe_members_next(&st[*sp-1])))
+      return m;
+  return 0;
+}
+
 static int
 visit_peflex (joqe_ast_pathelem *p,
               joqe_node *n, joqe_ctx *c,
               joqe_result *r, joqe_ast_pathelem *end)
 {
-  joqe_nodels *i, *e;
-  int found = 0;
+  joqe_members inl[FLEX_INLINE], *st = inl;
+  int found = 0, sp = 0, cap = FLEX_INLINE, indexed;
 
   if(!n) return visit_pe_free(p, end);
 
-  if(p->ll.n != &end->ll) {
-    joqe_ast_pathelem *nxt = (joqe_ast_pathelem*) p->ll.n;
-    found += nxt->visit(nxt, n, c, r, end);
-  }
-
-  joqe_type t = JOQE_TYPE_VALUE(n->type);
-  if(t != joqe_type_none_object && t != joqe_type_none_array)
-    return found;
+  joqe_ast_pathelem *nxt = p->ll.n != &end->ll ? (joqe_ast_pathelem*) p->ll.n
+                                               : 0;
+  joqe_index *idx = nxt ? joqe_ctx_index(c) : 0;
 
-  if((!found || r) && (e = i = n->u.ls)) do {
-    found += visit_peflex(p, &i->n, c, r, end);
-  } while((!found || r) && (i = (joqe_nodels*)i->ll.n) != e);
+  // preorder, each node before its members, walked with a stack of its
+  // own rather than recursing as documents may nest deep.
+  do {
+    if(n->ord && idx
+       && (indexed = visit_peflex_indexed(nxt, n, c, r, end, idx)) >= 0) {
+      found += indexed;
+      continue;
+    }
+    if(nxt)
+      found += nxt->visit(nxt, n, c, r, end);
+
+    joqe_type t = JOQE_TYPE_VALUE(n->type);
+    if(t != joqe_type_none_object && t != joqe_type_none_array)
+      continue;
+    // n may be a member made in the stack, taken before it's grown.
+    joqe_members it = joqe_members_of(n);
+    it.shift = joqe_members_shift(n);
+    if(sp == cap) {
+      cap *= 2;
+      if(st == inl) {
+        st = malloc(sizeof(*st) * cap);
+        memcpy(st, inl, sizeof(inl));
+      } else {
+        st = realloc(st, sizeof(*st) * cap);
+      }
+    }
+    st[sp++] = it;
+  } while(result_more(r, found) && (n = flex_next(st, &sp)));
 
+  if(st != inl)
+    free(st);
   return found;
 }
 
@@ -1276,19 +2853,35 @@ visit_pename (joqe_ast_pathelem *p,
   if(JOQE_TYPE_VALUE(n->type) != joqe_type_none_object)
     return 0;
 
+  joqe_node *m, tmp;
+  uint32_t shift = joqe_members_shift(n);
+  switch(joqe_shape_member(n, p->u.key, &p->shape, &m, &tmp)) {
+    case 0:
+      return 0;
+    case 1:
+      m = joqe_member_shifted(m, shift, &tmp);
+      if(p->ll.n != &end->ll) {
+        joqe_ast_pathelem *nxt = (joqe_ast_pathelem*) p->ll.n;
+        return nxt->visit(nxt, m, c, r, end);
+      }
+      if(r) result_node(r, joqe_result_copy_node(m));
+      return 1;
+  }
+
   if((e = i = n->u.ls)) do {
     if (JOQE_TYPE_KEY(i->n.type) == joqe_type_string_none &&
-        0 == strcmp(i->n.k.key, p->u.key))
+        0 == strcmp(joqe_member_key(&i->n), p->u.key))
     {
+      m = joqe_member_shifted(&i->n, shift, &tmp);
       if(p->ll.n != &end->ll) {
         joqe_ast_pathelem *nxt = (joqe_ast_pathelem*) p->ll.n;
-        found += nxt->visit(nxt, &i->n, c, r, end);
+        found += nxt->visit(nxt, m, c, r, end);
       } else {
-        if(r) result_nodels(r, c->node->type)->n = joqe_result_copy_node(&i->n);
+        if(r) result_node(r, joqe_result_copy_node(m));
         found = 1; //bool_eval_node(i->n, n); ?
       }
     }
-  } while((!found || r) && (i = (joqe_nodels*)i->ll.n) != e);
+  } while(result_more(r, found) && (i = (joqe_nodels*)i->ll.n) != e);
 
   return found;
 }
@@ -1303,12 +2896,203 @@ ast_pename(const char *name)
   return pename;
 }
 
+// --columns--
+
+static int path_key(const joqe_ast_path *p, const char **key);
+
+// the column of a path that is a single key, if the records have it.
+static int
+column_path(const joqe_ast_path *p, joqe_columns *cols,
+            struct joqe_column **col)
+{
+  const char *key;
+  if(!path_key(p, &key) || p->pes->ll.n != &p->pes->ll)
+    return 0;
+  *col = joqe_column_of(cols, key);
+  return 1;
+}
+
+static int
+literal_node(const joqe_ast_expr *e, joqe_node *x)
+{
+  joqe_node v = {};
+  if(e->evaluate == eval_integer_value) {
+    v.type = joqe_type_none_integer;
+    v.u.i = e->u.i;
+  } else if(e->evaluate == eval_real_value) {
+    v.type = joqe_type_none_real;
+    v.u.d = e->u.d;
+  } else if(e->evaluate == eval_string_value) {
+    v.type = joqe_type_none_string;
+    v.u.s = e->u.s;
+  } else if(e->evaluate == eval_fix_value) {
+    v.type = e->u.i > 0 ? joqe_type_none_true
+           : e->u.i == 0 ? joqe_type_none_false : joqe_type_none_null;
+  } else {
+    return 0;
+  }
+  *x = v;
+  return 1;
+}
+
+static joqe_ast_comp_op
+flip_op(joqe_ast_comp_op op)
+{
+  switch(op) {
+    case joqe_ast_comp_lt:  return joqe_ast_comp_gt;
+    case joqe_ast_comp_lte: return joqe_ast_comp_gte;
+    case joqe_ast_comp_gt:  return joqe_ast_comp_lt;
+    case joqe_ast_comp_gte: return joqe_ast_comp_lte;
+    default:                return op;
+  }
+}
+
+static int
+int_compare(joqe_ast_comp_op op, int64_t a, int64_t b)
+{
+  switch(op) {
+    case joqe_ast_comp_eq:  return a == b;
+    case joqe_ast_comp_neq: return a != b;
+    case joqe_ast_comp_lt:  return a < b;
+    case joqe_ast_comp_lte: return a <= b;
+    case joqe_ast_comp_gt:  return a > b;
+    case joqe_ast_comp_gte: return a >= b;
+  }
+  return 0;
+}
+
+// sets the bits of the records whose member in col compares true to x.
+static void
+column_compare(joqe_ast_comp_op op, joqe_columns *cols,
+               struct joqe_column *col, joqe_node *x, uint64_t *mask)
+{
+  int xint = JOQE_TYPE_VALUE(x->type) == joqe_type_none_integer;
+  for(int w = 0; w*64 < cols->rows; ++w) {
+    uint64_t bits = 0, valid = col->valid[w];
+    for(; valid; valid &= valid - 1) {
+      int b = __builtin_ctzll(valid);
+      joqe_node tmp, *v = joqe_column_member(cols, col, w*64 + b, &tmp);
+      int rv = xint && JOQE_TYPE_VALUE(v->type) == joqe_type_none_integer
+        ? int_compare(op, v->u.i, x->u.i)
+        : joqe_ast_compare_nodes(op, v, x);
+      bits |= (uint64_t)rv << b;
+    }
+    mask[w] = bits;
+  }
+}
+
+/* Evaluates the filter e for all records at once, into a bit each in
+   mask. Only comparisons of a key to a literal, and 'and' and 'or' of
+   those, are evaluated this way, 0 is returned for anything else. */
+static int
+column_filter(const joqe_ast_expr *e, joqe_columns *cols, uint64_t *mask)
+{
+  int words = (cols->rows + 63) / 64;
+  joqe_ast_expr_eval f = e->evaluate;
+
+  if(f == eval_fix_value) {
+    memset(mask, e->u.i > 0 ? 0xff : 0, words * sizeof(*mask));
+    if(cols->rows % 64)
+      mask[words-1] &= (UINT64_C(1) << (cols->rows % 64)) - 1;
+    return 1;
+  }
+  if(f == eval_band || f == eval_bor) {
+    uint64_t *rm = malloc(words * sizeof(*rm));
+    int ok = column_filter(e->u.b.l, cols, mask)
+          && column_filter(e->u.b.r, cols, rm);
+    for(int w = 0; ok && w < words; ++w)
+      mask[w] = f == eval_band ? mask[w] & rm[w] : mask[w] | rm[w];
+    free(rm);
+    return ok;
+  }
+  if(f != eval_compare)
+    return 0;
+
+  joqe_ast_comp_op op = (joqe_ast_comp_op)e->u.b.op;
+  const joqe_ast_expr *l = e->u.b.l, *r = e->u.b.r;
+  struct joqe_column *col;
+  joqe_node x;
+  if(l->evaluate == eval_path && column_path(&l->u.path, cols, &col)
+     && literal_node(r, &x))
+    ;
+  else if(r->evaluate == eval_path && column_path(&r->u.path, cols, &col)
+          && literal_node(l, &x))
+    op = flip_op(op);
+  else
+    return 0;
+
+  // comparisons against an empty set are false.
+  if(!col)
+    memset(mask, 0, words * sizeof(*mask));
+  else
+    column_compare(op, cols, col, &x, mask);
+  return 1;
+}
+
+/* A filter over the records of an array with columns, see json.h. The
+   filter is evaluated column at a time where it can be, and a key
+   following the filter is taken from its column rather than looked up
+   in each record. -1 if neither applies. */
+static int
+visit_pefilter_columns (joqe_ast_pathelem *p, joqe_node *n,
+                        joqe_columns *cols, joqe_ctx *c, joqe_result *r,
+                        joqe_ast_pathelem *end)
+{
+  joqe_ast_pathelem *nxt = 0, *follow = 0;
+  struct joqe_column *col = 0;
+  int found = 0, bulk, project = 0;
+
+  if(p->ll.n != &end->ll) {
+    nxt = (joqe_ast_pathelem*) p->ll.n;
+    if((project = nxt->visit == visit_pename)) {
+      // no record has the key.
+      if(!(col = joqe_column_of(cols, nxt->u.key)))
+        return 0;
+      if(nxt->ll.n != &end->ll)
+        follow = (joqe_ast_pathelem*) nxt->ll.n;
+    }
+  }
+
+  uint64_t *mask = malloc((cols->rows + 63) / 64 * sizeof(*mask));
+  if(!(bulk = column_filter(&p->u.expr, cols, mask)) && !project) {
+    free(mask);
+    return -1;
+  }
+
+  uint32_t shift = joqe_members_shift(n);
+  for(int k = 0; k < cols->rows && result_more(r, found); ++k) {
+    joqe_node row, *m = joqe_member_shifted(cols->row[k], shift, &row), tmp;
+    if(bulk ? !(mask[k / 64] >> (k % 64) & 1)
+            : !p->u.expr.evaluate(&p->u.expr, m, c, 0))
+      continue;
+    if(project) {
+      if(!(col->valid[k / 64] >> (k % 64) & 1))
+        continue;
+      m = joqe_member_shifted(joqe_column_member(cols, col, k, &tmp),
+                              joqe_members_shift(m), &tmp);
+      if(follow) {
+        found += follow->visit(follow, m, c, r, end);
+      } else {
+        if(r) result_node(r, joqe_result_copy_node(m));
+        found++;
+      }
+    } else if(nxt) {
+      found += nxt->visit(nxt, m, c, r, end);
+    } else {
+      if(r) result_node(r, joqe_result_copy_node(m));
+      found = 1;
+    }
+  }
+
+  free(mask);
+  return found;
+}
+
 static int
 visit_pefilter (joqe_ast_pathelem *p,
                 joqe_node *n, joqe_ctx *c,
                 joqe_result *r, joqe_ast_pathelem *end)
 {
-  joqe_nodels *i, *e;
   int found = 0;
 
   if(!n) {
@@ -1320,17 +3104,40 @@ visit_pefilter (joqe_ast_pathelem *p,
   if(t != joqe_type_none_object && t != joqe_type_none_array)
     return 0;
 
-  if((e = i = n->u.ls)) do {
-    if (p->u.expr.evaluate(&p->u.expr, &i->n, c, 0)) {
+  // invalidates expressions hoisted out of this filter
+  p->epoch++;
+
+  joqe_columns *cols;
+  if((cols = joqe_node_columns(n))
+     && (found = visit_pefilter_columns(p, n, cols, c, r, end)) >= 0)
+    return found;
+  found = 0;
+
+  joqe_members it = joqe_members_of(n);
+  joqe_node *m;
+  int single = 0;
+  it.shift = joqe_members_shift(n);
+  if(it.p && p->u.expr.evaluate == eval_integer_value) {
+    // an index into a packed array goes straight to the member.
+    if(p->u.expr.u.i < 0 || p->u.expr.u.i >= it.p->count)
+      return 0;
+    it.k = p->u.expr.u.i;
+    single = 1;
+  }
+
+  while(result_more(r, found) && (m = joqe_members_next(&it))) {
+    if (p->u.expr.evaluate(&p->u.expr, m, c, 0)) {
       if(p->ll.n != &end->ll) {
         joqe_ast_pathelem *nxt = (joqe_ast_pathelem*) p->ll.n;
-        found += nxt->visit(nxt, &i->n, c, r, end);
+        found += nxt->visit(nxt, m, c, r, end);
       } else {
-        if(r) result_nodels(r, c->node->type)->n = joqe_result_copy_node(&i->n);
+        if(r) result_node(r, joqe_result_copy_node(m));
         found = 1;//bool_eval_node(i->n, n); ?
       }
     }
-  } while((!found || r) && (i = (joqe_nodels*)i->ll.n) != e);
+    if(single)
+      break;
+  }
 
   return found;
 }
@@ -1390,6 +3197,83 @@ ast_expr_construct(joqe_ast_expr e)
   return c;
 }
 
+/* Keys given as string fragments, such as 'a''b', are joined. Those too
+   long to go inline are kept by the entry until it's freed; a key that
+   is the same as the last one joined is shared with it. */
+struct joqe_ast_joined {
+  struct joqe_ast_joined *nxt;
+  char                    s[];
+};
+
+static size_t
+join_fragments(joqe_nodels *ls, char *to)
+{
+  joqe_nodels *i;
+  size_t len = 0;
+  if((i = ls)) do {
+    if(i->n.type == joqe_type_ref_cnt)
+      continue;
+    switch(JOQE_TYPE_VALUE(i->n.type)) {
+      case joqe_type_none_string: {
+        const char *s = joqe_node_string(&i->n);
+        size_t l = strlen(s);
+        if(to)
+          memcpy(to + len, s, l);
+        len += l;
+      } break;
+      case joqe_type_none_stringls:
+        len += join_fragments(i->n.u.ls, to ? to + len : 0);
+        break;
+      default:;
+    }
+  } while((i = (joqe_nodels*)i->ll.n) != ls);
+  return len;
+}
+
+int
+joqe_ast_entry_key(joqe_ast_construct *en, joqe_node *k, joqe_node *key)
+{
+  switch(JOQE_TYPE_VALUE(k->type)) {
+    case joqe_type_none_string:
+      *key = *k;
+      return 1;
+    case joqe_type_none_stringls:
+      break;
+    default:
+      //TODO design consideration, currently: key is non-string: skip entry
+      //Optionally: int/real -> render string?
+      return 0;
+  }
+
+  size_t len = join_fragments(k->u.ls, 0);
+  joqe_node x = {joqe_type_none_string};
+  if(len < sizeof(x.u.c)) {
+    x.type |= JOQE_TYPE_INLINE_MASK;
+    memset(x.u.c, 0, sizeof(x.u.c));
+    join_fragments(k->u.ls, x.u.c);
+  } else {
+    struct joqe_ast_joined *j = malloc(sizeof(*j) + len + 1),
+                           *last = __atomic_load_n(&en->u.ob.joined,
+                                                   __ATOMIC_ACQUIRE);
+    join_fragments(k->u.ls, j->s);
+    j->s[len] = 0;
+    // the entry may be evaluated by several threads at once.
+    do {
+      if(last && !strcmp(last->s, j->s)) {
+        free(j);
+        j = last;
+        break;
+      }
+      j->nxt = last;
+    } while(!__atomic_compare_exchange_n(&en->u.ob.joined, &last, j, 0,
+                                         __ATOMIC_ACQ_REL,
+                                         __ATOMIC_ACQUIRE));
+    x.u.s = j->s;
+  }
+  *key = x;
+  return 1;
+}
+
 static int
 construct_object_entry (joqe_ast_construct *cst,
                         joqe_node *n, joqe_ctx *c,
@@ -1397,8 +3281,14 @@ construct_object_entry (joqe_ast_construct *cst,
 {
   joqe_ast_construct *kc = cst->u.ob.key,
                      *vc = cst->u.ob.value;
+  joqe_node key;
 
   if(!n) {
+    struct joqe_ast_joined *j, *nxt;
+    for(j = cst->u.ob.joined; j; j = nxt) {
+      nxt = j->nxt;
+      free(j);
+    }
     kc->construct(kc, IMPLODE);
     vc->construct(vc, IMPLODE);
     ast_construct_free(kc);
@@ -1409,6 +3299,8 @@ construct_object_entry (joqe_ast_construct *cst,
   joqe_result kr = joqe_result_push(r),
               vr;
 
+  // only the first key and value are used, don't produce the rest.
+  kr.first = 1;
   kc->construct(kc, n, c, &kr);
 
   if(! kr.ls) {
@@ -1420,20 +3312,17 @@ construct_object_entry (joqe_ast_construct *cst,
   joqe_nodels *k = (joqe_nodels*)
     joqe_list_detach((joqe_list**)&kr.ls, &kr.ls->ll);
 
-  if(kr.ls) {
-    //TODO design consideration, currently: multiple key hits: use first
-  }
+  //TODO design consideration, currently: multiple key hits: use first
   joqe_result_pop(r, &kr);
   // free the key node into the r-results freelist from this point on
   // if we don't need it.
 
-  if(JOQE_TYPE_VALUE(k->n.type) != joqe_type_none_string) {
-    //TODO design consideration, currently: key is non-string: skip entry
-    //Optionally: int/real -> render string?
+  if(!joqe_ast_entry_key(cst, &k->n, &key)) {
     joqe_result_free_node(k, r);
     return 0;
   }
   vr = joqe_result_push(r);
+  vr.first = 1;
   vc->construct(vc, n, c, &vr);
   if(! vr.ls) {
     //TODO design consideration, currently: no value: skip entry
@@ -1443,13 +3332,11 @@ construct_object_entry (joqe_ast_construct *cst,
   } else {
     joqe_nodels *v = (joqe_nodels*)
       joqe_list_detach((joqe_list**)&vr.ls, &vr.ls->ll);
-    if(vr.ls) {
-      //TODO design consideration, currently: multiple value hits: use first
-    }
+    //TODO design consideration, currently: multiple value hits: use first
     joqe_result_pop(r, &vr);
 
-    v->n.type = JOQE_TYPE(joqe_type_string_none, v->n.type);
-    v->n.k.key = k->n.u.s;
+    joqe_member_keyed(&v->n, &key);
+    v->n.ord = 0; // a new member, no longer the document node
     joqe_result_free_node(k, r);
     joqe_result_append(r, v);
     return 1;
@@ -1476,17 +3363,17 @@ construct_object (joqe_ast_construct *cst,
   // object construction in boolean context is always true.
   if(!r) return 1;
 
-  joqe_nodels *o = result_nodels(r, joqe_type_none_object);
   joqe_result or = joqe_result_push(r);
 
   if((i = cst->u.object.ls)) do {
     i->en.v.construct(&i->en.v, n, c, &or);
   } while((i = (joqe_ast_objectls*)i->ll.n) != cst->u.object.ls);
 
-  o->n.u.ls = or.ls;
+  joqe_node o = {joqe_type_none_object, .u = {.ls = or.ls}};
   or.ls = 0;
 
   joqe_result_pop(r, &or);
+  result_node(r, o);
 
   return 1;
 }
@@ -1527,23 +3414,24 @@ construct_array  (joqe_ast_construct *cst,
 
   if(!r) return 1;
 
-  joqe_nodels *o = result_nodels(r, joqe_type_none_array);
   joqe_result or = joqe_result_push(r);
 
   if((i = cst->u.array.ls)) do {
     construct_array_in(&i->en, n, c, &or);
   } while((i = (joqe_ast_arrayls*)i->ll.n) != cst->u.array.ls);
 
-  o->n.u.ls = or.ls;
+  joqe_node o = {joqe_type_none_array, .u = {.ls = or.ls}};
   or.ls = 0;
   joqe_result_pop(r, &or);
 
   int idx = 0;
   joqe_nodels *ni;
-  if((ni = o->n.u.ls)) do {
+  if((ni = o.u.ls)) do {
     ni->n.type = JOQE_TYPE(joqe_type_int_none, ni->n.type);
     ni->n.k.idx = idx++;
-  } while((ni = (joqe_nodels*)ni->ll.n) != o->n.u.ls);
+    ni->n.ord = 0;
+  } while((ni = (joqe_nodels*)ni->ll.n) != o.u.ls);
+  result_node(r, o);
 
   return 1;
 }
@@ -1581,7 +3469,7 @@ construct_context (joqe_ast_construct *cst,
   if((ctxi = ctxr.ls)) do {
     joqe_ctx stacked = {c, &ctxi->n};
     rc += v->construct(v, &ctxi->n, &stacked, r);
-  } while((ctxi = (joqe_nodels*)ctxi->ll.n) != ctxr.ls);
+  } while(result_more(r, rc) && (ctxi = (joqe_nodels*)ctxi->ll.n) != ctxr.ls);
 
   return rc;
 }
@@ -1664,6 +3552,107 @@ ast_array_entry(joqe_ast_construct v)
   return v;
 }
 
+// --index--
+
+// a key the path's first step selects by, if any.
+static int
+path_key(const joqe_ast_path *p, const char **key)
+{
+  if(p->punion || p->visit != visit_local_path || !p->pes)
+    return 0;
+  if(p->pes->visit != visit_pename)
+    return 0;
+  *key = p->pes->u.key;
+  return 1;
+}
+
+/* A key every node accepted by the filter e must either carry, or have
+   a member with (parents set). Nodes without it can be skipped without
+   evaluating the filter. */
+int
+joqe_ast_filter_key(const joqe_ast_expr *e, const char **key, int *parents)
+{
+  joqe_ast_expr_eval f = e->evaluate;
+  if(f == eval_string_value) {
+    // in test mode a string tests the key of the node
+    *key = e->u.s;
+    *parents = 0;
+    return 1;
+  }
+  if(f == eval_band)
+    return joqe_ast_filter_key(e->u.b.l, key, parents) ||
+           joqe_ast_filter_key(e->u.b.r, key, parents);
+  if(f == eval_compare) {
+    // comparisons against an empty set are false.
+    const joqe_ast_expr *l = e->u.b.l, *r = e->u.b.r;
+    if((l->evaluate == eval_path && path_key(&l->u.path, key)) ||
+       (r->evaluate == eval_path && path_key(&r->u.path, key)))
+    {
+      *parents = 1;
+      return 1;
+    }
+    return 0;
+  }
+  if(f == eval_path && path_key(&e->u.path, key)) {
+    *parents = 1;
+    return 1;
+  }
+  return 0;
+}
+
+// --introspection--
+
+joqe_ast_kind
+joqe_ast_expr_kind(const joqe_ast_expr *e)
+{
+  joqe_ast_expr_eval f = e->evaluate;
+  if(f == eval_fix_value)       return joqe_ast_kind_fix_value;
+  if(f == eval_string_value)    return joqe_ast_kind_string_value;
+  if(f == eval_stringls_value)  return joqe_ast_kind_stringls_value;
+  if(f == eval_integer_value)   return joqe_ast_kind_integer_value;
+  if(f == eval_real_value)      return joqe_ast_kind_real_value;
+  if(f == eval_bor)             return joqe_ast_kind_bor;
+  if(f == eval_band)            return joqe_ast_kind_band;
+  if(f == eval_compare)         return joqe_ast_kind_compare;
+  if(f == eval_calc)            return joqe_ast_kind_calc;
+  if(f == eval_negative)        return joqe_ast_kind_negative;
+  if(f == eval_positive)        return joqe_ast_kind_positive;
+  if(f == eval_not)             return joqe_ast_kind_not;
+  if(f == eval_context)         return joqe_ast_kind_context;
+  if(f == eval_path)            return joqe_ast_kind_path;
+  if(f == eval_hoisted)         return joqe_ast_kind_hoisted;
+  return joqe_ast_kind_unknown;
+}
+
+joqe_ast_kind
+joqe_ast_path_kind(const joqe_ast_path *p)
+{
+  if(p->visit == visit_local_path)    return joqe_ast_kind_local_path;
+  if(p->visit == visit_context_path)  return joqe_ast_kind_context_path;
+  return joqe_ast_kind_unknown;
+}
+
+joqe_ast_kind
+joqe_ast_pathelem_kind(const joqe_ast_pathelem *pe)
+{
+  if(pe->visit == visit_pefunction) return joqe_ast_kind_pefunction;
+  if(pe->visit == visit_peflex)     return joqe_ast_kind_peflex;
+  if(pe->visit == visit_pename)     return joqe_ast_kind_pename;
+  if(pe->visit == visit_pefilter)   return joqe_ast_kind_pefilter;
+  return joqe_ast_kind_unknown;
+}
+
+joqe_ast_kind
+joqe_ast_construct_kind(const joqe_ast_construct *c)
+{
+  if(c->construct == construct_expr)          return joqe_ast_kind_expr_construct;
+  if(c->construct == construct_object)        return joqe_ast_kind_object_construct;
+  if(c->construct == construct_array)         return joqe_ast_kind_array_construct;
+  if(c->construct == construct_object_entry)  return joqe_ast_kind_object_entry;
+  if(c->construct == construct_context)       return joqe_ast_kind_construct_context;
+  return joqe_ast_kind_unknown;
+}
+
 struct joqe_ast_api ast = {
   ast_string_value, // joqe_ast_expr (*string_value)(const char* s);
   ast_string_append, // joqe_ast_expr (*string_append)(joqe_ast_expr e, const char* s);
@@ -1683,6 +3672,7 @@ struct joqe_ast_api ast = {
   ast_expr_context, // joqe_ast_expr (*expr_context)(joqe_ast_expr e, joqe_ast_construct ctx);
 
   ast_path_expr, // joqe_ast_expr (*path_expression)(joqe_ast_path p);
+  ast_hoisted, // joqe_ast_expr (*hoisted)(joqe_ast_expr e, joqe_ast_pathelem *owner);
 
   ast_params, // joqe_ast_params (*params)();
   ast_params_append, // joqe_ast_params (*params_append)(joqe_ast_params ps, joqe_ast_expr e);
@@ -10,10 +10,31 @@ typedef enum {
   joqe_result_fail  = 0x01
 } joqe_result_status;
 
+/* A contiguous node set for intermediate results, the first few nodes
+   are kept inline. A zeroed vector is empty and ready to use. */
+#define JOQE_NODEVEC_INLINE 8
+
+typedef struct joqe_nodevec {
+  joqe_node  *heap;
+  int         len;
+  int         cap;
+  joqe_node   inl[JOQE_NODEVEC_INLINE];
+} joqe_nodevec;
+
+/* A consumer that folds nodes into a running value as they're produced,
+   the nodes themselves are released right after the step. */
+typedef struct joqe_fold {
+  void (*step) (struct joqe_fold *f, joqe_node *n);
+  int   done;  // set when no more nodes are wanted, producers may stop
+} joqe_fold;
+
 typedef struct joqe_result {
-  joqe_nodels *ls;
-  joqe_nodels *freels;
-  int          status;
+  joqe_nodels  *ls;
+  joqe_nodels  *freels;
+  int           status;
+  int           first; // only the first node is used, producers may stop
+  joqe_nodevec *vec;   // when set, nodes are collected here instead of ls
+  joqe_fold    *fold;  // when set, nodes are folded instead of collected
 } joqe_result;
 
 joqe_nodels*  joqe_result_alloc_node (joqe_result *r);
@@ -22,7 +43,27 @@ void          joqe_result_clear_node (joqe_node    n,
                                       joqe_result *r);
 void          joqe_result_free_node  (joqe_nodels *n,
                                       joqe_result *r);
+void          joqe_result_free_list  (joqe_nodels *list,
+                                      joqe_result *r);
 void          joqe_result_destroy    (joqe_result *r);
+joqe_result   joqe_result_push       (joqe_result *r);
+void          joqe_result_pop        (joqe_result *base,
+                                      joqe_result *r);
+int           joqe_result_union      (joqe_nodels **ls,
+                                      joqe_result  *r);
+
+static inline joqe_node*
+joqe_nodevec_nodes (joqe_nodevec *v)
+{
+  return v->heap ? v->heap : v->inl;
+}
+
+void          joqe_nodevec_push      (joqe_nodevec *v,
+                                      joqe_node     n);
+void          joqe_nodevec_reset     (joqe_nodevec *v,
+                                      joqe_result  *r);
+void          joqe_nodevec_destroy   (joqe_nodevec *v,
+                                      joqe_result  *r);
 
 typedef struct joqe_ast_objectls joqe_ast_objectls;
 typedef struct joqe_ast_arrayls joqe_ast_arrayls;
@@ -38,6 +79,8 @@ typedef struct {
 typedef struct joqe_ctx {
   struct joqe_ctx    *stack;
   joqe_node          *node;
+  // key index of the document, only set on the outermost context.
+  struct joqe_index  *index;
 } joqe_ctx;
 
 typedef struct joqe_ast_construct joqe_ast_construct;
@@ -52,8 +95,9 @@ struct joqe_ast_construct {
     joqe_ast_expr    *expr;
 
     struct {
-      joqe_ast_construct *key;
-      joqe_ast_construct *value;
+      joqe_ast_construct      *key;
+      joqe_ast_construct      *value;
+      struct joqe_ast_joined  *joined; // keys joined from fragments
     } ob;
 
     struct {
@@ -96,6 +140,15 @@ typedef struct joqe_ast_expr {
       int             op;
       joqe_ast_expr  *l, *r;
     } b;
+    struct {
+      joqe_ast_expr            *e;
+      struct joqe_ast_pathelem *owner;
+      uint64_t                  epoch;
+      int                       rv;
+      uint32_t                  gen;   // arena generation of the cache
+      joqe_result               cache;
+      joqe_nodevec             *values;
+    } h;
   } u;
 } joqe_ast_expr;
 
@@ -116,6 +169,8 @@ typedef int (*joqe_function_call) (struct joqe_ast_pathelem *p,
 typedef struct {
   joqe_function_call call;
   joqe_ast_params ps;
+  int streamed; // the call evaluates its own parameters, ps are all null
+  struct joqe_regex *regex; // the pattern matches() compiled last
 } joqe_ast_function;
 
 struct joqe_ast_pathelem {
@@ -124,6 +179,8 @@ struct joqe_ast_pathelem {
                 joqe_node *n, joqe_ctx *c,
                 joqe_result *r,
                 struct joqe_ast_pathelem *end);
+  uint64_t      epoch; // bumped on each filter invocation
+  joqe_shape_cache shape; // of a name
   union {
     const char       *key;
     int               idx;
@@ -165,10 +222,79 @@ typedef enum {
   joqe_ast_calc_mod,
 } joqe_ast_calc_op;
 
+typedef enum {
+  joqe_ast_kind_unknown,
+
+  joqe_ast_kind_fix_value,
+  joqe_ast_kind_string_value,
+  joqe_ast_kind_stringls_value,
+  joqe_ast_kind_integer_value,
+  joqe_ast_kind_real_value,
+  joqe_ast_kind_bor,
+  joqe_ast_kind_band,
+  joqe_ast_kind_compare,
+  joqe_ast_kind_calc,
+  joqe_ast_kind_negative,
+  joqe_ast_kind_positive,
+  joqe_ast_kind_not,
+  joqe_ast_kind_context,
+  joqe_ast_kind_path,
+  joqe_ast_kind_hoisted,
+
+  joqe_ast_kind_local_path,
+  joqe_ast_kind_context_path,
+
+  joqe_ast_kind_pefunction,
+  joqe_ast_kind_peflex,
+  joqe_ast_kind_pename,
+  joqe_ast_kind_pefilter,
+
+  joqe_ast_kind_expr_construct,
+  joqe_ast_kind_object_construct,
+  joqe_ast_kind_array_construct,
+  joqe_ast_kind_object_entry,
+  joqe_ast_kind_construct_context
+} joqe_ast_kind;
+
+joqe_ast_kind joqe_ast_expr_kind      (const joqe_ast_expr      *e);
+joqe_ast_kind joqe_ast_path_kind      (const joqe_ast_path      *p);
+joqe_ast_kind joqe_ast_pathelem_kind  (const joqe_ast_pathelem  *pe);
+joqe_ast_kind joqe_ast_construct_kind (const joqe_ast_construct *c);
+
+int joqe_ast_bool_node     (joqe_node          rx,
+                            joqe_node         *n);
+int joqe_ast_compare_nodes (joqe_ast_comp_op   op,
+                            joqe_node         *a,
+                            joqe_node         *b);
+int joqe_ast_compare_sets  (joqe_ast_comp_op   op,
+                            joqe_nodels       *l,
+                            joqe_nodels       *r);
+int joqe_ast_calc_nodes    (joqe_ast_calc_op   op,
+                            joqe_node         *a,
+                            joqe_node         *b,
+                            joqe_node         *rx);
+// +a (mul 1) or -a (mul -1), 0 if a isn't a number.
+int joqe_ast_sign_node     (int                mul,
+                            joqe_node         *a,
+                            joqe_node         *rx);
+int joqe_ast_filter_key    (const joqe_ast_expr *e,
+                            const char       **key,
+                            int               *parents);
+// the string k gives as the key of the object entry en, 0 if none.
+int joqe_ast_entry_key     (joqe_ast_construct *en,
+                            joqe_node         *k,
+                            joqe_node         *key);
+// 0 if the function pe, just made, may be called. Otherwise -1 with why
+// in *msg, and pe released: a literal pattern has to compile.
+int joqe_ast_function_check (joqe_ast_pathelem *pe,
+                             const char       **msg);
+
+struct joqe_index* joqe_ctx_index (joqe_ctx *c);
+
 extern struct joqe_ast_api {
   joqe_ast_expr (*string_value)(const char* s);
   joqe_ast_expr (*string_append)(joqe_ast_expr e, const char* s);
-  joqe_ast_expr (*integer_value)(int i);
+  joqe_ast_expr (*integer_value)(int64_t i);
   joqe_ast_expr (*real_value)(double d);
 
   joqe_ast_expr (*bor)(joqe_ast_expr l, joqe_ast_expr r);
@@ -182,6 +308,7 @@ extern struct joqe_ast_api {
   joqe_ast_expr (*expr_context)(joqe_ast_expr e, joqe_ast_construct ctx);
 
   joqe_ast_expr (*path_expression)(joqe_ast_path p);
+  joqe_ast_expr (*hoisted)(joqe_ast_expr e, joqe_ast_pathelem *owner);
 
   joqe_ast_params (*params)();
   joqe_ast_params (*params_append)(joqe_ast_params ps, joqe_ast_expr e);
@@ -1,6 +1,8 @@
 #include "ast.h"
 #include "lex-source.h"
 #include "build.h"
+#include "keyindex.h"
+#include "cons.h"
 
 #include <stdlib.h>
 
@@ -52,6 +54,7 @@ joqe_build_init(joqe_lex_source src)
 {
   joqe_build b = {src};
   b.interned = hopscotch_create();
+  b.shapes = hopscotch_create();
   joqe_build_reset_hash(&b);
   return b;
 }
@@ -59,10 +62,19 @@ void
 joqe_build_destroy(joqe_build *b)
 {
   hopscotch_destroy(&b->interned);
+  hopscotch_destroy(&b->shapes);
+  for(joqe_shape *c, *s = b->shapels; (c=s); s=s->nxt, free(c))
+    ;
+  b->shapels = 0;
   for(joqe_slab *c, *s = b->first; (c=s); s=s->nxt, joqe_slab_free(c))
     ;
   b->first = b->current = 0;
 
+  joqe_index_destroy(b->index);
+  b->index = 0;
+  joqe_cons_destroy(b->cons);
+  b->cons = 0;
+
   if(b->root.construct) {
     b->root.construct(&b->root, 0, 0, 0);
     b->root.construct = 0;
@@ -188,3 +200,20 @@ joqe_build_cancelstring(joqe_build *build)
 
   joqe_build_reset_hash(build);
 }
+
+int
+joqe_build_shortstring(joqe_build *build, char buf[8])
+{
+  joqe_slab *s = build->current;
+  size_t len = s ? s->write - s->mark : 0;
+  if(len >= 8)
+    return 0;
+  // as a C string, anything after an escaped zero byte is lost.
+  memset(buf, 0, 8);
+  if(len) {
+    len = strnlen(&s->base[s->mark], len);
+    memcpy(buf, &s->base[s->mark], len);
+    joqe_build_cancelstring(build);
+  }
+  return 1;
+}
@@ -16,8 +16,22 @@ typedef struct joqe_build {
   joqe_ast_construct  root;
 
   hopscotch   interned;
+  // shapes of document objects, by hash of their keys.
+  hopscotch   shapes;
+  struct joqe_shape *shapels;
+  // optional key index, filled in while parsing documents.
+  struct joqe_index *index;
+  // optional hash-consing of document subtrees, see cons.h.
+  struct joqe_cons  *cons;
 
   int         mode;
+  // while set, strings of up to 7 bytes are lexed into the token, as a
+  // SHORTSTRING, rather than kept in the build. Set for document values.
+  int         short_strings;
+  // levels a document may nest, 0 for JOQE_JSON_DEPTH.
+  int         depth;
+  uint32_t    ord;
+  uint32_t    dropped; // nodes of subtrees found to be repeats
   uint32_t    hash;
   uint32_t    block;
 
@@ -31,5 +45,8 @@ void        joqe_build_destroy(joqe_build *build);
 int         joqe_build_appendstring(joqe_build* build, int c);
 const char* joqe_build_closestring(joqe_build* build);
 void        joqe_build_cancelstring(joqe_build* build);
+// the string appended, if it's no more than 7 bytes, copied into buf
+// zero padded and cancelled. 0, leaving it be, if it's longer.
+int         joqe_build_shortstring(joqe_build* build, char buf[8]);
 
 #endif /* idempotent include guard */
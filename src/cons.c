@@ -0,0 +1,204 @@
+#include "cons.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define FNVOFFSET 0x811c9dc5u
+#define FNVPRIME  0x01000193u
+
+typedef struct {
+  uint64_t   hash;
+  joqe_node  n;     // type 0 where empty
+} entry;
+
+struct joqe_cons {
+  entry     *slots;
+  uint32_t   mask;
+  int        count;
+};
+
+static uint64_t
+mix(uint64_t h, uint64_t k)
+{
+  h ^= k;
+  h *= 0xff51afd7ed558ccdull;
+  return h ^ h >> 33;
+}
+
+static uint64_t
+fnv1a(const void *p, size_t len)
+{
+  const unsigned char *s = p;
+  uint32_t h = FNVOFFSET;
+  for(size_t i = 0; i < len; ++i)
+    h = (h ^ s[i]) * FNVPRIME;
+  return h;
+}
+
+// members that are subtrees themselves go by their (shared) pointer.
+static uint64_t
+value_hash(joqe_node *m)
+{
+  switch(JOQE_TYPE_VALUE(m->type)) {
+    case joqe_type_none_string:
+      if(JOQE_TYPE_INLINE(m->type))
+        return m->u.i;
+      return fnv1a(m->u.s, strlen(m->u.s));
+    case joqe_type_none_object:
+    case joqe_type_none_array:
+    case joqe_type_none_stringls:
+      return (uintptr_t)m->u.ls;
+    default:
+      return m->u.i;
+  }
+}
+
+static int
+values_same(joqe_node *a, joqe_node *b)
+{
+  if(a->type != b->type)
+    return 0;
+  switch(JOQE_TYPE_VALUE(a->type)) {
+    case joqe_type_none_string:
+      // of the same type, both are inline or neither is.
+      return a->u.i == b->u.i
+        || (!JOQE_TYPE_INLINE(a->type) && !strcmp(a->u.s, b->u.s));
+    case joqe_type_none_object:
+    case joqe_type_none_array:
+    case joqe_type_none_stringls:
+      return a->u.ls == b->u.ls;
+    case joqe_type_none_null:
+      return 1;
+    default:
+      return a->u.i == b->u.i;
+  }
+}
+
+static uint64_t
+node_hash(joqe_node *n)
+{
+  uint64_t h = JOQE_TYPE_VALUE(n->type) | JOQE_TYPE_PACKED(n->type);
+  if(JOQE_TYPE_PACKED(n->type)) {
+    // records of a shape have the same keys. A row of numbers is its
+    // values, the members of others go as those of a list.
+    joqe_packed *p = n->u.p;
+    h = mix(mix(h, p->type), (uintptr_t)p->shape);
+    if(p->type)
+      return mix(h, fnv1a(p->v, sizeof(p->v[0]) * p->count));
+    for(int k = 0; k < p->count; ++k) {
+      joqe_node tmp, *m = joqe_packed_at(p, k, &tmp);
+      h = mix(mix(h, m->type), value_hash(m));
+    }
+    return h;
+  }
+  joqe_nodels *i = n->u.ls;
+  do {
+    joqe_node *m = &i->n;
+    if(m->type == joqe_type_ref_cnt)
+      continue;
+    if(JOQE_TYPE_KEY(m->type) == JOQE_TYPE_KEY_STRING)
+      h = mix(h, fnv1a(m->k.key, strlen(m->k.key)));
+    h = mix(h, m->type);
+    h = mix(h, value_hash(m));
+  } while((i = (joqe_nodels*)i->ll.n) != n->u.ls);
+  return h;
+}
+
+// a and b may be keyed differently, only their values count.
+static int
+nodes_same(joqe_node *a, joqe_node *b)
+{
+  if(JOQE_TYPE_VALUE(a->type) != JOQE_TYPE_VALUE(b->type)
+     || JOQE_TYPE_PACKED(a->type) != JOQE_TYPE_PACKED(b->type))
+    return 0;
+  if(JOQE_TYPE_PACKED(a->type)) {
+    joqe_packed *pa = a->u.p, *pb = b->u.p;
+    if(pa->type != pb->type || pa->shape != pb->shape
+       || pa->count != pb->count)
+      return 0;
+    if(pa->type)
+      return !memcmp(pa->v, pb->v, sizeof(pa->v[0]) * pa->count);
+    for(int k = 0; k < pa->count; ++k) {
+      joqe_node ta, tb;
+      if(!values_same(joqe_packed_at(pa, k, &ta), joqe_packed_at(pb, k, &tb)))
+        return 0;
+    }
+    return 1;
+  }
+  // a list parsed may be led by a sentinel, never one left empty.
+  joqe_nodels *ia = a->u.ls, *ib = b->u.ls;
+  if(ia->n.type == joqe_type_ref_cnt)
+    ia = (joqe_nodels*)ia->ll.n;
+  if(ib->n.type == joqe_type_ref_cnt)
+    ib = (joqe_nodels*)ib->ll.n;
+  do {
+    joqe_node *ma = &ia->n, *mb = &ib->n;
+    if(!values_same(ma, mb))
+      return 0;
+    if(JOQE_TYPE_KEY(ma->type) == JOQE_TYPE_KEY_STRING
+       && ma->k.key != mb->k.key && strcmp(ma->k.key, mb->k.key))
+      return 0;
+    ia = (joqe_nodels*)ia->ll.n;
+    ib = (joqe_nodels*)ib->ll.n;
+  } while(ia != a->u.ls && ib != b->u.ls);
+  return ia == a->u.ls && ib == b->u.ls;
+}
+
+joqe_cons*
+joqe_cons_create()
+{
+  return calloc(1, sizeof(joqe_cons));
+}
+
+void
+joqe_cons_destroy(joqe_cons *c)
+{
+  if(!c)
+    return;
+  free(c->slots);
+  free(c);
+}
+
+static void
+grow(joqe_cons *c)
+{
+  entry *old = c->slots;
+  uint32_t size = old ? 2*(c->mask+1) : 256;
+  c->slots = calloc(size, sizeof(*c->slots));
+  c->mask = size - 1;
+  if(old) {
+    for(uint32_t i = 0; i < size/2; ++i) {
+      if(!old[i].n.type)
+        continue;
+      uint32_t at = old[i].hash & c->mask;
+      while(c->slots[at].n.type)
+        at = (at + 1) & c->mask;
+      c->slots[at] = old[i];
+    }
+    free(old);
+  }
+}
+
+joqe_node*
+joqe_cons_find(joqe_cons *c, joqe_node *n)
+{
+  if(!c->slots || 2*(c->count + 1) > c->mask + 1)
+    grow(c);
+
+  uint64_t h = node_hash(n);
+  uint32_t at = h & c->mask;
+  for(; c->slots[at].n.type; at = (at + 1) & c->mask)
+    if(c->slots[at].hash == h && nodes_same(&c->slots[at].n, n))
+      return &c->slots[at].n;
+
+  c->slots[at].hash = h;
+  c->slots[at].n = *n;
+  c->count++;
+  return 0;
+}
+
+int
+joqe_cons_size(joqe_cons *c)
+{
+  return c->count;
+}
@@ -0,0 +1,27 @@
+#ifndef __JOQE_CONS_H__
+#define __JOQE_CONS_H__
+
+#include "json.h"
+
+/* Hash-consing of document subtrees. With a joqe_cons in its build, the
+   parser looks each object and array up once it's complete; one that's
+   identical to a subtree seen before is dropped, and the list (or row,
+   of a packed array) of the first is used in its place. Subtrees are
+   completed bottom up, so identical subtrees already share their
+   members and are compared a level deep only. Identical means the same
+   keys in the same order and the same values of the same types, 1 and
+   1.0 aren't. A repeat keeps its own place in document order, see
+   joqe_members_shift in json.h. */
+
+typedef struct joqe_cons joqe_cons;
+
+joqe_cons*  joqe_cons_create  ();
+void        joqe_cons_destroy (joqe_cons *c);
+
+// the node n is to share the members of, 0 if there's none and n is
+// the first of its kind, it's then remembered.
+joqe_node*  joqe_cons_find    (joqe_cons *c, joqe_node *n);
+// subtrees remembered.
+int         joqe_cons_size    (joqe_cons *c);
+
+#endif /* idempotent include guard */
@@ -5,6 +5,11 @@
 #include "lex.h"
 #include "utf.h"
 #include "json.h"
+#include "opt.h"
+#include "vm.h"
+#include "keyindex.h"
+#include "cons.h"
+#include "arena.h"
 
 #include <stdarg.h>
 #include <stdio.h>
@@ -45,59 +50,6 @@ typedef struct {
   int         rs;
 } config;
 
-void dump(joqe_node n, int lvl, config *c);
-
-void
-dump_kvs(joqe_nodels *ns, int lvl, config *c)
-{
-  joqe_nodels *ls;
-  int align = 0;
-  if(c->pp > 1) {
-    if((ls = ns)) do {
-      int l = JOQE_TYPE_KEY(ls->n.type) == joqe_type_string_none ?
-        strlen(ls->n.k.key) : 0;
-      if (l > align)
-        align = l;
-    } while((ls = (joqe_nodels*)ls->ll.n) != ns);
-  }
-
-  const char *k;
-  const char *nl = c->nl;
-  int ind = c->ind*lvl + c->nllen;
-  int off, minoff = c->pp ? 1 : 0;
-  if((ls = ns)) {
-    if(ls->n.type == joqe_type_ref_cnt)
-      ls = (joqe_nodels*) ls->ll.n;
-    goto first;
-    do {
-      printf(",");
-      first:
-        k = JOQE_TYPE_KEY(ls->n.type) == joqe_type_string_none ?
-          ls->n.k.key : "";
-        off = minoff + (align?align-strlen(k):0);
-        if(c->raw > 1) printf("%-*s%s:%*s", ind, nl, k, -off, "");
-        else printf("%-*s\"%s\":%*s", ind, nl, k, -off, "");
-      dump(ls->n, lvl, c);
-    } while((ls = (joqe_nodels*)ls->ll.n) != ns);
-  }
-}
-void
-dump_vs(joqe_nodels *ns, int lvl, config *c)
-{
-  joqe_nodels *ls;
-  int ind = c->array > 1 || (c->array && lvl <= 1) ? 0 : c->ind*lvl+c->nllen;
-  if((ls = ns)) {
-    if(ls->n.type == joqe_type_ref_cnt)
-      ls = (joqe_nodels*) ls->ll.n;
-    goto first;
-    do {
-      printf("%c", c->array ? *c->separator : ',');
-      first: if(ind) printf("%-*s", ind, c->nl);
-      dump(ls->n, lvl, c);
-    } while((ls = (joqe_nodels*)ls->ll.n) != ns);
-  }
-}
-
 void
 dumpsubstring(const char *s, config *c)
 {
@@ -151,7 +103,7 @@ dumpstringlsrecurse(joqe_nodels *ls, config *c)
     if(i->n.type == joqe_type_ref_cnt) continue;
     switch(JOQE_TYPE_VALUE(i->n.type)) {
       case joqe_type_none_string:
-        dumpsubstring(i->n.u.s, c);
+        dumpsubstring(joqe_node_string(&i->n), c);
         break;
       case joqe_type_none_stringls:
         dumpstringlsrecurse(i->n.u.ls, c);
@@ -191,7 +143,7 @@ dumprawstringls(joqe_nodels *ls, config *c)
     if(i->n.type == joqe_type_ref_cnt) continue;
     switch(JOQE_TYPE_VALUE(i->n.type)) {
       case joqe_type_none_string:
-        dumprawsubstring(i->n.u.s, c);
+        dumprawsubstring(joqe_node_string(&i->n), c);
         break;
       case joqe_type_none_stringls:
         dumprawstringls(i->n.u.ls, c);
@@ -202,62 +154,136 @@ dumprawstringls(joqe_nodels *ls, config *c)
   } while((i = (joqe_nodels*)i->ll.n) != e);
 }
 
-void
-dump(joqe_node n, int lvl, config *c)
+/* An object or array being dumped, with what's needed to lay out the rest
+   of its members. Containers are dumped from a stack of these rather
+   than recursively, as documents may nest deep. */
+typedef struct {
+  joqe_members it;
+  int          lvl;   // of the members
+  int          k;     // members dumped
+  int          ind;
+  int          align; // of object values
+  char         close; // 0 for a shell list
+  int          object;
+} dump_frame;
+
+#define DUMP_INLINE 16
+
+// prints a scalar, or opens a container into f and returns 1.
+static int
+dump_open(joqe_node *n, int lvl, config *c, dump_frame *f)
 {
-  if(n.type == joqe_type_ref_cnt)
-    return; // only happens on an empty list with a ref count, shouldn't happen
-  switch(JOQE_TYPE_VALUE(n.type)) {
+  joqe_members it;
+  joqe_node *m;
+  if(n->type == joqe_type_ref_cnt)
+    return 0; // only happens on an empty list with a ref count, shouldn't happen
+  switch(JOQE_TYPE_VALUE(n->type)) {
     case joqe_type_broken:
       printf("broken"); break;
     case joqe_type_none_string:
       if(c->raw > 1 || (c->raw && !lvl))
-        dumprawstring(n.u.s, c);
+        dumprawstring(joqe_node_string(n), c);
       else
-        dumpstring(n.u.s, c);
+        dumpstring(joqe_node_string(n), c);
       break;
     case joqe_type_none_stringls:
       if(c->raw > 1 || (c->raw && !lvl))
-        dumprawstringls(n.u.ls, c);
+        dumprawstringls(n->u.ls, c);
       else
-        dumpstringls(n.u.ls, c);
+        dumpstringls(n->u.ls, c);
       break;
     case joqe_type_none_integer:
-      printf("%ld", n.u.i); break;
+      printf("%ld", n->u.i); break;
     case joqe_type_none_real:
-      printf("%f", n.u.d); break;
+      printf("%f", n->u.d); break;
     case joqe_type_none_true:
       printf("true"); break;
     case joqe_type_none_false:
       printf("false"); break;
     case joqe_type_none_null:
       printf("null"); break;
-#define PP c->ind*lvl+c->nllen, c->nl
     case joqe_type_none_object:
-      if(n.u.ls) {
-        printf("{"); dump_kvs(n.u.ls, lvl+1, c);
-        printf("%-*s}", PP);
-      } else {
+      if(!n->u.ls) {
         printf("{}");
+        break;
       }
-      break;
+      *f = (dump_frame){joqe_members_of(n), lvl+1, .close = '}', .object = 1};
+      f->ind = c->ind*f->lvl + c->nllen;
+      if(c->pp > 1) {
+        for(it = joqe_members_of(n); (m = joqe_members_next(&it));) {
+          int l = JOQE_TYPE_KEY(m->type) == joqe_type_string_none ?
+            strlen(joqe_member_key(m)) : 0;
+          if (l > f->align)
+            f->align = l;
+        }
+      }
+      printf("{");
+      return 1;
     case joqe_type_none_array:
-      if(c->array > 1 || (c->array && !lvl)) {
-        if(n.u.ls)
-          dump_vs(n.u.ls, lvl+1, c);
-      } else {
-        if(n.u.ls) {
-          printf("["); dump_vs(n.u.ls, lvl+1, c);
-          printf("%-*s]", PP);
-        } else {
+      if(!n->u.ls) {
+        if(!(c->array > 1 || (c->array && !lvl)))
           printf("[]");
-        }
+        break;
       }
-      break;
-#undef PP
+      *f = (dump_frame){joqe_members_of(n), lvl+1};
+      f->ind = c->array > 1 || (c->array && f->lvl <= 1) ? 0
+             : c->ind*f->lvl + c->nllen;
+      if(!(c->array > 1 || (c->array && !lvl))) {
+        f->close = ']';
+        printf("[");
+      }
+      return 1;
     default:
-      printf("unknown %d", JOQE_TYPE_VALUE(n.type));
+      printf("unknown %d", JOQE_TYPE_VALUE(n->type));
+  }
+  return 0;
+}
+
+void
+dump(joqe_node n, int lvl, config *c)
+{
+  dump_frame inl[DUMP_INLINE], *st = inl, *f;
+  int sp = 0, cap = DUMP_INLINE;
+  joqe_node *m = &n;
+
+  for(;;) {
+    // grown once m is opened, m may be the member of a packed array kept
+    // in the stack.
+    if(dump_open(m, lvl, c, &st[sp]) && ++sp == cap) {
+      cap *= 2;
+      if(st == inl) {
+        st = malloc(sizeof(*st) * cap);
+        memcpy(st, inl, sizeof(inl));
+      } else {
+        st = realloc(st, sizeof(*st) * cap);
+      }
+    }
+    // the containers m was the last member of are closed.
+    for(m = 0; sp && !(m = joqe_members_next(&(f = &st[sp-1])->it)); --sp)
+      if(f->close)
+        printf("%-*s%c", c->ind*(f->lvl-1)+c->nllen, c->nl, f->close);
+    if(!m)
+      break;
+
+    if(f->object) {
+      const char *k = JOQE_TYPE_KEY(m->type) == joqe_type_string_none ?
+        joqe_member_key(m) : "";
+      int off = (c->pp ? 1 : 0) + (f->align ? f->align-strlen(k) : 0);
+      if(f->k)
+        printf(",");
+      if(c->raw > 1) printf("%-*s%s:%*s", f->ind, c->nl, k, -off, "");
+      else printf("%-*s\"%s\":%*s", f->ind, c->nl, k, -off, "");
+    } else {
+      if(f->k)
+        printf("%c", c->array ? *c->separator : ',');
+      if(f->ind) printf("%-*s", f->ind, c->nl);
+    }
+    f->k++;
+    lvl = f->lvl;
   }
+
+  if(st != inl)
+    free(st);
 }
 
 int
@@ -300,21 +326,33 @@ usage(FILE *out)
     "\t             option implies -A.\n"
     "\t-R           Precede all output records with a ASCII record separator\n"
     "\t             control code. A trailing line feed will still be appended.\n"
+    "\t-V           Evaluate the expression using the bytecode VM instead of\n"
+    "\t             walking the expression tree.\n"
+    "\t-x           Index object keys while parsing, speeds up descendant\n"
+    "\t             queries (..name and ..[filter]) on large documents.\n"
+    "\t-s           Share identical objects and arrays while parsing, for\n"
+    "\t             less memory on repetitive documents. Can't be combined\n"
+    "\t             with -x.\n"
+    "\t-d DEPTH     Fail on documents nesting objects and arrays deeper than\n"
+    "\t             DEPTH levels, %d by default.\n"
+    "\t-D           Report the rewrites made by the expression optimizer on\n"
+    "\t             standard error, and with -s the ratio of nodes parsed to\n"
+    "\t             nodes kept.\n"
     "\t-q           Quiet, fail silently on parsing errors.\n"
     "\t-h           Print this help.\n"
-    "\n", argv0, argv0, argv0);
+    "\n", argv0, argv0, argv0, JOQE_JSON_DEPTH);
 }
 
 int
 main(int argc, char **argv)
 {
-  int i, opt, r = 0;
+  int i, opt, r = 0, usevm = 0, debug = 0, index = 0, share = 0, depth = 0;
   const char* expfile = 0;
   config c = {.separator = " "};
 
   argv0 = argv[0];
 
-  while((opt = getopt(argc, argv, "hI:af:FqrAS:R")) != -1) switch(opt) {
+  while((opt = getopt(argc, argv, "hI:af:FqrAS:RVDxsd:")) != -1) switch(opt) {
     case '?': usage(stderr); return 1;
     case 'h': usage(stdout); return 0;
     case 'f': expfile = optarg; break;
@@ -331,15 +369,30 @@ main(int argc, char **argv)
     case 'A': c.array++; break;
     case 'S': c.array = c.array ? c.array : 1; c.separator = optarg; break;
     case 'R': c.rs++; break;
+    case 'V': usevm = 1; break;
+    case 'D': debug = 1; break;
+    case 'x': index = 1; break;
+    case 's': share = 1; break;
+    case 'd': {
+      char *e;
+      depth = strtol(optarg, &e, 0);
+      if(*e || depth <= 0)
+        return fail("depth must be a positive number: %s", optarg);
+    } break;
   }
   i = optind;
 
+  // shared subtrees have more than one parent to be indexed under.
+  if(index && share)
+    return fail("-s and -x can't be combined");
+
   if(c.ind && !c.pp) c.pp = 1;
   else if(!c.ind && c.pp) c.ind = 4;
   if(!c.nl) c.nl = c.pp ? "\n" : "";
   c.nllen = strlen(c.nl);
 
   joqe_ast_construct *cst = 0;
+  joqe_vm_program *vm = 0;
   joqe_build exp = {};
   if(expfile || (i < argc)) {
     joqe_lex_source src;
@@ -357,10 +410,15 @@ main(int argc, char **argv)
       joqe_build_destroy(&exp);
       return 1;
     } else cst = &exp.root;
+
+    joqe_optimize(&exp, debug);
+    if(usevm)
+      vm = joqe_vm_compile(cst);
   }
 
   joqe_node nullnode = {joqe_type_none_null};
   joqe_ctx nullctx = {NULL, &nullnode};
+  joqe_arena *arena = joqe_arena_create();
 
   do {
     joqe_lex_source source;
@@ -374,10 +432,24 @@ main(int argc, char **argv)
       fname = argv[i];
       source = joqe_lex_source_file(fname);
     }
+    // everything from the previous document went with its arena.
+    joqe_arena_reset(arena);
+    joqe_arena_use(arena);
+
     joqe_build bdoc = joqe_build_init(source);
+    bdoc.depth = depth;
+    if(index && cst)
+      bdoc.index = joqe_index_create();
+    if(share)
+      bdoc.cons = joqe_cons_create();
     r = joqe_json(&bdoc);
     source.destroy(&source);
 
+    if(share && debug && !r)
+      fprintf(stderr, "%s: %s: %u nodes, %u kept (%.2f:1)\n", argv0, fname,
+              bdoc.ord, bdoc.ord - bdoc.dropped,
+              bdoc.ord ? (double)bdoc.ord / (bdoc.ord - bdoc.dropped) : 1.0);
+
     if(r) {
       if (!q) fprintf(stderr, "%s: %s: parse failed\n", argv0, fname);
       continue;
@@ -386,8 +458,11 @@ main(int argc, char **argv)
     bdoc.root.construct(&bdoc.root, &nullnode, &nullctx, &rdoc);
 
     if(cst) {
-      joqe_ctx rootcontext = {NULL, &rdoc.ls->n};
-      cst->construct(cst, rootcontext.node, &rootcontext, &jr);
+      joqe_ctx rootcontext = {NULL, &rdoc.ls->n, bdoc.index};
+      if(vm)
+        joqe_vm_run(vm, rootcontext.node, &rootcontext, &jr);
+      else
+        cst->construct(cst, rootcontext.node, &rootcontext, &jr);
     } else {
       joqe_nodels *i;
       if((i = rdoc.ls)) do {
@@ -404,12 +479,14 @@ main(int argc, char **argv)
       printf("\n");
     } while((ls = (joqe_nodels*)ls->ll.n) != jr.ls);
 
-    joqe_result_destroy(&jr);
-    joqe_result_destroy(&rdoc);
-
+    // the results and the document are released with the arena.
+    bdoc.root.construct = 0;
     joqe_build_destroy(&bdoc);
   } while(++i < argc);
 
+  joqe_arena_destroy(arena);
+
+  joqe_vm_destroy(vm);
   joqe_build_destroy(&exp);
   return r;
 }
@@ -0,0 +1,2290 @@
+/* A Bison parser, made by GNU Bison 3.8.2.  */
+
+/* Bison implementation for Yacc-like parsers in C
+
+   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2021 Free Software Foundation,
+   Inc.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
+
+/* As a special exception, you may create a larger work that contains
+   part or all of the Bison parser skeleton and distribute that work
+   under terms of your choice, so long as that work isn't itself a
+   parser generator using the skeleton or a modified version thereof
+   as a parser skeleton.  Alternatively, if you modify or redistribute
+   the parser skeleton itself, you may (at your option) remove this
+   special exception, which will cause the skeleton and the resulting
+   Bison output files to be licensed under the GNU General Public
+   License without this special exception.
+
+   This special exception was added by the Free Software Foundation in
+   version 2.2 of Bison.  */
+
+/* C LALR(1) parser skeleton written by Richard Stallman, by
+   simplifying the original so-called "semantic" parser.  */
+
+/* DO NOT RELY ON FEATURES THAT ARE NOT DOCUMENTED in the manual,
+   especially those whose name start with YY_ or yy_.  They are
+   private implementation details that can be changed or removed.  */
+
+/* All symbols defined below should begin with yy or YY, to avoid
+   infringing on user name space.  This should be done even for local
+   variables, as they might otherwise be expanded by user macros.
+   There are some unavoidable exceptions within include files to
+   define necessary library symbols; they are noted "INFRINGES ON
+   USER NAME SPACE" below.  */
+
+/* Identify Bison output, and Bison version.  */
+#define YYBISON 30802
+
+/* Bison version string.  */
+#define YYBISON_VERSION "3.8.2"
+
+/* Skeleton name.  */
+#define YYSKELETON_NAME "yacc.c"
+
+/* Pure parsers.  */
+#define YYPURE 1
+
+/* Push parsers.  */
+#define YYPUSH 0
+
+/* Pull parsers.  */
+#define YYPULL 1
+
+/* Substitute the type names.  */
+#define YYSTYPE         JOQE_YYSTYPE
+/* Substitute the variable and function names.  */
+#define yyparse         joqe_yyparse
+#define yylex           joqe_yylex
+#define yyerror         joqe_yyerror
+#define yydebug         joqe_yydebug
+#define yynerrs         joqe_yynerrs
+
+/* First part of user prologue.  */
+#line 32 "joqe.y"
+
+#include <stdint.h>
+#include "ast.h"
+#include "lex-source.h"
+#include "build.h"
+
+#line 84 "src/joqe.tab.c"
+
+# ifndef YY_CAST
+#  ifdef __cplusplus
+#   define YY_CAST(Type, Val) static_cast<Type> (Val)
+#   define YY_REINTERPRET_CAST(Type, Val) reinterpret_cast<Type> (Val)
+#  else
+#   define YY_CAST(Type, Val) ((Type) (Val))
+#   define YY_REINTERPRET_CAST(Type, Val) ((Type) (Val))
+#  endif
+# endif
+# ifndef YY_NULLPTR
+#  if defined __cplusplus
+#   if 201103L <= __cplusplus
+#    define YY_NULLPTR nullptr
+#   else
+#    define YY_NULLPTR 0
+#   endif
+#  else
+#   define YY_NULLPTR ((void*)0)
+#  endif
+# endif
+
+#include "joqe.tab.h"
+/* Symbol kind.  */
+enum yysymbol_kind_t
+{
+  YYSYMBOL_YYEMPTY = -2,
+  YYSYMBOL_YYEOF = 0,                      /* "end of file"  */
+  YYSYMBOL_YYerror = 1,                    /* error  */
+  YYSYMBOL_YYUNDEF = 2,                    /* "invalid token"  */
+  YYSYMBOL_IDENTIFIER = 3,                 /* IDENTIFIER  */
+  YYSYMBOL_STRING = 4,                     /* STRING  */
+  YYSYMBOL_PARTIALSTRING = 5,              /* PARTIALSTRING  */
+  YYSYMBOL_INTEGER = 6,                    /* INTEGER  */
+  YYSYMBOL_REAL = 7,                       /* REAL  */
+  YYSYMBOL__TRUE = 8,                      /* _TRUE  */
+  YYSYMBOL__FALSE = 9,                     /* _FALSE  */
+  YYSYMBOL__NULL = 10,                     /* _NULL  */
+  YYSYMBOL_MOD = 11,                       /* MOD  */
+  YYSYMBOL_NEQ = 12,                       /* NEQ  */
+  YYSYMBOL_LEQ = 13,                       /* LEQ  */
+  YYSYMBOL_GEQ = 14,                       /* GEQ  */
+  YYSYMBOL_AND = 15,                       /* AND  */
+  YYSYMBOL_OR = 16,                        /* OR  */
+  YYSYMBOL_NOT = 17,                       /* NOT  */
+  YYSYMBOL_DOT2 = 18,                      /* DOT2  */
+  YYSYMBOL_SLASH = 19,                     /* SLASH  */
+  YYSYMBOL_C2 = 20,                        /* C2  */
+  YYSYMBOL_INVALID_STRING = 21,            /* INVALID_STRING  */
+  YYSYMBOL_SHORTSTRING = 22,               /* SHORTSTRING  */
+  YYSYMBOL_23_ = 23,                       /* '+'  */
+  YYSYMBOL_24_ = 24,                       /* '-'  */
+  YYSYMBOL_25_ = 25,                       /* '*'  */
+  YYSYMBOL_26_ = 26,                       /* '/'  */
+  YYSYMBOL_27_ = 27,                       /* '%'  */
+  YYSYMBOL_28_ = 28,                       /* '('  */
+  YYSYMBOL_29_ = 29,                       /* ')'  */
+  YYSYMBOL_30_ = 30,                       /* '='  */
+  YYSYMBOL_31_ = 31,                       /* '<'  */
+  YYSYMBOL_32_ = 32,                       /* '>'  */
+  YYSYMBOL_33_ = 33,                       /* '|'  */
+  YYSYMBOL_34_ = 34,                       /* '.'  */
+  YYSYMBOL_35_ = 35,                       /* '['  */
+  YYSYMBOL_36_ = 36,                       /* ']'  */
+  YYSYMBOL_37_ = 37,                       /* ','  */
+  YYSYMBOL_38_ = 38,                       /* '{'  */
+  YYSYMBOL_39_ = 39,                       /* '}'  */
+  YYSYMBOL_40_ = 40,                       /* ':'  */
+  YYSYMBOL_YYACCEPT = 41,                  /* $accept  */
+  YYSYMBOL_start = 42,                     /* start  */
+  YYSYMBOL_expr = 43,                      /* expr  */
+  YYSYMBOL_scalar = 44,                    /* scalar  */
+  YYSYMBOL_string = 45,                    /* string  */
+  YYSYMBOL_46_part_string = 46,            /* part-string  */
+  YYSYMBOL_47_or_expr = 47,                /* or-expr  */
+  YYSYMBOL_48_and_expr = 48,               /* and-expr  */
+  YYSYMBOL_49_test_expr = 49,              /* test-expr  */
+  YYSYMBOL_50_term_expr = 50,              /* term-expr  */
+  YYSYMBOL_term = 51,                      /* term  */
+  YYSYMBOL_factor = 52,                    /* factor  */
+  YYSYMBOL_unary = 53,                     /* unary  */
+  YYSYMBOL_54_compare_op = 54,             /* compare-op  */
+  YYSYMBOL_55_node_set = 55,               /* node-set  */
+  YYSYMBOL_56_node_path = 56,              /* node-path  */
+  YYSYMBOL_name = 57,                      /* name  */
+  YYSYMBOL_filter = 58,                    /* filter  */
+  YYSYMBOL_function = 59,                  /* function  */
+  YYSYMBOL_params = 60,                    /* params  */
+  YYSYMBOL_61_simple_construct = 61,       /* simple-construct  */
+  YYSYMBOL_62_construct_expr = 62,         /* construct-expr  */
+  YYSYMBOL_63_object_construct = 63,       /* object-construct  */
+  YYSYMBOL_64_object_entries = 64,         /* object-entries  */
+  YYSYMBOL_65_object_entry = 65,           /* object-entry  */
+  YYSYMBOL_66_array_construct = 66,        /* array-construct  */
+  YYSYMBOL_67_array_entries = 67,          /* array-entries  */
+  YYSYMBOL_68_array_entry = 68             /* array-entry  */
+};
+typedef enum yysymbol_kind_t yysymbol_kind_t;
+
+
+/* Second part of user prologue.  */
+#line 55 "joqe.y"
+
+#include "lex.h"
+#include "err.h"
+
+#line 191 "src/joqe.tab.c"
+
+
+#ifdef short
+# undef short
+#endif
+
+/* On compilers that do not define __PTRDIFF_MAX__ etc., make sure
+   <limits.h> and (if available) <stdint.h> are included
+   so that the code can choose integer types of a good width.  */
+
+#ifndef __PTRDIFF_MAX__
+# include <limits.h> /* INFRINGES ON USER NAME SPACE */
+# if defined __STDC_VERSION__ && 199901 <= __STDC_VERSION__
+#  include <stdint.h> /* INFRINGES ON USER NAME SPACE */
+#  define YY_STDINT_H
+# endif
+#endif
+
+/* Narrow types that promote to a signed type and that can represent a
+   signed or unsigned integer of at least N bits.  In tables they can
+   save space and decrease cache pressure.  Promoting to a signed type
+   helps avoid bugs in integer arithmetic.  */
+
+#ifdef __INT_LEAST8_MAX__
+typedef __INT_LEAST8_TYPE__ yytype_int8;
+#elif defined YY_STDINT_H
+typedef int_least8_t yytype_int8;
+#else
+typedef signed char yytype_int8;
+#endif
+
+#ifdef __INT_LEAST16_MAX__
+typedef __INT_LEAST16_TYPE__ yytype_int16;
+#elif defined YY_STDINT_H
+typedef int_least16_t yytype_int16;
+#else
+typedef short yytype_int16;
+#endif
+
+/* Work around bug in HP-UX 11.23, which defines these macros
+   incorrectly for preprocessor constants.  This workaround can likely
+   be removed in 2023, as HPE has promised support for HP-UX 11.23
+   (aka HP-UX 11i v2) only through the end of 2022; see Table 2 of
+   <https://h20195.www2.hpe.com/V2/getpdf.aspx/4AA4-7673ENW.pdf>.  */
+#ifdef __hpux
+# undef UINT_LEAST8_MAX
+# undef UINT_LEAST16_MAX
+# define UINT_LEAST8_MAX 255
+# define UINT_LEAST16_MAX 65535
+#endif
+
+#if defined __UINT_LEAST8_MAX__ && __UINT_LEAST8_MAX__ <= __INT_MAX__
+typedef __UINT_LEAST8_TYPE__ yytype_uint8;
+#elif (!defined __UINT_LEAST8_MAX__ && defined YY_STDINT_H \
+       && UINT_LEAST8_MAX <= INT_MAX)
+typedef uint_least8_t yytype_uint8;
+#elif !defined __UINT_LEAST8_MAX__ && UCHAR_MAX <= INT_MAX
+typedef unsigned char yytype_uint8;
+#else
+typedef short yytype_uint8;
+#endif
+
+#if defined __UINT_LEAST16_MAX__ && __UINT_LEAST16_MAX__ <= __INT_MAX__
+typedef __UINT_LEAST16_TYPE__ yytype_uint16;
+#elif (!defined __UINT_LEAST16_MAX__ && defined YY_STDINT_H \
+       && UINT_LEAST16_MAX <= INT_MAX)
+typedef uint_least16_t yytype_uint16;
+#elif !defined __UINT_LEAST16_MAX__ && USHRT_MAX <= INT_MAX
+typedef unsigned short yytype_uint16;
+#else
+typedef int yytype_uint16;
+#endif
+
+#ifndef YYPTRDIFF_T
+# if defined __PTRDIFF_TYPE__ && defined __PTRDIFF_MAX__
+#  define YYPTRDIFF_T __PTRDIFF_TYPE__
+#  define YYPTRDIFF_MAXIMUM __PTRDIFF_MAX__
+# elif defined PTRDIFF_MAX
+#  ifndef ptrdiff_t
+#   include <stddef.h> /* INFRINGES ON USER NAME SPACE */
+#  endif
+#  define YYPTRDIFF_T ptrdiff_t
+#  define YYPTRDIFF_MAXIMUM PTRDIFF_MAX
+# else
+#  define YYPTRDIFF_T long
+#  define YYPTRDIFF_MAXIMUM LONG_MAX
+# endif
+#endif
+
+#ifndef YYSIZE_T
+# ifdef __SIZE_TYPE__
+#  define YYSIZE_T __SIZE_TYPE__
+# elif defined size_t
+#  define YYSIZE_T size_t
+# elif defined __STDC_VERSION__ && 199901 <= __STDC_VERSION__
+#  include <stddef.h> /* INFRINGES ON USER NAME SPACE */
+#  define YYSIZE_T size_t
+# else
+#  define YYSIZE_T unsigned
+# endif
+#endif
+
+#define YYSIZE_MAXIMUM                                  \
+  YY_CAST (YYPTRDIFF_T,                                 \
+           (YYPTRDIFF_MAXIMUM < YY_CAST (YYSIZE_T, -1)  \
+            ? YYPTRDIFF_MAXIMUM                         \
+            : YY_CAST (YYSIZE_T, -1)))
+
+#define YYSIZEOF(X) YY_CAST (YYPTRDIFF_T, sizeof (X))
+
+
+/* Stored state numbers (used for stacks). */
+typedef yytype_uint8 yy_state_t;
+
+/* State numbers in computations.  */
+typedef int yy_state_fast_t;
+
+#ifndef YY_
+# if defined YYENABLE_NLS && YYENABLE_NLS
+#  if ENABLE_NLS
+#   include <libintl.h> /* INFRINGES ON USER NAME SPACE */
+#   define YY_(Msgid) dgettext ("bison-runtime", Msgid)
+#  endif
+# endif
+# ifndef YY_
+#  define YY_(Msgid) Msgid
+# endif
+#endif
+
+
+#ifndef YY_ATTRIBUTE_PURE
+# if defined __GNUC__ && 2 < __GNUC__ + (96 <= __GNUC_MINOR__)
+#  define YY_ATTRIBUTE_PURE __attribute__ ((__pure__))
+# else
+#  define YY_ATTRIBUTE_PURE
+# endif
+#endif
+
+#ifndef YY_ATTRIBUTE_UNUSED
+# if defined __GNUC__ && 2 < __GNUC__ + (7 <= __GNUC_MINOR__)
+#  define YY_ATTRIBUTE_UNUSED __attribute__ ((__unused__))
+# else
+#  define YY_ATTRIBUTE_UNUSED
+# endif
+#endif
+
+/* Suppress unused-variable warnings by "using" E.  */
+#if ! defined lint || defined __GNUC__
+# define YY_USE(E) ((void) (E))
+#else
+# define YY_USE(E) /* empty */
+#endif
+
+/* Suppress an incorrect diagnostic about yylval being uninitialized.  */
+#if defined __GNUC__ && ! defined __ICC && 406 <= __GNUC__ * 100 + __GNUC_MINOR__
+# if __GNUC__ * 100 + __GNUC_MINOR__ < 407
+#  define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                           \
+    _Pragma ("GCC diagnostic push")                                     \
+    _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")
+# else
+#  define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                           \
+    _Pragma ("GCC diagnostic push")                                     \
+    _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")              \
+    _Pragma ("GCC diagnostic ignored \"-Wmaybe-uninitialized\"")
+# endif
+# define YY_IGNORE_MAYBE_UNINITIALIZED_END      \
+    _Pragma ("GCC diagnostic pop")
+#else
+# define YY_INITIAL_VALUE(Value) Value
+#endif
+#ifndef YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+# define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+# define YY_IGNORE_MAYBE_UNINITIALIZED_END
+#endif
+#ifndef YY_INITIAL_VALUE
+# define YY_INITIAL_VALUE(Value) /* Nothing. */
+#endif
+
+#if defined __cplusplus && defined __GNUC__ && ! defined __ICC && 6 <= __GNUC__
+# define YY_IGNORE_USELESS_CAST_BEGIN                          \
+    _Pragma ("GCC diagnostic push")                            \
+    _Pragma ("GCC diagnostic ignored \"-Wuseless-cast\"")
+# define YY_IGNORE_USELESS_CAST_END            \
+    _Pragma ("GCC diagnostic pop")
+#endif
+#ifndef YY_IGNORE_USELESS_CAST_BEGIN
+# define YY_IGNORE_USELESS_CAST_BEGIN
+# define YY_IGNORE_USELESS_CAST_END
+#endif
+
+
+#define YY_ASSERT(E) ((void) (0 && (E)))
+
+#if 1
+
+/* The parser invokes alloca or malloc; define the necessary symbols.  */
+
+# ifdef YYSTACK_USE_ALLOCA
+#  if YYSTACK_USE_ALLOCA
+#   ifdef __GNUC__
+#    define YYSTACK_ALLOC __builtin_alloca
+#   elif defined __BUILTIN_VA_ARG_INCR
+#    include <alloca.h> /* INFRINGES ON USER NAME SPACE */
+#   elif defined _AIX
+#    define YYSTACK_ALLOC __alloca
+#   elif defined _MSC_VER
+#    include <malloc.h> /* INFRINGES ON USER NAME SPACE */
+#    define alloca _alloca
+#   else
+#    define YYSTACK_ALLOC alloca
+#    if ! defined _ALLOCA_H && ! defined EXIT_SUCCESS
+#     include <stdlib.h> /* INFRINGES ON USER NAME SPACE */
+      /* Use EXIT_SUCCESS as a witness for stdlib.h.  */
+#     ifndef EXIT_SUCCESS
+#      define EXIT_SUCCESS 0
+#     endif
+#    endif
+#   endif
+#  endif
+# endif
+
+# ifdef YYSTACK_ALLOC
+   /* Pacify GCC's 'empty if-body' warning.  */
+#  define YYSTACK_FREE(Ptr) do { /* empty */; } while (0)
+#  ifndef YYSTACK_ALLOC_MAXIMUM
+    /* The OS might guarantee only one guard page at the bottom of the stack,
+       and a page size can be as small as 4096 bytes.  So we cannot safely
+       invoke alloca (N) if N exceeds 4096.  Use a slightly smaller number
+       to allow for a few compiler-allocated temporary stack slots.  */
+#   define YYSTACK_ALLOC_MAXIMUM 4032 /* reasonable circa 2006 */
+#  endif
+# else
+#  define YYSTACK_ALLOC YYMALLOC
+#  define YYSTACK_FREE YYFREE
+#  ifndef YYSTACK_ALLOC_MAXIMUM
+#   define YYSTACK_ALLOC_MAXIMUM YYSIZE_MAXIMUM
+#  endif
+#  if (defined __cplusplus && ! defined EXIT_SUCCESS \
+       && ! ((defined YYMALLOC || defined malloc) \
+             && (defined YYFREE || defined free)))
+#   include <stdlib.h> /* INFRINGES ON USER NAME SPACE */
+#   ifndef EXIT_SUCCESS
+#    define EXIT_SUCCESS 0
+#   endif
+#  endif
+#  ifndef YYMALLOC
+#   define YYMALLOC malloc
+#   if ! defined malloc && ! defined EXIT_SUCCESS
+void *malloc (YYSIZE_T); /* INFRINGES ON USER NAME SPACE */
+#   endif
+#  endif
+#  ifndef YYFREE
+#   define YYFREE free
+#   if ! defined free && ! defined EXIT_SUCCESS
+void free (void *); /* INFRINGES ON USER NAME SPACE */
+#   endif
+#  endif
+# endif
+#endif /* 1 */
+
+#if (! defined yyoverflow \
+     && (! defined __cplusplus \
+         || (defined JOQE_YYSTYPE_IS_TRIVIAL && JOQE_YYSTYPE_IS_TRIVIAL)))
+
+/* A type that is properly aligned for any stack member.  */
+union yyalloc
+{
+  yy_state_t yyss_alloc;
+  YYSTYPE yyvs_alloc;
+};
+
+/* The size of the maximum gap between one aligned stack and the next.  */
+# define YYSTACK_GAP_MAXIMUM (YYSIZEOF (union yyalloc) - 1)
+
+/* The size of an array large to enough to hold all stacks, each with
+   N elements.  */
+# define YYSTACK_BYTES(N) \
+     ((N) * (YYSIZEOF (yy_state_t) + YYSIZEOF (YYSTYPE)) \
+      + YYSTACK_GAP_MAXIMUM)
+
+# define YYCOPY_NEEDED 1
+
+/* Relocate STACK from its old location to the new one.  The
+   local variables YYSIZE and YYSTACKSIZE give the old and new number of
+   elements in the stack, and YYPTR gives the new location of the
+   stack.  Advance YYPTR to a properly aligned location for the next
+   stack.  */
+# define YYSTACK_RELOCATE(Stack_alloc, Stack)                           \
+    do                                                                  \
+      {                                                                 \
+        YYPTRDIFF_T yynewbytes;                                         \
+        YYCOPY (&yyptr->Stack_alloc, Stack, yysize);                    \
+        Stack = &yyptr->Stack_alloc;                                    \
+        yynewbytes = yystacksize * YYSIZEOF (*Stack) + YYSTACK_GAP_MAXIMUM; \
+        yyptr += yynewbytes / YYSIZEOF (*yyptr);                        \
+      }                                                                 \
+    while (0)
+
+#endif
+
+#if defined YYCOPY_NEEDED && YYCOPY_NEEDED
+/* Copy COUNT objects from SRC to DST.  The source and destination do
+   not overlap.  */
+# ifndef YYCOPY
+#  if defined __GNUC__ && 1 < __GNUC__
+#   define YYCOPY(Dst, Src, Count) \
+      __builtin_memcpy (Dst, Src, YY_CAST (YYSIZE_T, (Count)) * sizeof (*(Src)))
+#  else
+#   define YYCOPY(Dst, Src, Count)              \
+      do                                        \
+        {                                       \
+          YYPTRDIFF_T yyi;                      \
+          for (yyi = 0; yyi < (Count); yyi++)   \
+            (Dst)[yyi] = (Src)[yyi];            \
+        }                                       \
+      while (0)
+#  endif
+# endif
+#endif /* !YYCOPY_NEEDED */
+
+/* YYFINAL -- State number of the termination state.  */
+#define YYFINAL  59
+/* YYLAST -- Last index in YYTABLE.  */
+#define YYLAST   356
+
+/* YYNTOKENS -- Number of terminals.  */
+#define YYNTOKENS  41
+/* YYNNTS -- Number of nonterminals.  */
+#define YYNNTS  28
+/* YYNRULES -- Number of rules.  */
+#define YYNRULES  87
+/* YYNSTATES -- Number of states.  */
+#define YYNSTATES  129
+
+/* YYMAXUTOK -- Last valid token kind.  */
+#define YYMAXUTOK   277
+
+
+/* YYTRANSLATE(TOKEN-NUM) -- Symbol number corresponding to TOKEN-NUM
+   as returned by yylex, with out-of-bounds checking.  */
+#define YYTRANSLATE(YYX)                                \
+  (0 <= (YYX) && (YYX) <= YYMAXUTOK                     \
+   ? YY_CAST (yysymbol_kind_t, yytranslate[YYX])        \
+   : YYSYMBOL_YYUNDEF)
+
+/* YYTRANSLATE[TOKEN-NUM] -- Symbol number corresponding to TOKEN-NUM
+   as returned by yylex.  */
+static const yytype_int8 yytranslate[] =
+{
+       0,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,    27,     2,     2,
+      28,    29,    25,    23,    37,    24,    34,    26,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,    40,     2,
+      31,    30,    32,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,    35,     2,    36,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,    38,    33,    39,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     1,     2,     3,     4,
+       5,     6,     7,     8,     9,    10,    11,    12,    13,    14,
+      15,    16,    17,    18,    19,    20,    21,    22
+};
+
+#if JOQE_YYDEBUG
+/* YYRLINE[YYN] -- Source line where rule number YYN was defined.  */
+static const yytype_int16 yyrline[] =
+{
+       0,    65,    65,    69,    78,    80,    81,    82,    83,    84,
+      85,    88,    89,    90,    92,    93,    96,    97,    99,   100,
+     102,   103,   105,   106,   107,   109,   110,   111,   112,   113,
+     115,   116,   117,   118,   120,   121,   123,   124,   126,   127,
+     128,   129,   130,   131,   133,   134,   136,   137,   138,   139,
+     144,   149,   154,   159,   166,   173,   175,   176,   182,   187,
+     191,   192,   199,   201,   202,   204,   212,   215,   219,   227,
+     228,   229,   231,   232,   236,   237,   238,   243,   248,   253,
+     255,   256,   259,   260,   261,   267,   272,   276
+};
+#endif
+
+/** Accessing symbol of state STATE.  */
+#define YY_ACCESSING_SYMBOL(State) YY_CAST (yysymbol_kind_t, yystos[State])
+
+#if 1
+/* The user-facing name of the symbol whose (internal) number is
+   YYSYMBOL.  No bounds checking.  */
+static const char *yysymbol_name (yysymbol_kind_t yysymbol) YY_ATTRIBUTE_UNUSED;
+
+/* YYTNAME[SYMBOL-NUM] -- String name of the symbol SYMBOL-NUM.
+   First, the terminals, then, starting at YYNTOKENS, nonterminals.  */
+static const char *const yytname[] =
+{
+  "\"end of file\"", "error", "\"invalid token\"", "IDENTIFIER", "STRING",
+  "PARTIALSTRING", "INTEGER", "REAL", "_TRUE", "_FALSE", "_NULL", "MOD",
+  "NEQ", "LEQ", "GEQ", "AND", "OR", "NOT", "DOT2", "SLASH", "C2",
+  "INVALID_STRING", "SHORTSTRING", "'+'", "'-'", "'*'", "'/'", "'%'",
+  "'('", "')'", "'='", "'<'", "'>'", "'|'", "'.'", "'['", "']'", "','",
+  "'{'", "'}'", "':'", "$accept", "start", "expr", "scalar", "string",
+  "part-string", "or-expr", "and-expr", "test-expr", "term-expr", "term",
+  "factor", "unary", "compare-op", "node-set", "node-path", "name",
+  "filter", "function", "params", "simple-construct", "construct-expr",
+  "object-construct", "object-entries", "object-entry", "array-construct",
+  "array-entries", "array-entry", YY_NULLPTR
+};
+
+static const char *
+yysymbol_name (yysymbol_kind_t yysymbol)
+{
+  return yytname[yysymbol];
+}
+#endif
+
+#define YYPACT_NINF (-75)
+
+#define yypact_value_is_default(Yyn) \
+  ((Yyn) == YYPACT_NINF)
+
+#define YYTABLE_NINF (-1)
+
+#define yytable_value_is_error(Yyn) \
+  0
+
+/* YYPACT[STATE-NUM] -- Index in YYTABLE of the portion describing
+   STATE-NUM.  */
+static const yytype_int16 yypact[] =
+{
+      15,    16,   -75,   -75,   -75,   -75,   -75,   -75,   -75,   -75,
+     322,     0,    12,   322,   322,    12,   222,    12,   150,    76,
+      31,   -75,   -75,    41,    59,    54,    61,   -75,   321,    35,
+     -75,   -75,    45,    24,    63,   -75,   -75,    67,   -75,   -75,
+     -75,   -75,   290,   -75,   -75,   -75,   -75,   -75,    69,    81,
+     -75,   -75,    67,    53,   -75,   -75,     7,   -25,   -75,   -75,
+     -75,   -75,   -75,   290,   290,   -75,   -75,   -75,   290,   290,
+     -75,   -75,   -75,   290,   290,   290,   290,   290,    10,     5,
+      12,   290,   258,   222,   -75,    77,   -75,   222,   -75,   186,
+     222,   222,   113,   -75,    61,   -75,    35,    35,    73,   -75,
+     -75,   -75,   -75,    24,   290,    63,   -75,    63,   -75,    88,
+     -75,   -75,   -27,   -75,   -75,    74,   -75,   -75,   -75,    67,
+     -75,   -75,    89,   -75,   -75,   290,   -75,   -75,   -75
+};
+
+/* YYDEFACT[STATE-NUM] -- Default reduction number in state STATE-NUM.
+   Performed when YYTABLE does not specify something else to do.  Zero
+   means the default is an error.  */
+static const yytype_int8 yydefact[] =
+{
+       0,     0,    62,    11,    14,     6,     7,     8,     9,    10,
+       0,     0,    48,     0,     0,    47,     0,    46,     0,     0,
+       0,    71,    34,     5,     0,     4,    16,    18,    20,    22,
+      25,    30,    35,    44,    49,    59,    72,     2,    69,    70,
+       3,    33,    63,    53,    52,    32,    31,    51,    71,     0,
+      50,    84,    87,     0,    85,    76,    80,     0,    77,     1,
+      12,    13,    15,     0,     0,    39,    41,    43,     0,     0,
+      38,    40,    42,     0,     0,     0,     0,     0,     0,     0,
+       0,    63,     0,     0,    64,     0,    36,     0,    82,     0,
+       0,     0,     0,    74,    17,    19,    23,    24,    21,    29,
+      26,    27,    28,    45,    63,    57,    61,    55,    60,     0,
+      66,    67,     0,    73,    54,    71,    83,    86,    81,    79,
+      75,    78,     0,    56,    65,     0,    37,    58,    68
+};
+
+/* YYPGOTO[NTERM-NUM].  */
+static const yytype_int8 yypgoto[] =
+{
+     -75,   -75,   -16,   -75,   -75,   -75,   -75,    49,    62,    55,
+      37,   -20,    38,   -75,   -75,    51,    -6,   -74,    28,   -75,
+     -15,     1,   -75,   -75,   -23,   -75,   -75,    44
+};
+
+/* YYDEFGOTO[NTERM-NUM].  */
+static const yytype_int8 yydefgoto[] =
+{
+       0,    20,    21,    22,    23,    24,    25,    26,    27,    28,
+      29,    30,    31,    73,    32,    33,    34,    85,    35,   112,
+      36,    52,    38,    57,    58,    39,    53,    54
+};
+
+/* YYTABLE[YYPACT[STATE-NUM]] -- What to do in state STATE-NUM.  If
+   positive, shift that token.  If negative, reduce the rule whose
+   number is the opposite.  If YYTABLE_NINF, syntax error.  */
+static const yytype_uint8 yytable[] =
+{
+      48,    37,   124,     2,    56,    43,    44,   109,     2,    47,
+     125,    50,    92,     2,    93,     2,     1,    49,     2,     3,
+       4,     5,     6,     7,     8,     9,    84,    90,    11,    12,
+     122,    59,    10,    11,    12,    42,    15,    40,    13,    14,
+     104,    15,    79,    16,    17,    60,    74,    91,    41,    17,
+      18,    45,    46,    19,    99,   100,   101,   102,    80,    81,
+      75,    76,    77,    61,    62,    84,   111,   118,   113,   121,
+      63,   115,   113,   105,   107,    56,    64,    56,    78,     2,
+       3,     4,     5,     6,     7,     8,     9,    83,    84,    88,
+      89,    82,   119,    10,    11,    12,    68,    69,    86,    13,
+      14,    87,    15,   126,    16,    96,    97,   106,   108,   128,
+      17,    18,    94,   114,    19,    55,     2,     3,     4,     5,
+       6,     7,     8,     9,   123,   127,    95,     0,    98,   103,
+      10,    11,    12,   117,     0,     0,    13,    14,     0,    15,
+       0,    16,     0,     0,     0,     0,     0,    17,    18,     0,
+       0,    19,   120,     2,     3,     4,     5,     6,     7,     8,
+       9,     0,     0,     0,     0,     0,     0,    10,    11,    12,
+       0,     0,     0,    13,    14,     0,    15,     0,    16,     0,
+       0,     0,     0,     0,    17,    18,    51,     0,    19,     2,
+       3,     4,     5,     6,     7,     8,     9,     0,     0,     0,
+       0,     0,     0,    10,    11,    12,     0,     0,     0,    13,
+      14,     0,    15,     0,    16,     0,     0,     0,     0,     0,
+      17,    18,   116,     0,    19,     2,     3,     4,     5,     6,
+       7,     8,     9,     0,     0,     0,     0,     0,     0,    10,
+      11,    12,     0,     0,     0,    13,    14,     0,    15,     0,
+      16,     0,     0,     0,     0,     0,    17,    18,     0,     0,
+      19,     2,     3,     4,     5,     6,     7,     8,     9,     0,
+       0,     0,     0,     0,     0,    10,    11,    12,     0,     0,
+       0,    13,    14,     0,    15,     0,    16,   110,     0,     0,
+       0,     0,    17,     2,     3,     4,     5,     6,     7,     8,
+       9,     0,     0,     0,     0,     0,     0,    10,    11,    12,
+       0,     0,     0,    13,    14,     0,    15,     0,    16,     0,
+       0,     0,     0,     0,    17,     2,     3,     4,     5,     6,
+       7,     8,     9,    65,    66,    67,     0,     0,     0,     0,
+      11,    12,     0,     0,    68,    69,     0,     0,    15,     0,
+      16,    70,    71,    72,     0,     0,    17
+};
+
+static const yytype_int8 yycheck[] =
+{
+      16,     0,    29,     3,    19,    11,    12,    81,     3,    15,
+      37,    17,    37,     3,    39,     3,     1,    16,     3,     4,
+       5,     6,     7,     8,     9,    10,    42,    20,    18,    19,
+     104,     0,    17,    18,    19,    35,    26,    21,    23,    24,
+      35,    26,    18,    28,    34,     4,    11,    40,    10,    34,
+      35,    13,    14,    38,    74,    75,    76,    77,    34,    35,
+      25,    26,    27,     4,     5,    81,    82,    90,    83,    92,
+      16,    87,    87,    79,    80,    90,    15,    92,    33,     3,
+       4,     5,     6,     7,     8,     9,    10,    20,   104,    36,
+      37,    28,    91,    17,    18,    19,    23,    24,    29,    23,
+      24,    20,    26,    29,    28,    68,    69,    79,    80,   125,
+      34,    35,    63,    36,    38,    39,     3,     4,     5,     6,
+       7,     8,     9,    10,    36,    36,    64,    -1,    73,    78,
+      17,    18,    19,    89,    -1,    -1,    23,    24,    -1,    26,
+      -1,    28,    -1,    -1,    -1,    -1,    -1,    34,    35,    -1,
+      -1,    38,    39,     3,     4,     5,     6,     7,     8,     9,
+      10,    -1,    -1,    -1,    -1,    -1,    -1,    17,    18,    19,
+      -1,    -1,    -1,    23,    24,    -1,    26,    -1,    28,    -1,
+      -1,    -1,    -1,    -1,    34,    35,    36,    -1,    38,     3,
+       4,     5,     6,     7,     8,     9,    10,    -1,    -1,    -1,
+      -1,    -1,    -1,    17,    18,    19,    -1,    -1,    -1,    23,
+      24,    -1,    26,    -1,    28,    -1,    -1,    -1,    -1,    -1,
+      34,    35,    36,    -1,    38,     3,     4,     5,     6,     7,
+       8,     9,    10,    -1,    -1,    -1,    -1,    -1,    -1,    17,
+      18,    19,    -1,    -1,    -1,    23,    24,    -1,    26,    -1,
+      28,    -1,    -1,    -1,    -1,    -1,    34,    35,    -1,    -1,
+      38,     3,     4,     5,     6,     7,     8,     9,    10,    -1,
+      -1,    -1,    -1,    -1,    -1,    17,    18,    19,    -1,    -1,
+      -1,    23,    24,    -1,    26,    -1,    28,    29,    -1,    -1,
+      -1,    -1,    34,     3,     4,     5,     6,     7,     8,     9,
+      10,    -1,    -1,    -1,    -1,    -1,    -1,    17,    18,    19,
+      -1,    -1,    -1,    23,    24,    -1,    26,    -1,    28,    -1,
+      -1,    -1,    -1,    -1,    34,     3,     4,     5,     6,     7,
+       8,     9,    10,    12,    13,    14,    -1,    -1,    -1,    -1,
+      18,    19,    -1,    -1,    23,    24,    -1,    -1,    26,    -1,
+      28,    30,    31,    32,    -1,    -1,    34
+};
+
+/* YYSTOS[STATE-NUM] -- The symbol kind of the accessing symbol of
+   state STATE-NUM.  */
+static const yytype_int8 yystos[] =
+{
+       0,     1,     3,     4,     5,     6,     7,     8,     9,    10,
+      17,    18,    19,    23,    24,    26,    28,    34,    35,    38,
+      42,    43,    44,    45,    46,    47,    48,    49,    50,    51,
+      52,    53,    55,    56,    57,    59,    61,    62,    63,    66,
+      21,    53,    35,    57,    57,    53,    53,    57,    43,    62,
+      57,    36,    62,    67,    68,    39,    61,    64,    65,     0,
+       4,     4,     5,    16,    15,    12,    13,    14,    23,    24,
+      30,    31,    32,    54,    11,    25,    26,    27,    33,    18,
+      34,    35,    28,    20,    43,    58,    29,    20,    36,    37,
+      20,    40,    37,    39,    48,    49,    51,    51,    50,    52,
+      52,    52,    52,    56,    35,    57,    59,    57,    59,    58,
+      29,    43,    60,    61,    36,    43,    36,    68,    65,    62,
+      39,    65,    58,    36,    29,    37,    29,    36,    43
+};
+
+/* YYR1[RULE-NUM] -- Symbol kind of the left-hand side of rule RULE-NUM.  */
+static const yytype_int8 yyr1[] =
+{
+       0,    41,    42,    42,    43,    44,    44,    44,    44,    44,
+      44,    45,    45,    45,    46,    46,    47,    47,    48,    48,
+      49,    49,    50,    50,    50,    51,    51,    51,    51,    51,
+      52,    52,    52,    52,    53,    53,    53,    53,    54,    54,
+      54,    54,    54,    54,    55,    55,    56,    56,    56,    56,
+      56,    56,    56,    56,    56,    56,    56,    56,    56,    56,
+      56,    56,    57,    58,    58,    59,    59,    60,    60,    61,
+      61,    61,    62,    62,    63,    63,    63,    64,    64,    65,
+      65,    65,    66,    66,    66,    67,    67,    68
+};
+
+/* YYR2[RULE-NUM] -- Number of symbols on the right-hand side of rule RULE-NUM.  */
+static const yytype_int8 yyr2[] =
+{
+       0,     2,     1,     2,     1,     1,     1,     1,     1,     1,
+       1,     1,     2,     2,     1,     2,     1,     3,     1,     3,
+       1,     3,     1,     3,     3,     1,     3,     3,     3,     3,
+       1,     2,     2,     2,     1,     1,     3,     5,     1,     1,
+       1,     1,     1,     1,     1,     3,     1,     1,     1,     1,
+       2,     2,     2,     2,     4,     3,     4,     3,     5,     1,
+       3,     3,     1,     0,     1,     4,     3,     1,     3,     1,
+       1,     1,     1,     3,     3,     4,     2,     1,     3,     3,
+       1,     3,     3,     4,     2,     1,     3,     1
+};
+
+
+enum { YYENOMEM = -2 };
+
+#define yyerrok         (yyerrstatus = 0)
+#define yyclearin       (yychar = JOQE_YYEMPTY)
+
+#define YYACCEPT        goto yyacceptlab
+#define YYABORT         goto yyabortlab
+#define YYERROR         goto yyerrorlab
+#define YYNOMEM         goto yyexhaustedlab
+
+
+#define YYRECOVERING()  (!!yyerrstatus)
+
+#define YYBACKUP(Token, Value)                                    \
+  do                                                              \
+    if (yychar == JOQE_YYEMPTY)                                        \
+      {                                                           \
+        yychar = (Token);                                         \
+        yylval = (Value);                                         \
+        YYPOPSTACK (yylen);                                       \
+        yystate = *yyssp;                                         \
+        goto yybackup;                                            \
+      }                                                           \
+    else                                                          \
+      {                                                           \
+        yyerror (build, YY_("syntax error: cannot back up")); \
+        YYERROR;                                                  \
+      }                                                           \
+  while (0)
+
+/* Backward compatibility with an undocumented macro.
+   Use JOQE_YYerror or JOQE_YYUNDEF. */
+#define YYERRCODE JOQE_YYUNDEF
+
+
+/* Enable debugging if requested.  */
+#if JOQE_YYDEBUG
+
+# ifndef YYFPRINTF
+#  include <stdio.h> /* INFRINGES ON USER NAME SPACE */
+#  define YYFPRINTF fprintf
+# endif
+
+# define YYDPRINTF(Args)                        \
+do {                                            \
+  if (yydebug)                                  \
+    YYFPRINTF Args;                             \
+} while (0)
+
+
+
+
+# define YY_SYMBOL_PRINT(Title, Kind, Value, Location)                    \
+do {                                                                      \
+  if (yydebug)                                                            \
+    {                                                                     \
+      YYFPRINTF (stderr, "%s ", Title);                                   \
+      yy_symbol_print (stderr,                                            \
+                  Kind, Value, build); \
+      YYFPRINTF (stderr, "\n");                                           \
+    }                                                                     \
+} while (0)
+
+
+/*-----------------------------------.
+| Print this symbol's value on YYO.  |
+`-----------------------------------*/
+
+static void
+yy_symbol_value_print (FILE *yyo,
+                       yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep, joqe_build *build)
+{
+  FILE *yyoutput = yyo;
+  YY_USE (yyoutput);
+  YY_USE (build);
+  if (!yyvaluep)
+    return;
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+  YY_USE (yykind);
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
+}
+
+
+/*---------------------------.
+| Print this symbol on YYO.  |
+`---------------------------*/
+
+static void
+yy_symbol_print (FILE *yyo,
+                 yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep, joqe_build *build)
+{
+  YYFPRINTF (yyo, "%s %s (",
+             yykind < YYNTOKENS ? "token" : "nterm", yysymbol_name (yykind));
+
+  yy_symbol_value_print (yyo, yykind, yyvaluep, build);
+  YYFPRINTF (yyo, ")");
+}
+
+/*------------------------------------------------------------------.
+| yy_stack_print -- Print the state stack from its BOTTOM up to its |
+| TOP (included).                                                   |
+`------------------------------------------------------------------*/
+
+static void
+yy_stack_print (yy_state_t *yybottom, yy_state_t *yytop)
+{
+  YYFPRINTF (stderr, "Stack now");
+  for (; yybottom <= yytop; yybottom++)
+    {
+      int yybot = *yybottom;
+      YYFPRINTF (stderr, " %d", yybot);
+    }
+  YYFPRINTF (stderr, "\n");
+}
+
+# define YY_STACK_PRINT(Bottom, Top)                            \
+do {                                                            \
+  if (yydebug)                                                  \
+    yy_stack_print ((Bottom), (Top));                           \
+} while (0)
+
+
+/*------------------------------------------------.
+| Report that the YYRULE is going to be reduced.  |
+`------------------------------------------------*/
+
+static void
+yy_reduce_print (yy_state_t *yyssp, YYSTYPE *yyvsp,
+                 int yyrule, joqe_build *build)
+{
+  int yylno = yyrline[yyrule];
+  int yynrhs = yyr2[yyrule];
+  int yyi;
+  YYFPRINTF (stderr, "Reducing stack by rule %d (line %d):\n",
+             yyrule - 1, yylno);
+  /* The symbols being reduced.  */
+  for (yyi = 0; yyi < yynrhs; yyi++)
+    {
+      YYFPRINTF (stderr, "   $%d = ", yyi + 1);
+      yy_symbol_print (stderr,
+                       YY_ACCESSING_SYMBOL (+yyssp[yyi + 1 - yynrhs]),
+                       &yyvsp[(yyi + 1) - (yynrhs)], build);
+      YYFPRINTF (stderr, "\n");
+    }
+}
+
+# define YY_REDUCE_PRINT(Rule)          \
+do {                                    \
+  if (yydebug)                          \
+    yy_reduce_print (yyssp, yyvsp, Rule, build); \
+} while (0)
+
+/* Nonzero means print parse trace.  It is left uninitialized so that
+   multiple parsers can coexist.  */
+int yydebug;
+#else /* !JOQE_YYDEBUG */
+# define YYDPRINTF(Args) ((void) 0)
+# define YY_SYMBOL_PRINT(Title, Kind, Value, Location)
+# define YY_STACK_PRINT(Bottom, Top)
+# define YY_REDUCE_PRINT(Rule)
+#endif /* !JOQE_YYDEBUG */
+
+
+/* YYINITDEPTH -- initial size of the parser's stacks.  */
+#ifndef YYINITDEPTH
+# define YYINITDEPTH 200
+#endif
+
+/* YYMAXDEPTH -- maximum size the stacks can grow to (effective only
+   if the built-in stack extension method is used).
+
+   Do not make this value too large; the results are undefined if
+   YYSTACK_ALLOC_MAXIMUM < YYSTACK_BYTES (YYMAXDEPTH)
+   evaluated with infinite-precision integer arithmetic.  */
+
+#ifndef YYMAXDEPTH
+# define YYMAXDEPTH 10000
+#endif
+
+
+/* Context of a parse error.  */
+typedef struct
+{
+  yy_state_t *yyssp;
+  yysymbol_kind_t yytoken;
+} yypcontext_t;
+
+/* Put in YYARG at most YYARGN of the expected tokens given the
+   current YYCTX, and return the number of tokens stored in YYARG.  If
+   YYARG is null, return the number of expected tokens (guaranteed to
+   be less than YYNTOKENS).  Return YYENOMEM on memory exhaustion.
+   Return 0 if there are more than YYARGN expected tokens, yet fill
+   YYARG up to YYARGN. */
+static int
+yypcontext_expected_tokens (const yypcontext_t *yyctx,
+                            yysymbol_kind_t yyarg[], int yyargn)
+{
+  /* Actual size of YYARG. */
+  int yycount = 0;
+  int yyn = yypact[+*yyctx->yyssp];
+  if (!yypact_value_is_default (yyn))
+    {
+      /* Start YYX at -YYN if negative to avoid negative indexes in
+         YYCHECK.  In other words, skip the first -YYN actions for
+         this state because they are default actions.  */
+      int yyxbegin = yyn < 0 ? -yyn : 0;
+      /* Stay within bounds of both yycheck and yytname.  */
+      int yychecklim = YYLAST - yyn + 1;
+      int yyxend = yychecklim < YYNTOKENS ? yychecklim : YYNTOKENS;
+      int yyx;
+      for (yyx = yyxbegin; yyx < yyxend; ++yyx)
+        if (yycheck[yyx + yyn] == yyx && yyx != YYSYMBOL_YYerror
+            && !yytable_value_is_error (yytable[yyx + yyn]))
+          {
+            if (!yyarg)
+              ++yycount;
+            else if (yycount == yyargn)
+              return 0;
+            else
+              yyarg[yycount++] = YY_CAST (yysymbol_kind_t, yyx);
+          }
+    }
+  if (yyarg && yycount == 0 && 0 < yyargn)
+    yyarg[0] = YYSYMBOL_YYEMPTY;
+  return yycount;
+}
+
+
+
+
+#ifndef yystrlen
+# if defined __GLIBC__ && defined _STRING_H
+#  define yystrlen(S) (YY_CAST (YYPTRDIFF_T, strlen (S)))
+# else
+/* Return the length of YYSTR.  */
+static YYPTRDIFF_T
+yystrlen (const char *yystr)
+{
+  YYPTRDIFF_T yylen;
+  for (yylen = 0; yystr[yylen]; yylen++)
+    continue;
+  return yylen;
+}
+# endif
+#endif
+
+#ifndef yystpcpy
+# if defined __GLIBC__ && defined _STRING_H && defined _GNU_SOURCE
+#  define yystpcpy stpcpy
+# else
+/* Copy YYSRC to YYDEST, returning the address of the terminating '\0' in
+   YYDEST.  */
+static char *
+yystpcpy (char *yydest, const char *yysrc)
+{
+  char *yyd = yydest;
+  const char *yys = yysrc;
+
+  while ((*yyd++ = *yys++) != '\0')
+    continue;
+
+  return yyd - 1;
+}
+# endif
+#endif
+
+#ifndef yytnamerr
+/* Copy to YYRES the contents of YYSTR after stripping away unnecessary
+   quotes and backslashes, so that it's suitable for yyerror.  The
+   heuristic is that double-quoting is unnecessary unless the string
+   contains an apostrophe, a comma, or backslash (other than
+   backslash-backslash).  YYSTR is taken from yytname.  If YYRES is
+   null, do not copy; instead, return the length of what the result
+   would have been.  */
+static YYPTRDIFF_T
+yytnamerr (char *yyres, const char *yystr)
+{
+  if (*yystr == '"')
+    {
+      YYPTRDIFF_T yyn = 0;
+      char const *yyp = yystr;
+      for (;;)
+        switch (*++yyp)
+          {
+          case '\'':
+          case ',':
+            goto do_not_strip_quotes;
+
+          case '\\':
+            if (*++yyp != '\\')
+              goto do_not_strip_quotes;
+            else
+              goto append;
+
+          append:
+          default:
+            if (yyres)
+              yyres[yyn] = *yyp;
+            yyn++;
+            break;
+
+          case '"':
+            if (yyres)
+              yyres[yyn] = '\0';
+            return yyn;
+          }
+    do_not_strip_quotes: ;
+    }
+
+  if (yyres)
+    return yystpcpy (yyres, yystr) - yyres;
+  else
+    return yystrlen (yystr);
+}
+#endif
+
+
+static int
+yy_syntax_error_arguments (const yypcontext_t *yyctx,
+                           yysymbol_kind_t yyarg[], int yyargn)
+{
+  /* Actual size of YYARG. */
+  int yycount = 0;
+  /* There are many possibilities here to consider:
+     - If this state is a consistent state with a default action, then
+       the only way this function was invoked is if the default action
+       is an error action.  In that case, don't check for expected
+       tokens because there are none.
+     - The only way there can be no lookahead present (in yychar) is if
+       this state is a consistent state with a default action.  Thus,
+       detecting the absence of a lookahead is sufficient to determine
+       that there is no unexpected or expected token to report.  In that
+       case, just report a simple "syntax error".
+     - Don't assume there isn't a lookahead just because this state is a
+       consistent state with a default action.  There might have been a
+       previous inconsistent state, consistent state with a non-default
+       action, or user semantic action that manipulated yychar.
+     - Of course, the expected token list depends on states to have
+       correct lookahead information, and it depends on the parser not
+       to perform extra reductions after fetching a lookahead from the
+       scanner and before detecting a syntax error.  Thus, state merging
+       (from LALR or IELR) and default reductions corrupt the expected
+       token list.  However, the list is correct for canonical LR with
+       one exception: it will still contain any token that will not be
+       accepted due to an error action in a later state.
+  */
+  if (yyctx->yytoken != YYSYMBOL_YYEMPTY)
+    {
+      int yyn;
+      if (yyarg)
+        yyarg[yycount] = yyctx->yytoken;
+      ++yycount;
+      yyn = yypcontext_expected_tokens (yyctx,
+                                        yyarg ? yyarg + 1 : yyarg, yyargn - 1);
+      if (yyn == YYENOMEM)
+        return YYENOMEM;
+      else
+        yycount += yyn;
+    }
+  return yycount;
+}
+
+/* Copy into *YYMSG, which is of size *YYMSG_ALLOC, an error message
+   about the unexpected token YYTOKEN for the state stack whose top is
+   YYSSP.
+
+   Return 0 if *YYMSG was successfully written.  Return -1 if *YYMSG is
+   not large enough to hold the message.  In that case, also set
+   *YYMSG_ALLOC to the required number of bytes.  Return YYENOMEM if the
+   required number of bytes is too large to store.  */
+static int
+yysyntax_error (YYPTRDIFF_T *yymsg_alloc, char **yymsg,
+                const yypcontext_t *yyctx)
+{
+  enum { YYARGS_MAX = 5 };
+  /* Internationalized format string. */
+  const char *yyformat = YY_NULLPTR;
+  /* Arguments of yyformat: reported tokens (one for the "unexpected",
+     one per "expected"). */
+  yysymbol_kind_t yyarg[YYARGS_MAX];
+  /* Cumulated lengths of YYARG.  */
+  YYPTRDIFF_T yysize = 0;
+
+  /* Actual size of YYARG. */
+  int yycount = yy_syntax_error_arguments (yyctx, yyarg, YYARGS_MAX);
+  if (yycount == YYENOMEM)
+    return YYENOMEM;
+
+  switch (yycount)
+    {
+#define YYCASE_(N, S)                       \
+      case N:                               \
+        yyformat = S;                       \
+        break
+    default: /* Avoid compiler warnings. */
+      YYCASE_(0, YY_("syntax error"));
+      YYCASE_(1, YY_("syntax error, unexpected %s"));
+      YYCASE_(2, YY_("syntax error, unexpected %s, expecting %s"));
+      YYCASE_(3, YY_("syntax error, unexpected %s, expecting %s or %s"));
+      YYCASE_(4, YY_("syntax error, unexpected %s, expecting %s or %s or %s"));
+      YYCASE_(5, YY_("syntax error, unexpected %s, expecting %s or %s or %s or %s"));
+#undef YYCASE_
+    }
+
+  /* Compute error message size.  Don't count the "%s"s, but reserve
+     room for the terminator.  */
+  yysize = yystrlen (yyformat) - 2 * yycount + 1;
+  {
+    int yyi;
+    for (yyi = 0; yyi < yycount; ++yyi)
+      {
+        YYPTRDIFF_T yysize1
+          = yysize + yytnamerr (YY_NULLPTR, yytname[yyarg[yyi]]);
+        if (yysize <= yysize1 && yysize1 <= YYSTACK_ALLOC_MAXIMUM)
+          yysize = yysize1;
+        else
+          return YYENOMEM;
+      }
+  }
+
+  if (*yymsg_alloc < yysize)
+    {
+      *yymsg_alloc = 2 * yysize;
+      if (! (yysize <= *yymsg_alloc
+             && *yymsg_alloc <= YYSTACK_ALLOC_MAXIMUM))
+        *yymsg_alloc = YYSTACK_ALLOC_MAXIMUM;
+      return -1;
+    }
+
+  /* Avoid sprintf, as that infringes on the user's name space.
+     Don't have undefined behavior even if the translation
+     produced a string with the wrong number of "%s"s.  */
+  {
+    char *yyp = *yymsg;
+    int yyi = 0;
+    while ((*yyp = *yyformat) != '\0')
+      if (*yyp == '%' && yyformat[1] == 's' && yyi < yycount)
+        {
+          yyp += yytnamerr (yyp, yytname[yyarg[yyi++]]);
+          yyformat += 2;
+        }
+      else
+        {
+          ++yyp;
+          ++yyformat;
+        }
+  }
+  return 0;
+}
+
+
+/*-----------------------------------------------.
+| Release the memory associated to this symbol.  |
+`-----------------------------------------------*/
+
+static void
+yydestruct (const char *yymsg,
+            yysymbol_kind_t yykind, YYSTYPE *yyvaluep, joqe_build *build)
+{
+  YY_USE (yyvaluep);
+  YY_USE (build);
+  if (!yymsg)
+    yymsg = "Deleting";
+  YY_SYMBOL_PRINT (yymsg, yykind, yyvaluep, yylocationp);
+
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+  YY_USE (yykind);
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
+}
+
+
+
+
+
+
+/*----------.
+| yyparse.  |
+`----------*/
+
+int
+yyparse (joqe_build *build)
+{
+/* Lookahead token kind.  */
+int yychar;
+
+
+/* The semantic value of the lookahead symbol.  */
+/* Default value used for initialization, for pacifying older GCCs
+   or non-GCC compilers.  */
+YY_INITIAL_VALUE (static YYSTYPE yyval_default;)
+YYSTYPE yylval YY_INITIAL_VALUE (= yyval_default);
+
+    /* Number of syntax errors so far.  */
+    int yynerrs = 0;
+
+    yy_state_fast_t yystate = 0;
+    /* Number of tokens to shift before error messages enabled.  */
+    int yyerrstatus = 0;
+
+    /* Refer to the stacks through separate pointers, to allow yyoverflow
+       to reallocate them elsewhere.  */
+
+    /* Their size.  */
+    YYPTRDIFF_T yystacksize = YYINITDEPTH;
+
+    /* The state stack: array, bottom, top.  */
+    yy_state_t yyssa[YYINITDEPTH];
+    yy_state_t *yyss = yyssa;
+    yy_state_t *yyssp = yyss;
+
+    /* The semantic value stack: array, bottom, top.  */
+    YYSTYPE yyvsa[YYINITDEPTH];
+    YYSTYPE *yyvs = yyvsa;
+    YYSTYPE *yyvsp = yyvs;
+
+  int yyn;
+  /* The return value of yyparse.  */
+  int yyresult;
+  /* Lookahead symbol kind.  */
+  yysymbol_kind_t yytoken = YYSYMBOL_YYEMPTY;
+  /* The variables used to return semantic value and location from the
+     action routines.  */
+  YYSTYPE yyval;
+
+  /* Buffer for error messages, and its allocated size.  */
+  char yymsgbuf[128];
+  char *yymsg = yymsgbuf;
+  YYPTRDIFF_T yymsg_alloc = sizeof yymsgbuf;
+
+#define YYPOPSTACK(N)   (yyvsp -= (N), yyssp -= (N))
+
+  /* The number of symbols on the RHS of the reduced rule.
+     Keep to zero when no symbol should be popped.  */
+  int yylen = 0;
+
+  YYDPRINTF ((stderr, "Starting parse\n"));
+
+  yychar = JOQE_YYEMPTY; /* Cause a token to be read.  */
+
+  goto yysetstate;
+
+
+/*------------------------------------------------------------.
+| yynewstate -- push a new state, which is found in yystate.  |
+`------------------------------------------------------------*/
+yynewstate:
+  /* In all cases, when you get here, the value and location stacks
+     have just been pushed.  So pushing a state here evens the stacks.  */
+  yyssp++;
+
+
+/*--------------------------------------------------------------------.
+| yysetstate -- set current state (the top of the stack) to yystate.  |
+`--------------------------------------------------------------------*/
+yysetstate:
+  YYDPRINTF ((stderr, "Entering state %d\n", yystate));
+  YY_ASSERT (0 <= yystate && yystate < YYNSTATES);
+  YY_IGNORE_USELESS_CAST_BEGIN
+  *yyssp = YY_CAST (yy_state_t, yystate);
+  YY_IGNORE_USELESS_CAST_END
+  YY_STACK_PRINT (yyss, yyssp);
+
+  if (yyss + yystacksize - 1 <= yyssp)
+#if !defined yyoverflow && !defined YYSTACK_RELOCATE
+    YYNOMEM;
+#else
+    {
+      /* Get the current used size of the three stacks, in elements.  */
+      YYPTRDIFF_T yysize = yyssp - yyss + 1;
+
+# if defined yyoverflow
+      {
+        /* Give user a chance to reallocate the stack.  Use copies of
+           these so that the &'s don't force the real ones into
+           memory.  */
+        yy_state_t *yyss1 = yyss;
+        YYSTYPE *yyvs1 = yyvs;
+
+        /* Each stack pointer address is followed by the size of the
+           data in use in that stack, in bytes.  This used to be a
+           conditional around just the two extra args, but that might
+           be undefined if yyoverflow is a macro.  */
+        yyoverflow (YY_("memory exhausted"),
+                    &yyss1, yysize * YYSIZEOF (*yyssp),
+                    &yyvs1, yysize * YYSIZEOF (*yyvsp),
+                    &yystacksize);
+        yyss = yyss1;
+        yyvs = yyvs1;
+      }
+# else /* defined YYSTACK_RELOCATE */
+      /* Extend the stack our own way.  */
+      if (YYMAXDEPTH <= yystacksize)
+        YYNOMEM;
+      yystacksize *= 2;
+      if (YYMAXDEPTH < yystacksize)
+        yystacksize = YYMAXDEPTH;
+
+      {
+        yy_state_t *yyss1 = yyss;
+        union yyalloc *yyptr =
+          YY_CAST (union yyalloc *,
+                   YYSTACK_ALLOC (YY_CAST (YYSIZE_T, YYSTACK_BYTES (yystacksize))));
+        if (! yyptr)
+          YYNOMEM;
+        YYSTACK_RELOCATE (yyss_alloc, yyss);
+        YYSTACK_RELOCATE (yyvs_alloc, yyvs);
+#  undef YYSTACK_RELOCATE
+        if (yyss1 != yyssa)
+          YYSTACK_FREE (yyss1);
+      }
+# endif
+
+      yyssp = yyss + yysize - 1;
+      yyvsp = yyvs + yysize - 1;
+
+      YY_IGNORE_USELESS_CAST_BEGIN
+      YYDPRINTF ((stderr, "Stack size increased to %ld\n",
+                  YY_CAST (long, yystacksize)));
+      YY_IGNORE_USELESS_CAST_END
+
+      if (yyss + yystacksize - 1 <= yyssp)
+        YYABORT;
+    }
+#endif /* !defined yyoverflow && !defined YYSTACK_RELOCATE */
+
+
+  if (yystate == YYFINAL)
+    YYACCEPT;
+
+  goto yybackup;
+
+
+/*-----------.
+| yybackup.  |
+`-----------*/
+yybackup:
+  /* Do appropriate processing given the current state.  Read a
+     lookahead token if we need one and don't already have one.  */
+
+  /* First try to decide what to do without reference to lookahead token.  */
+  yyn = yypact[yystate];
+  if (yypact_value_is_default (yyn))
+    goto yydefault;
+
+  /* Not known => get a lookahead token if don't already have one.  */
+
+  /* YYCHAR is either empty, or end-of-input, or a valid lookahead.  */
+  if (yychar == JOQE_YYEMPTY)
+    {
+      YYDPRINTF ((stderr, "Reading a token\n"));
+      yychar = yylex (&yylval, build);
+    }
+
+  if (yychar <= JOQE_YYEOF)
+    {
+      yychar = JOQE_YYEOF;
+      yytoken = YYSYMBOL_YYEOF;
+      YYDPRINTF ((stderr, "Now at end of input.\n"));
+    }
+  else if (yychar == JOQE_YYerror)
+    {
+      /* The scanner already issued an error message, process directly
+         to error recovery.  But do not keep the error token as
+         lookahead, it is too special and may lead us to an endless
+         loop in error recovery. */
+      yychar = JOQE_YYUNDEF;
+      yytoken = YYSYMBOL_YYerror;
+      goto yyerrlab1;
+    }
+  else
+    {
+      yytoken = YYTRANSLATE (yychar);
+      YY_SYMBOL_PRINT ("Next token is", yytoken, &yylval, &yylloc);
+    }
+
+  /* If the proper action on seeing token YYTOKEN is to reduce or to
+     detect an error, take that action.  */
+  yyn += yytoken;
+  if (yyn < 0 || YYLAST < yyn || yycheck[yyn] != yytoken)
+    goto yydefault;
+  yyn = yytable[yyn];
+  if (yyn <= 0)
+    {
+      if (yytable_value_is_error (yyn))
+        goto yyerrlab;
+      yyn = -yyn;
+      goto yyreduce;
+    }
+
+  /* Count tokens shifted since error; after three, turn off error
+     status.  */
+  if (yyerrstatus)
+    yyerrstatus--;
+
+  /* Shift the lookahead token.  */
+  YY_SYMBOL_PRINT ("Shifting", yytoken, &yylval, &yylloc);
+  yystate = yyn;
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+  *++yyvsp = yylval;
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
+
+  /* Discard the shifted token.  */
+  yychar = JOQE_YYEMPTY;
+  goto yynewstate;
+
+
+/*-----------------------------------------------------------.
+| yydefault -- do the default action for the current state.  |
+`-----------------------------------------------------------*/
+yydefault:
+  yyn = yydefact[yystate];
+  if (yyn == 0)
+    goto yyerrlab;
+  goto yyreduce;
+
+
+/*-----------------------------.
+| yyreduce -- do a reduction.  |
+`-----------------------------*/
+yyreduce:
+  /* yyn is the number of a rule to reduce with.  */
+  yylen = yyr2[yyn];
+
+  /* If YYLEN is nonzero, implement the default value of the action:
+     '$$ = $1'.
+
+     Otherwise, the following line sets YYVAL to garbage.
+     This behavior is undocumented and Bison
+     users should not rely upon it.  Assigning to YYVAL
+     unconditionally makes the parser a bit smaller, and it avoids a
+     GCC warning that YYVAL may be used uninitialized.  */
+  yyval = yyvsp[1-yylen];
+
+
+  YY_REDUCE_PRINT (yyn);
+  switch (yyn)
+    {
+  case 2: /* start: construct-expr  */
+#line 66 "joqe.y"
+{
+  build->root = (yyvsp[0].construct);
+}
+#line 1557 "src/joqe.tab.c"
+    break;
+
+  case 3: /* start: error INVALID_STRING  */
+#line 70 "joqe.y"
+{
+  joqe_yyerror(build, joqe_invalid_string((yyvsp[0].integer)));
+  return -1;
+}
+#line 1566 "src/joqe.tab.c"
+    break;
+
+  case 6: /* scalar: INTEGER  */
+#line 81 "joqe.y"
+                                                {(yyval.expr) = ast.integer_value((yyvsp[0].integer));}
+#line 1572 "src/joqe.tab.c"
+    break;
+
+  case 7: /* scalar: REAL  */
+#line 82 "joqe.y"
+                                                {(yyval.expr) = ast.real_value((yyvsp[0].real));}
+#line 1578 "src/joqe.tab.c"
+    break;
+
+  case 8: /* scalar: _TRUE  */
+#line 83 "joqe.y"
+                                                {(yyval.expr) = ast.true_value;}
+#line 1584 "src/joqe.tab.c"
+    break;
+
+  case 9: /* scalar: _FALSE  */
+#line 84 "joqe.y"
+                                                {(yyval.expr) = ast.false_value;}
+#line 1590 "src/joqe.tab.c"
+    break;
+
+  case 10: /* scalar: _NULL  */
+#line 85 "joqe.y"
+                                                {(yyval.expr) = ast.null_value;}
+#line 1596 "src/joqe.tab.c"
+    break;
+
+  case 11: /* string: STRING  */
+#line 88 "joqe.y"
+                                                {(yyval.expr) = ast.string_value((yyvsp[0].string));}
+#line 1602 "src/joqe.tab.c"
+    break;
+
+  case 12: /* string: string STRING  */
+#line 89 "joqe.y"
+                                                {(yyval.expr) = ast.string_append((yyvsp[-1].expr), (yyvsp[0].string));}
+#line 1608 "src/joqe.tab.c"
+    break;
+
+  case 13: /* string: part-string STRING  */
+#line 90 "joqe.y"
+                                                {(yyval.expr) = ast.string_append((yyvsp[-1].expr), (yyvsp[0].string));}
+#line 1614 "src/joqe.tab.c"
+    break;
+
+  case 14: /* part-string: PARTIALSTRING  */
+#line 92 "joqe.y"
+                                                {(yyval.expr) = ast.string_value((yyvsp[0].string));}
+#line 1620 "src/joqe.tab.c"
+    break;
+
+  case 15: /* part-string: part-string PARTIALSTRING  */
+#line 93 "joqe.y"
+                                                {(yyval.expr) = ast.string_append((yyvsp[-1].expr), (yyvsp[0].string));}
+#line 1626 "src/joqe.tab.c"
+    break;
+
+  case 17: /* or-expr: or-expr OR and-expr  */
+#line 97 "joqe.y"
+                                                {(yyval.expr) = ast.bor((yyvsp[-2].expr),(yyvsp[0].expr));}
+#line 1632 "src/joqe.tab.c"
+    break;
+
+  case 19: /* and-expr: and-expr AND test-expr  */
+#line 100 "joqe.y"
+                                                {(yyval.expr) = ast.band((yyvsp[-2].expr),(yyvsp[0].expr));}
+#line 1638 "src/joqe.tab.c"
+    break;
+
+  case 21: /* test-expr: term-expr compare-op term-expr  */
+#line 103 "joqe.y"
+                                                {(yyval.expr) = ast.bcompare((yyvsp[-1].integer),(yyvsp[-2].expr),(yyvsp[0].expr));}
+#line 1644 "src/joqe.tab.c"
+    break;
+
+  case 23: /* term-expr: term-expr '+' term  */
+#line 106 "joqe.y"
+                                                {(yyval.expr) = ast.calc(joqe_ast_calc_add,(yyvsp[-2].expr),(yyvsp[0].expr));}
+#line 1650 "src/joqe.tab.c"
+    break;
+
+  case 24: /* term-expr: term-expr '-' term  */
+#line 107 "joqe.y"
+                                                {(yyval.expr) = ast.calc(joqe_ast_calc_sub,(yyvsp[-2].expr),(yyvsp[0].expr));}
+#line 1656 "src/joqe.tab.c"
+    break;
+
+  case 26: /* term: term '*' factor  */
+#line 110 "joqe.y"
+                                                {(yyval.expr) = ast.calc(joqe_ast_calc_mult,(yyvsp[-2].expr),(yyvsp[0].expr));}
+#line 1662 "src/joqe.tab.c"
+    break;
+
+  case 27: /* term: term '/' factor  */
+#line 111 "joqe.y"
+                                                {(yyval.expr) = ast.calc(joqe_ast_calc_div,(yyvsp[-2].expr),(yyvsp[0].expr));}
+#line 1668 "src/joqe.tab.c"
+    break;
+
+  case 28: /* term: term '%' factor  */
+#line 112 "joqe.y"
+                                                {(yyval.expr) = ast.calc(joqe_ast_calc_mod,(yyvsp[-2].expr),(yyvsp[0].expr));}
+#line 1674 "src/joqe.tab.c"
+    break;
+
+  case 29: /* term: term MOD factor  */
+#line 113 "joqe.y"
+                                                {(yyval.expr) = ast.calc(joqe_ast_calc_mod,(yyvsp[-2].expr),(yyvsp[0].expr));}
+#line 1680 "src/joqe.tab.c"
+    break;
+
+  case 31: /* factor: '-' unary  */
+#line 116 "joqe.y"
+                                                {(yyval.expr) = ast.negative((yyvsp[0].expr));}
+#line 1686 "src/joqe.tab.c"
+    break;
+
+  case 32: /* factor: '+' unary  */
+#line 117 "joqe.y"
+                                                {(yyval.expr) = ast.positive((yyvsp[0].expr));}
+#line 1692 "src/joqe.tab.c"
+    break;
+
+  case 33: /* factor: NOT unary  */
+#line 118 "joqe.y"
+                                                {(yyval.expr) = ast.bnot((yyvsp[0].expr));}
+#line 1698 "src/joqe.tab.c"
+    break;
+
+  case 35: /* unary: node-set  */
+#line 121 "joqe.y"
+                                                {(yyval.expr) = ast.path_expression((yyvsp[0].path));}
+#line 1704 "src/joqe.tab.c"
+    break;
+
+  case 36: /* unary: '(' expr ')'  */
+#line 123 "joqe.y"
+                                                {(yyval.expr) = (yyvsp[-1].expr);}
+#line 1710 "src/joqe.tab.c"
+    break;
+
+  case 37: /* unary: '(' construct-expr C2 expr ')'  */
+#line 124 "joqe.y"
+                                                {(yyval.expr) = ast.expr_context((yyvsp[-1].expr),(yyvsp[-3].construct));}
+#line 1716 "src/joqe.tab.c"
+    break;
+
+  case 38: /* compare-op: '='  */
+#line 126 "joqe.y"
+                                                {(yyval.integer) = joqe_ast_comp_eq;}
+#line 1722 "src/joqe.tab.c"
+    break;
+
+  case 39: /* compare-op: NEQ  */
+#line 127 "joqe.y"
+                                                {(yyval.integer) = joqe_ast_comp_neq;}
+#line 1728 "src/joqe.tab.c"
+    break;
+
+  case 40: /* compare-op: '<'  */
+#line 128 "joqe.y"
+                                                {(yyval.integer) = joqe_ast_comp_lt;}
+#line 1734 "src/joqe.tab.c"
+    break;
+
+  case 41: /* compare-op: LEQ  */
+#line 129 "joqe.y"
+                                                {(yyval.integer) = joqe_ast_comp_lte;}
+#line 1740 "src/joqe.tab.c"
+    break;
+
+  case 42: /* compare-op: '>'  */
+#line 130 "joqe.y"
+                                                {(yyval.integer) = joqe_ast_comp_gt;}
+#line 1746 "src/joqe.tab.c"
+    break;
+
+  case 43: /* compare-op: GEQ  */
+#line 131 "joqe.y"
+                                                {(yyval.integer) = joqe_ast_comp_gte;}
+#line 1752 "src/joqe.tab.c"
+    break;
+
+  case 45: /* node-set: node-set '|' node-path  */
+#line 134 "joqe.y"
+                                                {(yyval.path) = ast.punion((yyvsp[-2].path),(yyvsp[0].path));}
+#line 1758 "src/joqe.tab.c"
+    break;
+
+  case 46: /* node-path: '.'  */
+#line 136 "joqe.y"
+                                                {(yyval.path) = ast.local_path();}
+#line 1764 "src/joqe.tab.c"
+    break;
+
+  case 47: /* node-path: '/'  */
+#line 137 "joqe.y"
+                                                {(yyval.path) = ast.context_path(0);}
+#line 1770 "src/joqe.tab.c"
+    break;
+
+  case 48: /* node-path: SLASH  */
+#line 138 "joqe.y"
+                                                {(yyval.path) = ast.context_path((yyvsp[0].integer));}
+#line 1776 "src/joqe.tab.c"
+    break;
+
+  case 49: /* node-path: name  */
+#line 139 "joqe.y"
+                                                {
+                                                  (yyval.path) = ast.path_chain(
+                                                    ast.local_path(),
+                                                    ast.pename((yyvsp[0].string)));
+                                                }
+#line 1786 "src/joqe.tab.c"
+    break;
+
+  case 50: /* node-path: '.' name  */
+#line 144 "joqe.y"
+                                                {
+                                                  (yyval.path) = ast.path_chain(
+                                                    ast.local_path(),
+                                                    ast.pename((yyvsp[0].string)));
+                                                }
+#line 1796 "src/joqe.tab.c"
+    break;
+
+  case 51: /* node-path: '/' name  */
+#line 149 "joqe.y"
+                                                {
+                                                  (yyval.path) = ast.path_chain(
+                                                    ast.context_path(0),
+                                                    ast.pename((yyvsp[0].string)));
+                                                }
+#line 1806 "src/joqe.tab.c"
+    break;
+
+  case 52: /* node-path: SLASH name  */
+#line 154 "joqe.y"
+                                                {
+                                                  (yyval.path) = ast.path_chain(
+                                                    ast.context_path((yyvsp[-1].integer)),
+                                                    ast.pename((yyvsp[0].string)));
+                                                }
+#line 1816 "src/joqe.tab.c"
+    break;
+
+  case 53: /* node-path: DOT2 name  */
+#line 159 "joqe.y"
+                                                {
+                                                  (yyval.path) = ast.path_chain(
+                                                    ast.path_chain(
+                                                      ast.local_path(),
+                                                      ast.peflex()),
+                                                    ast.pename((yyvsp[0].string)));
+                                                }
+#line 1828 "src/joqe.tab.c"
+    break;
+
+  case 54: /* node-path: DOT2 '[' filter ']'  */
+#line 166 "joqe.y"
+                                                {
+                                                  (yyval.path) = ast.path_chain(
+                                                    ast.path_chain(
+                                                      ast.local_path(),
+                                                      ast.peflex()),
+                                                    (yyvsp[-1].pe));
+                                                }
+#line 1840 "src/joqe.tab.c"
+    break;
+
+  case 55: /* node-path: node-path '.' name  */
+#line 173 "joqe.y"
+                                                { (yyval.path) = ast.path_chain((yyvsp[-2].path),
+                                                    ast.pename((yyvsp[0].string)));}
+#line 1847 "src/joqe.tab.c"
+    break;
+
+  case 56: /* node-path: node-path '[' filter ']'  */
+#line 175 "joqe.y"
+                                                { (yyval.path) = ast.path_chain((yyvsp[-3].path),(yyvsp[-1].pe)); }
+#line 1853 "src/joqe.tab.c"
+    break;
+
+  case 57: /* node-path: node-path DOT2 name  */
+#line 176 "joqe.y"
+                                                { (yyval.path) = ast.path_chain(
+                                                    ast.path_chain(
+                                                      (yyvsp[-2].path), ast.peflex()
+                                                    ),
+                                                    ast.pename((yyvsp[0].string)));
+                                                }
+#line 1864 "src/joqe.tab.c"
+    break;
+
+  case 58: /* node-path: node-path DOT2 '[' filter ']'  */
+#line 182 "joqe.y"
+                                                { (yyval.path) = ast.path_chain(
+                                                    ast.path_chain(
+                                                      (yyvsp[-4].path), ast.peflex()
+                                                    ), (yyvsp[-1].pe));
+                                                }
+#line 1874 "src/joqe.tab.c"
+    break;
+
+  case 59: /* node-path: function  */
+#line 187 "joqe.y"
+                                                {
+                                                  (yyval.path) = ast.path_chain(
+                                                    ast.local_path(), (yyvsp[0].pe));
+                                                }
+#line 1883 "src/joqe.tab.c"
+    break;
+
+  case 60: /* node-path: node-path '.' function  */
+#line 191 "joqe.y"
+                                                { (yyval.path) = ast.path_chain((yyvsp[-2].path),(yyvsp[0].pe)); }
+#line 1889 "src/joqe.tab.c"
+    break;
+
+  case 61: /* node-path: node-path DOT2 function  */
+#line 192 "joqe.y"
+                                                {
+                                                  (yyval.path) = ast.path_chain(
+                                                    ast.path_chain((yyvsp[-2].path),
+                                                      ast.peflex()),
+                                                    (yyvsp[0].pe));
+                                                }
+#line 1900 "src/joqe.tab.c"
+    break;
+
+  case 63: /* filter: %empty  */
+#line 201 "joqe.y"
+                                                {(yyval.pe) = ast.pefilter(ast.true_value);}
+#line 1906 "src/joqe.tab.c"
+    break;
+
+  case 64: /* filter: expr  */
+#line 202 "joqe.y"
+                                                {(yyval.pe) = ast.pefilter((yyvsp[0].expr));}
+#line 1912 "src/joqe.tab.c"
+    break;
+
+  case 65: /* function: name '(' params ')'  */
+#line 204 "joqe.y"
+                                                {
+                                                  const char *msg;
+                                                  (yyval.pe) = ast.pefunction((yyvsp[-3].string),(yyvsp[-1].params));
+                                                  if(joqe_ast_function_check(&(yyval.pe), &msg)) {
+                                                    joqe_yyerror(build, msg);
+                                                    return -1;
+                                                  }
+                                                }
+#line 1925 "src/joqe.tab.c"
+    break;
+
+  case 66: /* function: name '(' ')'  */
+#line 212 "joqe.y"
+                                                {(yyval.pe) = ast.pefunction((yyvsp[-2].string),
+                                                  ast.params());}
+#line 1932 "src/joqe.tab.c"
+    break;
+
+  case 67: /* params: expr  */
+#line 215 "joqe.y"
+                                                {
+                                                  (yyval.params) = ast.params_append(
+                                                    ast.params(), (yyvsp[0].expr));
+                                                }
+#line 1941 "src/joqe.tab.c"
+    break;
+
+  case 68: /* params: params ',' expr  */
+#line 219 "joqe.y"
+                                                {
+                                                  (yyval.params) = ast.params_append((yyvsp[-2].params),(yyvsp[0].expr));
+                                                }
+#line 1949 "src/joqe.tab.c"
+    break;
+
+  case 71: /* simple-construct: expr  */
+#line 229 "joqe.y"
+                                                {(yyval.construct) = ast.expr_construct((yyvsp[0].expr));}
+#line 1955 "src/joqe.tab.c"
+    break;
+
+  case 73: /* construct-expr: construct-expr C2 simple-construct  */
+#line 233 "joqe.y"
+                                                {(yyval.construct) = ast.construct_context((yyvsp[0].construct),(yyvsp[-2].construct));}
+#line 1961 "src/joqe.tab.c"
+    break;
+
+  case 74: /* object-construct: '{' object-entries '}'  */
+#line 236 "joqe.y"
+                                                {(yyval.construct) = ast.object_construct((yyvsp[-1].object));}
+#line 1967 "src/joqe.tab.c"
+    break;
+
+  case 75: /* object-construct: '{' object-entries ',' '}'  */
+#line 237 "joqe.y"
+                                                {(yyval.construct) = ast.object_construct((yyvsp[-2].object));}
+#line 1973 "src/joqe.tab.c"
+    break;
+
+  case 76: /* object-construct: '{' '}'  */
+#line 238 "joqe.y"
+                                                {
+                                                  (yyval.construct) = ast.object_construct(
+                                                    ast.object());
+                                                }
+#line 1982 "src/joqe.tab.c"
+    break;
+
+  case 77: /* object-entries: object-entry  */
+#line 243 "joqe.y"
+                                                {
+                                                  (yyval.object) = ast.object_append(
+                                                    ast.object(),(yyvsp[0].construct)
+                                                  );
+                                                }
+#line 1992 "src/joqe.tab.c"
+    break;
+
+  case 78: /* object-entries: object-entries ',' object-entry  */
+#line 249 "joqe.y"
+                                                {
+                                                  (yyval.object) = ast.object_append((yyvsp[-2].object),(yyvsp[0].construct));
+                                                }
+#line 2000 "src/joqe.tab.c"
+    break;
+
+  case 79: /* object-entry: simple-construct ':' construct-expr  */
+#line 254 "joqe.y"
+                                                {(yyval.construct) = ast.object_entry((yyvsp[-2].construct),(yyvsp[0].construct));}
+#line 2006 "src/joqe.tab.c"
+    break;
+
+  case 80: /* object-entry: simple-construct  */
+#line 255 "joqe.y"
+                                                {(yyval.construct) = ast.object_copy_entry((yyvsp[0].construct));}
+#line 2012 "src/joqe.tab.c"
+    break;
+
+  case 81: /* object-entry: simple-construct C2 object-entry  */
+#line 257 "joqe.y"
+                                                {(yyval.construct) = ast.construct_context((yyvsp[0].construct),(yyvsp[-2].construct));}
+#line 2018 "src/joqe.tab.c"
+    break;
+
+  case 82: /* array-construct: '[' array-entries ']'  */
+#line 259 "joqe.y"
+                                                {(yyval.construct) = ast.array_construct((yyvsp[-1].array));}
+#line 2024 "src/joqe.tab.c"
+    break;
+
+  case 83: /* array-construct: '[' array-entries ',' ']'  */
+#line 260 "joqe.y"
+                                                {(yyval.construct) = ast.array_construct((yyvsp[-2].array));}
+#line 2030 "src/joqe.tab.c"
+    break;
+
+  case 84: /* array-construct: '[' ']'  */
+#line 261 "joqe.y"
+                                                {
+                                                  (yyval.construct) = ast.array_construct(
+                                                    ast.array()
+                                                  );
+                                                }
+#line 2040 "src/joqe.tab.c"
+    break;
+
+  case 85: /* array-entries: array-entry  */
+#line 267 "joqe.y"
+                                                {
+                                                  (yyval.array) = ast.array_append(
+                                                    ast.array(), (yyvsp[0].construct)
+                                                  );
+                                                }
+#line 2050 "src/joqe.tab.c"
+    break;
+
+  case 86: /* array-entries: array-entries ',' array-entry  */
+#line 272 "joqe.y"
+                                                {
+                                                  (yyval.array) = ast.array_append((yyvsp[-2].array),(yyvsp[0].construct));
+                                                }
+#line 2058 "src/joqe.tab.c"
+    break;
+
+  case 87: /* array-entry: construct-expr  */
+#line 276 "joqe.y"
+                                                {(yyval.construct) = ast.array_entry((yyvsp[0].construct));}
+#line 2064 "src/joqe.tab.c"
+    break;
+
+
+#line 2068 "src/joqe.tab.c"
+
+      default: break;
+    }
+  /* User semantic actions sometimes alter yychar, and that requires
+     that yytoken be updated with the new translation.  We take the
+     approach of translating immediately before every use of yytoken.
+     One alternative is translating here after every semantic action,
+     but that translation would be missed if the semantic action invokes
+     YYABORT, YYACCEPT, or YYERROR immediately after altering yychar or
+     if it invokes YYBACKUP.  In the case of YYABORT or YYACCEPT, an
+     incorrect destructor might then be invoked immediately.  In the
+     case of YYERROR or YYBACKUP, subsequent parser actions might lead
+     to an incorrect destructor call or verbose syntax error message
+     before the lookahead is translated.  */
+  YY_SYMBOL_PRINT ("-> $$ =", YY_CAST (yysymbol_kind_t, yyr1[yyn]), &yyval, &yyloc);
+
+  YYPOPSTACK (yylen);
+  yylen = 0;
+
+  *++yyvsp = yyval;
+
+  /* Now 'shift' the result of the reduction.  Determine what state
+     that goes to, based on the state we popped back to and the rule
+     number reduced by.  */
+  {
+    const int yylhs = yyr1[yyn] - YYNTOKENS;
+    const int yyi = yypgoto[yylhs] + *yyssp;
+    yystate = (0 <= yyi && yyi <= YYLAST && yycheck[yyi] == *yyssp
+               ? yytable[yyi]
+               : yydefgoto[yylhs]);
+  }
+
+  goto yynewstate;
+
+
+/*--------------------------------------.
+| yyerrlab -- here on detecting error.  |
+`--------------------------------------*/
+yyerrlab:
+  /* Make sure we have latest lookahead translation.  See comments at
+     user semantic actions for why this is necessary.  */
+  yytoken = yychar == JOQE_YYEMPTY ? YYSYMBOL_YYEMPTY : YYTRANSLATE (yychar);
+  /* If not already recovering from an error, report this error.  */
+  if (!yyerrstatus)
+    {
+      ++yynerrs;
+      {
+        yypcontext_t yyctx
+          = {yyssp, yytoken};
+        char const *yymsgp = YY_("syntax error");
+        int yysyntax_error_status;
+        yysyntax_error_status = yysyntax_error (&yymsg_alloc, &yymsg, &yyctx);
+        if (yysyntax_error_status == 0)
+          yymsgp = yymsg;
+        else if (yysyntax_error_status == -1)
+          {
+            if (yymsg != yymsgbuf)
+              YYSTACK_FREE (yymsg);
+            yymsg = YY_CAST (char *,
+                             YYSTACK_ALLOC (YY_CAST (YYSIZE_T, yymsg_alloc)));
+            if (yymsg)
+              {
+                yysyntax_error_status
+                  = yysyntax_error (&yymsg_alloc, &yymsg, &yyctx);
+                yymsgp = yymsg;
+              }
+            else
+              {
+                yymsg = yymsgbuf;
+                yymsg_alloc = sizeof yymsgbuf;
+                yysyntax_error_status = YYENOMEM;
+              }
+          }
+        yyerror (build, yymsgp);
+        if (yysyntax_error_status == YYENOMEM)
+          YYNOMEM;
+      }
+    }
+
+  if (yyerrstatus == 3)
+    {
+      /* If just tried and failed to reuse lookahead token after an
+         error, discard it.  */
+
+      if (yychar <= JOQE_YYEOF)
+        {
+          /* Return failure if at end of input.  */
+          if (yychar == JOQE_YYEOF)
+            YYABORT;
+        }
+      else
+        {
+          yydestruct ("Error: discarding",
+                      yytoken, &yylval, build);
+          yychar = JOQE_YYEMPTY;
+        }
+    }
+
+  /* Else will try to reuse lookahead token after shifting the error
+     token.  */
+  goto yyerrlab1;
+
+
+/*---------------------------------------------------.
+| yyerrorlab -- error raised explicitly by YYERROR.  |
+`---------------------------------------------------*/
+yyerrorlab:
+  /* Pacify compilers when the user code never invokes YYERROR and the
+     label yyerrorlab therefore never appears in user code.  */
+  if (0)
+    YYERROR;
+  ++yynerrs;
+
+  /* Do not reclaim the symbols of the rule whose action triggered
+     this YYERROR.  */
+  YYPOPSTACK (yylen);
+  yylen = 0;
+  YY_STACK_PRINT (yyss, yyssp);
+  yystate = *yyssp;
+  goto yyerrlab1;
+
+
+/*-------------------------------------------------------------.
+| yyerrlab1 -- common code for both syntax error and YYERROR.  |
+`-------------------------------------------------------------*/
+yyerrlab1:
+  yyerrstatus = 3;      /* Each real token shifted decrements this.  */
+
+  /* Pop stack until we find a state that shifts the error token.  */
+  for (;;)
+    {
+      yyn = yypact[yystate];
+      if (!yypact_value_is_default (yyn))
+        {
+          yyn += YYSYMBOL_YYerror;
+          if (0 <= yyn && yyn <= YYLAST && yycheck[yyn] == YYSYMBOL_YYerror)
+            {
+              yyn = yytable[yyn];
+              if (0 < yyn)
+                break;
+            }
+        }
+
+      /* Pop the current state because it cannot handle the error token.  */
+      if (yyssp == yyss)
+        YYABORT;
+
+
+      yydestruct ("Error: popping",
+                  YY_ACCESSING_SYMBOL (yystate), yyvsp, build);
+      YYPOPSTACK (1);
+      yystate = *yyssp;
+      YY_STACK_PRINT (yyss, yyssp);
+    }
+
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+  *++yyvsp = yylval;
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
+
+
+  /* Shift the error token.  */
+  YY_SYMBOL_PRINT ("Shifting", YY_ACCESSING_SYMBOL (yyn), yyvsp, yylsp);
+
+  yystate = yyn;
+  goto yynewstate;
+
+
+/*-------------------------------------.
+| yyacceptlab -- YYACCEPT comes here.  |
+`-------------------------------------*/
+yyacceptlab:
+  yyresult = 0;
+  goto yyreturnlab;
+
+
+/*-----------------------------------.
+| yyabortlab -- YYABORT comes here.  |
+`-----------------------------------*/
+yyabortlab:
+  yyresult = 1;
+  goto yyreturnlab;
+
+
+/*-----------------------------------------------------------.
+| yyexhaustedlab -- YYNOMEM (memory exhaustion) comes here.  |
+`-----------------------------------------------------------*/
+yyexhaustedlab:
+  yyerror (build, YY_("memory exhausted"));
+  yyresult = 2;
+  goto yyreturnlab;
+
+
+/*----------------------------------------------------------.
+| yyreturnlab -- parsing is finished, clean up and return.  |
+`----------------------------------------------------------*/
+yyreturnlab:
+  if (yychar != JOQE_YYEMPTY)
+    {
+      /* Make sure we have latest lookahead translation.  See comments at
+         user semantic actions for why this is necessary.  */
+      yytoken = YYTRANSLATE (yychar);
+      yydestruct ("Cleanup: discarding lookahead",
+                  yytoken, &yylval, build);
+    }
+  /* Do not reclaim the symbols of the rule whose action triggered
+     this YYABORT or YYACCEPT.  */
+  YYPOPSTACK (yylen);
+  YY_STACK_PRINT (yyss, yyssp);
+  while (yyssp != yyss)
+    {
+      yydestruct ("Cleanup: popping",
+                  YY_ACCESSING_SYMBOL (+*yyssp), yyvsp, build);
+      YYPOPSTACK (1);
+    }
+#ifndef yyoverflow
+  if (yyss != yyssa)
+    YYSTACK_FREE (yyss);
+#endif
+  if (yymsg != yymsgbuf)
+    YYSTACK_FREE (yymsg);
+  return yyresult;
+}
+
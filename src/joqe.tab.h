@@ -0,0 +1,123 @@
+/* A Bison parser, made by GNU Bison 3.8.2.  */
+
+/* Bison interface for Yacc-like parsers in C
+
+   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2021 Free Software Foundation,
+   Inc.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
+
+/* As a special exception, you may create a larger work that contains
+   part or all of the Bison parser skeleton and distribute that work
+   under terms of your choice, so long as that work isn't itself a
+   parser generator using the skeleton or a modified version thereof
+   as a parser skeleton.  Alternatively, if you modify or redistribute
+   the parser skeleton itself, you may (at your option) remove this
+   special exception, which will cause the skeleton and the resulting
+   Bison output files to be licensed under the GNU General Public
+   License without this special exception.
+
+   This special exception was added by the Free Software Foundation in
+   version 2.2 of Bison.  */
+
+/* DO NOT RELY ON FEATURES THAT ARE NOT DOCUMENTED in the manual,
+   especially those whose name start with YY_ or yy_.  They are
+   private implementation details that can be changed or removed.  */
+
+#ifndef YY_JOQE_YY_SRC_JOQE_TAB_H_INCLUDED
+# define YY_JOQE_YY_SRC_JOQE_TAB_H_INCLUDED
+/* Debug traces.  */
+#ifndef JOQE_YYDEBUG
+# if defined YYDEBUG
+#if YYDEBUG
+#   define JOQE_YYDEBUG 1
+#  else
+#   define JOQE_YYDEBUG 0
+#  endif
+# else /* ! defined YYDEBUG */
+#  define JOQE_YYDEBUG 0
+# endif /* ! defined YYDEBUG */
+#endif  /* ! defined JOQE_YYDEBUG */
+#if JOQE_YYDEBUG
+extern int joqe_yydebug;
+#endif
+
+/* Token kinds.  */
+#ifndef JOQE_YYTOKENTYPE
+# define JOQE_YYTOKENTYPE
+  enum joqe_yytokentype
+  {
+    JOQE_YYEMPTY = -2,
+    JOQE_YYEOF = 0,                /* "end of file"  */
+    JOQE_YYerror = 256,            /* error  */
+    JOQE_YYUNDEF = 257,            /* "invalid token"  */
+    IDENTIFIER = 258,              /* IDENTIFIER  */
+    STRING = 259,                  /* STRING  */
+    PARTIALSTRING = 260,           /* PARTIALSTRING  */
+    INTEGER = 261,                 /* INTEGER  */
+    REAL = 262,                    /* REAL  */
+    _TRUE = 263,                   /* _TRUE  */
+    _FALSE = 264,                  /* _FALSE  */
+    _NULL = 265,                   /* _NULL  */
+    MOD = 266,                     /* MOD  */
+    NEQ = 267,                     /* NEQ  */
+    LEQ = 268,                     /* LEQ  */
+    GEQ = 269,                     /* GEQ  */
+    AND = 270,                     /* AND  */
+    OR = 271,                      /* OR  */
+    NOT = 272,                     /* NOT  */
+    DOT2 = 273,                    /* DOT2  */
+    SLASH = 274,                   /* SLASH  */
+    C2 = 275,                      /* C2  */
+    INVALID_STRING = 276,          /* INVALID_STRING  */
+    SHORTSTRING = 277              /* SHORTSTRING  */
+  };
+  typedef enum joqe_yytokentype joqe_yytoken_kind_t;
+#endif
+
+/* Value type.  */
+#if ! defined JOQE_YYSTYPE && ! defined JOQE_YYSTYPE_IS_DECLARED
+union JOQE_YYSTYPE
+{
+#line 39 "joqe.y"
+
+  int64_t         integer;
+  const char     *string;
+  char            inl[8];   // of a SHORTSTRING, zero padded
+  double          real;
+  joqe_ast_expr   expr;
+  joqe_ast_path   path;
+  joqe_ast_params params;
+
+  joqe_ast_pathelem   pe;
+
+  joqe_ast_construct  construct;
+  joqe_ast_object     object;
+  joqe_ast_array      array;
+
+#line 110 "src/joqe.tab.h"
+
+};
+typedef union JOQE_YYSTYPE JOQE_YYSTYPE;
+# define JOQE_YYSTYPE_IS_TRIVIAL 1
+# define JOQE_YYSTYPE_IS_DECLARED 1
+#endif
+
+
+
+
+int joqe_yyparse (joqe_build *build);
+
+
+#endif /* !YY_JOQE_YY_SRC_JOQE_TAB_H_INCLUDED  */
@@ -5,113 +5,628 @@
 #include "joqe.tab.h"
 #include "lex.h"
 #include "err.h"
+#include "keyindex.h"
+#include "arena.h"
+#include "cons.h"
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+
+#define RECORD_MIN 2
+// the arena of a row taken from the arena's nodes, rather than adopted.
+#define PACKED_BLOCK 2
+// arrays shorter than this aren't worth giving columns.
+#define COLUMNS_MIN 8
+#define COLUMNS_MAX 32
+// objects with fewer keys are as quickly looked through as their shape.
+#define SHAPED_MIN 8
+// containers the parser has room for before its stack goes on the heap.
+#define JSON_INLINE 16
 
 int joqe_yyerror(joqe_build *b, const char *msg);
 
-static
-int json_element (int           token,
-                  JOQE_YYSTYPE *yylval,
-                  joqe_build   *b,
-                  joqe_node    *n);
+static void packed_free (void *v);
+static joqe_nodels* json_release (joqe_node *n);
 
-static int
-json_object(JOQE_YYSTYPE *yylval, joqe_build *b, joqe_node *n)
+// a member of an object being parsed, kept until the object is complete
+// and it's known whether it's a record.
+typedef struct {
+  joqe_node n;
+  uint32_t  last; // of its subtree, for the key index
+} json_member;
+
+/* Lists with something to keep beside their members, the columns of an
+   array of records or the shape of an object of many keys, are led by
+   a sentinel keeping it, which also caches the hash of the subtree (see
+   nodehash.h). Most lists are only their members. */
+static joqe_nodels*
+json_head(joqe_node *n)
 {
-  n->type |= joqe_type_none_object;
-  int token;
-  do {
-    token = joqe_yylex(yylval, b);
-    if(STRING != token) {
-      //expected string or '}', not a string so check '}'
-      //this allows {"a":"b",}
-      break;
+  joqe_nodels *head = joqe_arena_nodels();
+  head->n.type = joqe_type_ref_cnt;
+  joqe_list_append((joqe_list**)&n->u.ls, &head->ll);
+  return n->u.ls = head;
+}
+
+static uint32_t
+key_hash(const char *s)
+{
+  uint32_t h = 0x811c9dc5u;
+  for(; *s; ++s)
+    h = (h ^ (unsigned char)*s) * 0x01000193u;
+  return h;
+}
+
+int
+joqe_shape_slot(const joqe_shape *shape, const char *key)
+{
+  int slot;
+  for(uint32_t h = key_hash(key); (slot = shape->map[h & shape->mask]); ++h)
+    if(!strcmp(shape->key[slot-1], key))
+      return slot-1;
+  return -1;
+}
+
+static uint32_t shape_ids;
+
+static joqe_shape*
+shape_create(json_member *ms, int count)
+{
+  int size = 4;
+  while(size < 2*count)
+    size *= 2;
+  joqe_shape *shape = malloc(sizeof(*shape) + count * sizeof(shape->key[0])
+                             + size * sizeof(shape->map[0]));
+  // ids start at 1, an empty cache has seen none.
+  shape->id = __atomic_add_fetch(&shape_ids, 1, __ATOMIC_RELAXED);
+  shape->count = count;
+  shape->unique = 1;
+  shape->mask = size - 1;
+  shape->map = memset(&shape->key[count], 0, size * sizeof(shape->map[0]));
+
+  for(int k = 0; k < count; ++k) {
+    const char *key = shape->key[k] = ms[k].n.k.key;
+    if(joqe_shape_slot(shape, key) >= 0) {
+      // only the first is found through the shape.
+      shape->unique = 0;
+      continue;
     }
-    const char *key = yylval->string;
+    uint32_t h = key_hash(key);
+    while(shape->map[h & shape->mask])
+      ++h;
+    shape->map[h & shape->mask] = k+1;
+  }
+  return shape;
+}
 
-    if(':' != joqe_yylex(yylval, b)) {
-      joqe_yyerror(b, "expected ':'");
-      return -1;
+static int
+shape_matches(const joqe_shape *shape, json_member *ms, int count)
+{
+  if(shape->count != count)
+    return 0;
+  for(int k = 0; k < count; ++k) {
+    const char *key = ms[k].n.k.key;
+    if(shape->key[k] != key && strcmp(shape->key[k], key))
+      return 0;
+  }
+  return 1;
+}
+
+// the shape of an object's keys, hashed by their (interned) pointers.
+static joqe_shape*
+json_shape(joqe_build *b, json_member *ms, int count, uint64_t hash)
+{
+  joqe_shape *shape = hopscotch_fetch(&b->shapes, (int)(hash ^ hash >> 32));
+  if(!shape || !shape_matches(shape, ms, count)) {
+    joqe_shape *fresh = shape_create(ms, count);
+    // colliding shapes aren't shared.
+    if(!shape)
+      hopscotch_insert(&b->shapes, (int)(hash ^ hash >> 32), fresh);
+    fresh->nxt = b->shapels;
+    b->shapels = shape = fresh;
+  }
+  return shape;
+}
+
+int
+joqe_shape_member(joqe_node *n, const char *key, joqe_shape_cache *cache,
+                  joqe_node **m, joqe_node *tmp)
+{
+  const joqe_shape *shape;
+  if(JOQE_TYPE_PACKED(n->type))
+    shape = n->u.p->shape;
+  else if(!JOQE_TYPE_VIEW(n->type) || !n->u.ls
+          || n->u.ls->n.type != joqe_type_ref_cnt
+          || !(shape = n->u.ls->n.k.shape) || !shape->unique)
+    return -1;
+
+  if(cache->id != shape->id) {
+    cache->id = shape->id;
+    cache->slot = joqe_shape_slot(shape, key);
+  }
+  if(cache->slot < 0)
+    return 0;
+
+  if(JOQE_TYPE_PACKED(n->type)) {
+    *m = joqe_packed_at(n->u.p, cache->slot, tmp);
+    return 1;
+  }
+  joqe_nodels *i = n->u.ls;
+  for(int k = 0; k <= cache->slot; ++k)
+    i = (joqe_nodels*)i->ll.n;
+  *m = &i->n;
+  return 1;
+}
+
+// the size of a row of count members, typed or not, keeping some whole.
+static size_t
+packed_size(int count, int typed, int nodes)
+{
+  size_t size = sizeof(joqe_packed) + count * sizeof(int64_t);
+  if(nodes)
+    return size + (count * 6 + 7) / 8 * sizeof(int64_t)
+                + nodes * sizeof(joqe_node);
+  return typed ? size + count * sizeof(uint16_t) : size;
+}
+
+// a row is taken rather than a list if it's smaller.
+static int
+packed_pays(size_t size, int count)
+{
+  return size < count * sizeof(joqe_nodels);
+}
+
+static void
+packed_free(void *v)
+{
+  joqe_packed *p = v;
+  free(p->ls);
+  free(p);
+}
+
+// p of size, complete, made part of the document.
+static joqe_packed*
+packed_keep(joqe_packed *p, size_t size)
+{
+  joqe_packed *block;
+  if((block = joqe_arena_block(size))) {
+    memcpy(block, p, size);
+    free(p);
+    block->arena = PACKED_BLOCK;
+    return block;
+  }
+  // a document parsed into an arena isn't freed node by node.
+  p->arena = joqe_arena_adopt(p, packed_free);
+  return p;
+}
+
+// n, just parsed with the members ms, becomes a packed record if it is
+// one.
+static int
+record(joqe_build *b, joqe_node *n, const joqe_shape *shape,
+       json_member *ms)
+{
+  int count = shape->count, nodes = 0;
+  // the index refers to members by their node.
+  if(b->index || !shape->unique || count < RECORD_MIN)
+    return 0;
+  for(int k = 0; k < count; ++k)
+    nodes += joqe_packed_whole(ms[k].n.type);
+  // a member kept whole takes about as much as it would in a list.
+  size_t size = packed_size(count, 1, nodes);
+  if(nodes && !packed_pays(size, count))
+    return 0;
+
+  joqe_packed *p = malloc(size);
+  p->ls = 0;
+  p->hash = 0;
+  p->shape = shape;
+  p->ord = ms[0].n.ord;
+  p->count = count;
+  p->type = 0;
+  p->nodes = nodes;
+  uint16_t *types = JOQE_PACKED_TYPES(p);
+  for(int k = 0, w = 0; k < count; ++k) {
+    joqe_node *m = &ms[k].n;
+    types[k] = m->type & ~JOQE_TYPE_KEY_MASK;
+    if(!nodes) {
+      memcpy(&p->v[k], &m->u, sizeof(p->v[0]));
+      continue;
     }
+    JOQE_PACKED_ORDS(p)[k] = m->ord;
+    if(joqe_packed_whole(m->type)) {
+      JOQE_PACKED_NODES(p)[w] = *m;
+      p->v[k].i = w++;
+    } else {
+      memcpy(&p->v[k], &m->u, sizeof(p->v[0]));
+    }
+  }
+  n->type |= JOQE_TYPE_PACKED_MASK;
+  n->u.p = packed_keep(p, size);
+  return 1;
+}
 
-    joqe_nodels l = {{}, {joqe_type_string_none, .k = {.key = key}}},
-               *ls;
+// the members ms of object n, not a record, as its list.
+static void
+json_list(joqe_build *b, joqe_node *n, json_member *ms, int count)
+{
+  for(int k = 0; k < count; ++k) {
+    joqe_nodels *ls = joqe_arena_nodels();
+    ls->n = ms[k].n;
+    joqe_list_append((joqe_list**)&n->u.ls, &ls->ll);
+    if(b->index)
+      joqe_index_insert(b->index, &ls->n, n->ord, ls->n.k.key, ms[k].last);
+  }
+}
 
-    token = joqe_yylex(yylval, b);
-    if((token = json_element(token, yylval, b, &l.n)))
-      return token;
+// the scalars of an array while it may still be packed, grown in place.
+typedef struct {
+  joqe_packed *p;
+  uint16_t    *types; // once the row is typed
+  int          size;
+  int          off;   // the array has turned out a list
+} packbuf;
 
-    *(ls = calloc(1, sizeof(*ls))) = l;
+static int
+pack_take(packbuf *pk, joqe_node *n)
+{
+  joqe_type t = n->type & ~JOQE_TYPE_KEY_MASK;
+  joqe_packed *p = pk->p;
+  if(pk->off || joqe_packed_whole(t))
+    return 0;
+  if(!p) {
+    pk->size = 8;
+    p = pk->p = malloc(sizeof(*p) + sizeof(p->v[0]) * pk->size);
+    p->ls = 0;
+    p->hash = 0;
+    p->shape = 0;
+    p->ord = n->ord;
+    p->count = 0;
+    p->type = t;
+    p->arena = 0;
+    p->nodes = 0;
+  } else if(p->count == pk->size) {
+    pk->size *= 2;
+    p = pk->p = realloc(p, sizeof(*p) + sizeof(p->v[0]) * pk->size);
+    if(pk->types)
+      pk->types = realloc(pk->types, sizeof(*pk->types) * pk->size);
+  }
+  // only a row of integers, or of reals, goes without types.
+  if(p->type && (p->type != t || (t != joqe_type_none_integer
+                                  && t != joqe_type_none_real))) {
+    pk->types = malloc(sizeof(*pk->types) * pk->size);
+    for(int k = 0; k < p->count; ++k)
+      pk->types[k] = p->type;
+    p->type = 0;
+  }
+  if(pk->types)
+    pk->types[p->count] = t;
+  memcpy(&p->v[p->count++], &n->u, sizeof(p->v[0]));
+  return 1;
+}
+
+// the scalars taken so far become list members after all.
+static void
+pack_off(packbuf *pk, joqe_build *b, joqe_node *n)
+{
+  joqe_packed *p = pk->p;
+  for(int k = 0; p && k < p->count; ++k) {
+    joqe_nodels *ls = joqe_arena_nodels();
+    ls->n = (joqe_node){JOQE_TYPE_KEY_INT|(pk->types ? pk->types[k] : p->type),
+                        p->ord + k, {.idx = k}};
+    memcpy(&ls->n.u, &p->v[k], sizeof(p->v[k]));
     joqe_list_append((joqe_list**)&n->u.ls, &ls->ll);
-  } while((token = joqe_yylex(yylval, b)) == ',');
-  if(token == '}')
+    if(b->index)
+      joqe_index_insert(b->index, &ls->n, n->ord, 0, ls->n.ord);
+  }
+  free(p);
+  free(pk->types);
+  pk->p = 0;
+  pk->types = 0;
+  pk->off = 1;
+}
+
+// the array n becomes the row taken, if that's smaller than its list.
+static int
+pack(packbuf *pk, joqe_node *n)
+{
+  joqe_packed *p = pk->p;
+  if(!p)
+    return 0;
+  size_t size = packed_size(p->count, !p->type, 0);
+  if(!packed_pays(size, p->count))
     return 0;
+  p = realloc(p, size);
+  if(pk->types) {
+    memcpy(JOQE_PACKED_TYPES(p), pk->types, sizeof(*pk->types) * p->count);
+    free(pk->types);
+  }
+  pk->p = 0;
+  pk->types = 0;
+  n->type |= JOQE_TYPE_PACKED_MASK;
+  n->u.p = packed_keep(p, size);
+  return 1;
+}
+
+static int
+column_find(const char **keys, int count, const char *key, int guess)
+{
+  // records mostly list their keys in the same order.
+  if(guess < count && (keys[guess] == key || !strcmp(keys[guess], key)))
+    return guess;
+  for(int c = 0; c < count; ++c)
+    if(keys[c] == key || !strcmp(keys[c], key))
+      return c;
+  return -1;
+}
 
-  joqe_yyerror(b, "expected '}'");
-  return token?token:-1;
+// the column of key in a record, added if it's new. -1 if there's no
+// room for it, or the record has had the key already.
+static int
+column_take(const char **keys, int *count, const char *key, int *at,
+            uint64_t *seen)
+{
+  int c = column_find(keys, *count, key, *at);
+  if(c < 0) {
+    if(*count == COLUMNS_MAX)
+      return -1;
+    keys[c = (*count)++] = key;
+  }
+  if(*seen & (UINT64_C(1) << c))
+    return -1;
+  *seen |= UINT64_C(1) << c;
+  *at = c + 1;
+  return c;
 }
 
+// the keys of the records of n, -1 if they aren't all records of a shape
+// taking columns.
 static int
-json_array(JOQE_YYSTYPE *yylval, joqe_build *b, joqe_node *n)
+column_keys(joqe_node *n, const char **keys, int *rows)
 {
-  int token, idx = 0;
-  n->type |= joqe_type_none_array;
+  joqe_nodels *i, *m, *e = n->u.ls;
+  int count = 0;
+  *rows = 0;
+  i = e;
   do {
-    joqe_nodels l = {{}, {joqe_type_int_none, .k = {.idx = idx++}}},
-               *ls;
+    if(JOQE_TYPE_VALUE(i->n.type) != joqe_type_none_object)
+      return -1;
+    ++*rows;
+    uint64_t seen = 0;
+    int at = 0;
+    if(JOQE_TYPE_PACKED(i->n.type)) {
+      const joqe_shape *shape = i->n.u.p->shape;
+      for(int s = 0; s < shape->count; ++s)
+        if(column_take(keys, &count, shape->key[s], &at, &seen) < 0)
+          return -1;
+    } else if((m = i->n.u.ls)) do {
+      if(m->n.type == joqe_type_ref_cnt)
+        continue;
+      if(column_take(keys, &count, m->n.k.key, &at, &seen) < 0)
+        return -1;
+    } while((m = (joqe_nodels*)m->ll.n) != i->n.u.ls);
+  } while((i = (joqe_nodels*)i->ll.n) != e);
+  return count;
+}
 
-    token = joqe_yylex(yylval, b);
-    if(token == ']')
-      // allows [] and [123,]
-      break;
-    if((token = json_element(token, yylval, b, &l.n)))
-      return token;
+static void
+columns_free(void *cols)
+{
+  free(cols);
+}
 
-    *(ls = calloc(1, sizeof(*ls))) = l;
-    joqe_list_append((joqe_list**)&n->u.ls, &ls->ll);
-  } while((token = joqe_yylex(yylval, b)) == ',');
-  if(token == ']')
+static void
+columns(joqe_node *n)
+{
+  const char *keys[COLUMNS_MAX];
+  int rows, count;
+  if(!n->u.ls || (count = column_keys(n, keys, &rows)) < 0
+     || rows < COLUMNS_MIN)
+    return;
+
+  // one block: the header, the records, and the pointers, bits and
+  // slots of each column.
+  int words = (rows + 63) / 64;
+  joqe_columns *cols = malloc(sizeof(*cols) + count * sizeof(cols->col[0])
+                              + rows * sizeof(joqe_node*) * (count + 1)
+                              + words * sizeof(uint64_t) * count
+                              + rows * count);
+  cols->rows = rows;
+  cols->count = count;
+  cols->row = (joqe_node**)&cols->col[count];
+  joqe_node **v = cols->row + rows;
+  uint64_t *valid = (uint64_t*)(v + rows * count);
+  uint8_t *slot = (uint8_t*)(valid + words * count);
+  for(int c = 0; c < count; ++c) {
+    cols->col[c].key = keys[c];
+    cols->col[c].v = memset(v + rows * c, 0, rows * sizeof(*v));
+    cols->col[c].valid = memset(valid + words * c, 0, words * sizeof(*valid));
+    cols->col[c].slot = slot + rows * c;
+  }
+
+  joqe_nodels *i, *m, *e = n->u.ls;
+  int k = 0;
+  i = e;
+  do {
+    int at = 0;
+    cols->row[k] = &i->n;
+    if(JOQE_TYPE_PACKED(i->n.type)) {
+      const joqe_shape *shape = i->n.u.p->shape;
+      for(int s = 0; s < shape->count; ++s) {
+        int c = at = column_find(keys, count, shape->key[s], at);
+        cols->col[c].slot[k] = s;
+        cols->col[c].valid[k / 64] |= UINT64_C(1) << (k % 64);
+        ++at;
+      }
+    } else if((m = i->n.u.ls)) do {
+      if(m->n.type == joqe_type_ref_cnt)
+        continue;
+      int c = at = column_find(keys, count, m->n.k.key, at);
+      cols->col[c].v[k] = &m->n;
+      cols->col[c].valid[k / 64] |= UINT64_C(1) << (k % 64);
+      ++at;
+    } while((m = (joqe_nodels*)m->ll.n) != i->n.u.ls);
+    ++k;
+  } while((i = (joqe_nodels*)i->ll.n) != e);
+
+  // a document parsed into an arena isn't freed node by node.
+  cols->arena = joqe_arena_adopt(cols, columns_free);
+  json_head(n)->n.k.cols = cols;
+}
+
+joqe_nodels*
+joqe_node_members(joqe_node *n)
+{
+  joqe_packed *p;
+  joqe_nodels *ls, *expected = 0;
+  if(!JOQE_TYPE_PACKED(n->type))
+    return n->u.ls;
+
+  p = n->u.p;
+  if((ls = __atomic_load_n(&p->ls, __ATOMIC_ACQUIRE)))
+    return ls;
+
+  // one block, kept with the document, so it isn't taken from the arena
+  // of a query.
+  joqe_nodels *block = calloc(p->count, sizeof(*block));
+  for(int k = 0; k < p->count; ++k) {
+    block[k].n = joqe_packed_member(p, k);
+    joqe_list_append((joqe_list**)&ls, &block[k].ll);
+  }
+
+  // threads racing to make it keep the first one made. A row in the
+  // arena's nodes is queried with that arena in use, its list goes too
+  // when the arena is reset.
+  if(!__atomic_compare_exchange_n(&p->ls, &expected, ls, 0,
+                                  __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    free(ls);
+    ls = expected;
+  } else if(p->arena == PACKED_BLOCK) {
+    joqe_arena_adopt(ls, free);
+  }
+  return ls;
+}
+
+joqe_columns*
+joqe_node_columns(joqe_node *n)
+{
+  if(JOQE_TYPE_VALUE(n->type) != joqe_type_none_array
+     || !JOQE_TYPE_VIEW(n->type) || JOQE_TYPE_PACKED(n->type)
+     || !n->u.ls || n->u.ls->n.type != joqe_type_ref_cnt)
     return 0;
+  return n->u.ls->n.k.cols;
+}
 
-  joqe_yyerror(b, "expected ']'");
-  return token?token:-1;
+struct joqe_column*
+joqe_column_of(joqe_columns *cols, const char *key)
+{
+  for(int c = 0; c < cols->count; ++c)
+    if(!strcmp(cols->col[c].key, key))
+      return &cols->col[c];
+  return 0;
 }
-static int
-json_stringls(JOQE_YYSTYPE *yylval, joqe_build *b, joqe_node *n)
+
+joqe_members
+joqe_members_of(joqe_node *n)
 {
-  n->type |= joqe_type_none_stringls;
-  int token = PARTIALSTRING;
-  while(token == PARTIALSTRING || token == STRING) {
-    joqe_nodels *ls, l = {
-      {}, {joqe_type_none_string, .u = {.s = yylval->string}}
-    };
-    *(ls = calloc(1, sizeof(*ls))) = l;
-    joqe_list_append((joqe_list**)&n->u.ls, &ls->ll);
-    if (token == PARTIALSTRING) {
-      token = joqe_yylex(yylval, b);
-    } else if (token == STRING) {
+  joqe_members it = {};
+  if(JOQE_TYPE_PACKED(n->type))
+    it.p = n->u.p;
+  else
+    it.i = it.end = n->u.ls;
+  return it;
+}
+
+joqe_node*
+joqe_members_next(joqe_members *it)
+{
+  joqe_nodels *i;
+  if(it->p) {
+    if(it->k == it->p->count)
       return 0;
-    }
+    joqe_node *m = joqe_packed_at(it->p, it->k++, &it->m);
+    if(m != &it->m)
+      return joqe_member_shifted(m, it->shift, &it->m);
+    it->m.ord += it->shift;
+    return &it->m;
+  }
+  while((i = it->i)) {
+    it->i = (joqe_nodels*)i->ll.n == it->end ? 0 : (joqe_nodels*)i->ll.n;
+    if(i->n.type != joqe_type_ref_cnt)
+      return joqe_member_shifted(&i->n, it->shift, &it->m);
   }
-  return token?token:-1;
+  return 0;
+}
+
+int
+joqe_members_count(joqe_node *n)
+{
+  joqe_members it = joqe_members_of(n);
+  int count = 0;
+  if(it.p)
+    return it.p->count;
+  while(joqe_members_next(&it))
+    ++count;
+  return count;
+}
+
+// n just parsed, to share the members of an identical subtree if there
+// is one.
+static void
+json_cons(joqe_build *b, joqe_node *n, joqe_arena_pos pos, uint32_t dropped)
+{
+  joqe_node *first;
+  if(!(JOQE_TYPE_PACKED(n->type) || n->u.ls)
+     || !(first = joqe_cons_find(b->cons, n)))
+    return;
+
+  // the members of the subtree are numbered after it, nothing follows
+  // them yet, those of repeats within it are already counted.
+  b->dropped = dropped + b->ord - n->ord;
+  // as its members were all found shared, none of them are remembered,
+  // and the nodes taken since pos are only those of n. Its members are
+  // those of first, only n itself goes.
+  joqe_nodels *i, *next, *end;
+  if((i = end = json_release(n))) do {
+    next = (joqe_nodels*)i->ll.n;
+    if(!joqe_arena_owns(i))
+      free(i);
+  } while((i = next) != end);
+  joqe_arena_rewind(pos);
+  n->u = first->u;
+}
+
+// the stack st twice the size, moved off inl if it's still there.
+static void*
+stack_grow(void *st, void *inl, int *cap, size_t size)
+{
+  *cap *= 2;
+  if(st != inl)
+    return realloc(st, *cap * size);
+  return memcpy(malloc(*cap * size), inl, *cap / 2 * size);
 }
 
 static int
-json_element(int token, JOQE_YYSTYPE *yylval, joqe_build *b, joqe_node *n)
+json_scalar(int token, JOQE_YYSTYPE *yylval, joqe_build *b, joqe_node *n)
 {
-  int mult = 1;
   switch(token)
   {
-    case '{': return json_object(yylval, b, n); break;
-    case '[': return json_array(yylval, b, n); break;
-    case PARTIALSTRING:
-      return json_stringls(yylval, b, n); break;
-    case STRING:
-      n->type |= joqe_type_none_string;
-      n->u.s = yylval->string;
+    case SHORTSTRING:
+      n->type |= joqe_type_none_string|JOQE_TYPE_INLINE_MASK;
+      memcpy(n->u.c, yylval->inl, sizeof(n->u.c));
       break;
+    case STRING: {
+      size_t len = strlen(yylval->string);
+      n->type |= joqe_type_none_string;
+      if(len < sizeof(n->u.c)) {
+        n->type |= JOQE_TYPE_INLINE_MASK;
+        n->u.i = 0;
+        memcpy(n->u.c, yylval->string, len);
+      } else {
+        n->u.s = yylval->string;
+      }
+    } break;
     case INTEGER:
       n->type |= joqe_type_none_integer;
       n->u.i = yylval->integer;
@@ -131,20 +646,6 @@ json_element(int token, JOQE_YYSTYPE *yylval, joqe_build *b, joqe_node *n)
     case _NULL:
       n->type |= joqe_type_none_null;
       break;
-    case '-': mult = -1; /* fall through */
-    case '+':
-      token = joqe_yylex(yylval, b);
-      if(token == INTEGER) {
-        n->type |= joqe_type_none_integer;
-        n->u.i = mult*yylval->integer;
-      } else if (token == REAL) {
-        n->type |= joqe_type_none_real;
-        n->u.d = mult*yylval->real;
-      } else {
-        joqe_yyerror(b, "unexpected plus/minus non-numeric");
-        return -1;
-      }
-      break;
     case 0:
       joqe_yyerror(b, "unexpected end of input");
       return -1;
@@ -160,34 +661,506 @@ json_element(int token, JOQE_YYSTYPE *yylval, joqe_build *b, joqe_node *n)
   return 0;
 }
 
+/* An object or array being parsed. The parser keeps a stack of these
+   rather than recursing, so how deep a document may nest is up to its
+   build, not the C stack. */
+typedef struct {
+  joqe_node       n;       // keyed as a member of its parent
+  joqe_arena_pos  pos;     // before any of its members were taken
+  uint32_t        dropped; // by the build before it
+  int             count;   // members so far
+  int             base;    // of an object's members, among the parser's
+  uint64_t        hash;    // of the keys of an object
+  packbuf         pk;      // the scalars of an array
+} json_frame;
+
+// the container of f is complete, ms the members of an object.
+static void
+json_close(joqe_build *b, json_frame *f, json_member *ms)
+{
+  joqe_node *n = &f->n;
+  if(JOQE_TYPE_VALUE(n->type) == joqe_type_none_object) {
+    if(f->count) {
+      joqe_shape *shape = json_shape(b, ms, f->count, f->hash ^ f->count);
+      if(!record(b, n, shape, ms)) {
+        json_list(b, n, ms, f->count);
+        if(f->count >= SHAPED_MIN)
+          json_head(n)->n.k.shape = shape;
+      }
+    }
+  } else if(!f->pk.off) {
+    if(!pack(&f->pk, n))
+      pack_off(&f->pk, b, n);
+  } else {
+    columns(n);
+  }
+  if(b->cons)
+    json_cons(b, n, f->pos, f->dropped);
+}
+
+/* A document parsed with hash-consing has lists and rows shared by
+   several of its containers, each is freed once, where it's first found.
+   Those found are kept in an open addressed set. */
+typedef struct {
+  void     **slot;
+  uint32_t   mask, count;
+} json_seen;
+
+static uint32_t
+seen_hash(void *v)
+{
+  return (uint32_t)((uintptr_t)v * 0x9e3779b97f4a7c15ull >> 32);
+}
+
+// whether v has been seen, it has now.
+static int
+seen_before(json_seen *s, void *v)
+{
+  uint32_t at;
+  if(2*(s->count + 1) > s->mask + 1) {
+    void **old = s->slot;
+    uint32_t size = old ? 2*(s->mask + 1) : 256;
+    s->slot = calloc(size, sizeof(*s->slot));
+    s->mask = size - 1;
+    for(uint32_t k = 0; old && k < size/2; ++k) {
+      if(!old[k])
+        continue;
+      for(at = seen_hash(old[k]) & s->mask; s->slot[at];)
+        at = (at + 1) & s->mask;
+      s->slot[at] = old[k];
+    }
+    free(old);
+  }
+  for(at = seen_hash(v) & s->mask; s->slot[at]; at = (at + 1) & s->mask)
+    if(s->slot[at] == v)
+      return 1;
+  s->slot[at] = v;
+  s->count++;
+  return 0;
+}
+
+// the list n leaves to be freed with its members, if any.
+static joqe_nodels*
+json_release(joqe_node *n)
+{
+  joqe_columns *cols;
+  if(JOQE_TYPE_PACKED(n->type)) {
+    if(!n->u.p->arena)
+      packed_free(n->u.p);
+    return 0;
+  }
+  switch(JOQE_TYPE_VALUE(n->type)) {
+    case joqe_type_none_array:
+      if((cols = joqe_node_columns(n)) && !cols->arena)
+        columns_free(cols);
+      /* fall through */
+    case joqe_type_none_object:
+    case joqe_type_none_stringls:
+      return n->u.ls;
+  }
+  return 0;
+}
+
+// n shares what it has with one already released.
+static int
+json_shared(joqe_node *n, json_seen *seen)
+{
+  switch(JOQE_TYPE_VALUE(n->type)) {
+    case joqe_type_none_array:
+    case joqe_type_none_object:
+      return seen && n->u.ls && seen_before(seen, n->u.ls);
+  }
+  return 0;
+}
+
+static void
+json_free(joqe_node n, json_seen *seen)
+{
+  joqe_node inl[JSON_INLINE], *st = inl, m;
+  joqe_nodels *i, *next, *end;
+  int sp = 0, cap = JSON_INLINE;
+  // containers left to free, on a stack of their own as nesting may be
+  // deep. The members a row keeps whole are taken off it before it goes.
+  st[sp++] = n;
+  while(sp) {
+    m = st[--sp];
+    if(json_shared(&m, seen))
+      continue;
+    for(int k = 0; JOQE_TYPE_PACKED(m.type) && k < m.u.p->nodes; ++k) {
+      if(sp == cap)
+        st = stack_grow(st, inl, &cap, sizeof(*st));
+      st[sp++] = JOQE_PACKED_NODES(m.u.p)[k];
+    }
+    if((i = end = json_release(&m))) do {
+      next = (joqe_nodels*)i->ll.n;
+      if(joqe_packed_whole(i->n.type)) {
+        if(sp == cap)
+          st = stack_grow(st, inl, &cap, sizeof(*st));
+        st[sp++] = i->n;
+      }
+      if(!joqe_arena_owns(i))
+        free(i);
+    } while((i = next) != end);
+  }
+  if(st != inl)
+    free(st);
+}
+
+void
+joqe_json_free (joqe_node n)
+{
+  json_free(n, 0);
+}
+
 static int
 json_construct (joqe_ast_construct *c,
                 joqe_node *nn, joqe_ctx *cc,
                 joqe_result *r)
 {
   if(!nn) {
-    joqe_result r = {};
-    joqe_result_clear_node(c->u.node, &r);
-    joqe_result_destroy(&r);
+    joqe_json_free(c->u.node);
     return 0;
   }
 
-  joqe_nodels *ls = calloc(1, sizeof(*ls));
-  ls->n = joqe_result_copy_node(&c->u.node);
+  joqe_nodels *ls = joqe_arena_nodels();
+  ls->n = c->u.node; // a view, the build keeps the document
   joqe_list_append((joqe_list**)r, &ls->ll);
   return 1;
 }
 
+// as json_construct, for a document parsed with hash-consing.
+static int
+json_construct_shared (joqe_ast_construct *c,
+                       joqe_node *nn, joqe_ctx *cc,
+                       joqe_result *r)
+{
+  if(!nn) {
+    json_seen seen = {};
+    json_free(c->u.node, &seen);
+    free(seen.slot);
+    return 0;
+  }
+  return json_construct(c, nn, cc, r);
+}
+
+enum {
+  JSON_VALUE,   // the value of n is next
+  JSON_SIGN,    // of a number, the number is next
+  JSON_PARTS,   // of a string, more are next
+  JSON_MEMBER,  // of the container on top, or its end
+  JSON_COLON,   // after the key of an object member
+  JSON_AFTER,   // a member, a comma or the end of its container is next
+  JSON_DONE,
+  JSON_FAILED
+};
+
+// returned by json_token for the next one.
+#define JSON_NEXT JOQE_JSON_MORE
+
+/* The parser, a token at a time. The value being parsed and the stack of
+   objects and arrays it's in are kept here between tokens, so a document
+   may be handed over in pieces (see joqe_json_push) as well as read
+   through in one go. */
+struct joqe_json_parser {
+  joqe_build   *b;
+  int           state;
+  int           r;     // once done or failed
+  int           mult;  // of a signed number
+  int           sp, cap, depth;
+  int           msp, mcap;
+  int           cut;   // of a string cut short, bytes read without its end
+  json_frame   *st;
+  json_member  *ms;    // of the objects open
+  joqe_node     n;
+  const char   *key;
+  JOQE_YYSTYPE  yylval;
+  json_frame    inl[JSON_INLINE];
+  json_member   minl[JSON_INLINE];
+};
+
+static void
+json_start(joqe_json_parser *p, joqe_build *b)
+{
+  p->b = b;
+  p->state = JSON_VALUE;
+  p->r = 0;
+  p->sp = 0;
+  p->cap = JSON_INLINE;
+  p->depth = b->depth ? b->depth : JOQE_JSON_DEPTH;
+  p->st = p->inl;
+  p->msp = 0;
+  p->mcap = JSON_INLINE;
+  p->ms = p->minl;
+  p->cut = 0;
+  memset(&p->n, 0, sizeof(p->n));
+  b->short_strings = 1;
+}
+
+// done with r, the result of the parse. The document is the build's.
+static int
+json_end(joqe_json_parser *p, int r)
+{
+  joqe_build *b = p->b;
+  // only a failed parse leaves containers open.
+  for(int k = 0; k < p->sp; ++k) {
+    free(p->st[k].pk.p);
+    free(p->st[k].pk.types);
+  }
+  if(p->st != p->inl)
+    free(p->st);
+  if(p->ms != p->minl)
+    free(p->ms);
+  p->sp = p->msp = 0;
+  p->st = p->inl;
+  p->ms = p->minl;
+  p->mcap = JSON_INLINE;
+  p->state = r ? JSON_FAILED : JSON_DONE;
+  b->short_strings = 0;
+  if(!(p->r = r)) {
+    joqe_ast_construct c = {b->cons ? json_construct_shared : json_construct,
+                            {.node = p->n}};
+    b->root = c;
+    if(b->index) {
+      joqe_index_insert(b->index, &b->root.u.node, 0, 0, b->ord);
+      joqe_index_finish(b->index);
+    }
+  }
+  return r;
+}
+
+// takes token, JSON_NEXT for another, otherwise the parse is done with
+// the result returned.
+static int
+json_token(joqe_json_parser *p, int token)
+{
+  joqe_build *b = p->b;
+  JOQE_YYSTYPE *yylval = &p->yylval;
+  json_frame *f = p->sp ? &p->st[p->sp-1] : 0;
+  int r, object = f && JOQE_TYPE_VALUE(f->n.type) == joqe_type_none_object;
+
+  switch(p->state) {
+    case JSON_MEMBER:
+      // this allows {}, {"a":"b",}, [] and [123,].
+      if(object) {
+        if(token != STRING)
+          break;
+        p->key = yylval->string;
+        p->state = JSON_COLON;
+        return JSON_NEXT;
+      }
+      if(token == ']')
+        break;
+      p->n = (joqe_node){joqe_type_int_none, .k = {.idx = f->count++}};
+      /* fall through */
+    case JSON_VALUE:
+      // preorder, containers are numbered before their members.
+      p->n.ord = ++b->ord;
+      switch(token) {
+        case '{':
+        case '[':
+          if(p->sp == p->depth) {
+            joqe_yyerror(b, "document nested too deep");
+            return json_end(p, -1);
+          }
+          if(p->sp == p->cap)
+            p->st = stack_grow(p->st, p->inl, &p->cap, sizeof(*p->st));
+          f = &p->st[p->sp++];
+          *f = (json_frame){p->n, joqe_arena_position(), b->dropped,
+                            .base = p->msp};
+          f->n.type |= JOQE_TYPE_VIEW_MASK
+                     | (token == '{' ? joqe_type_none_object
+                                     : joqe_type_none_array);
+          // keys are kept in the build, values may be lexed short.
+          b->short_strings = token == '[';
+          p->state = JSON_MEMBER;
+          return JSON_NEXT;
+        case PARTIALSTRING:
+          p->n.type |= joqe_type_none_stringls|JOQE_TYPE_VIEW_MASK;
+          b->short_strings = 0;
+          p->state = JSON_PARTS;
+          goto parts;
+        case '-':
+        case '+':
+          p->mult = token == '-' ? -1 : 1;
+          p->state = JSON_SIGN;
+          return JSON_NEXT;
+      }
+      if((r = json_scalar(token, yylval, b, &p->n)))
+        return json_end(p, r);
+      goto complete;
+    case JSON_SIGN:
+      if(token == INTEGER) {
+        p->n.type |= joqe_type_none_integer;
+        p->n.u.i = p->mult*yylval->integer;
+      } else if (token == REAL) {
+        p->n.type |= joqe_type_none_real;
+        p->n.u.d = p->mult*yylval->real;
+      } else {
+        joqe_yyerror(b, "unexpected plus/minus non-numeric");
+        return json_end(p, -1);
+      }
+      goto complete;
+    case JSON_PARTS:
+    parts:
+      if(token == PARTIALSTRING || token == STRING) {
+        joqe_nodels *ls, l = {
+          {}, {joqe_type_none_string, .u = {.s = yylval->string}}
+        };
+        *(ls = joqe_arena_nodels()) = l;
+        joqe_list_append((joqe_list**)&p->n.u.ls, &ls->ll);
+        if(token == STRING)
+          goto complete;
+        return JSON_NEXT;
+      }
+      return json_end(p, token ? token : -1);
+    case JSON_COLON:
+      if(token != ':') {
+        joqe_yyerror(b, "expected ':'");
+        return json_end(p, -1);
+      }
+      f->count++;
+      p->n = (joqe_node){joqe_type_string_none, .k = {.key = p->key}};
+      b->short_strings = 1;
+      p->state = JSON_VALUE;
+      return JSON_NEXT;
+    case JSON_AFTER:
+      if(token == ',') {
+        b->short_strings = !object;
+        p->state = JSON_MEMBER;
+        return JSON_NEXT;
+      }
+      break;
+    default:
+      return p->r;
+  }
+
+  // the container on top ends, or should have.
+  if(token != (object ? '}' : ']')) {
+    joqe_yyerror(b, object ? "expected '}'" : "expected ']'");
+    return json_end(p, token ? token : -1);
+  }
+  json_close(b, f, &p->ms[f->base]);
+  p->msp = f->base;
+  p->n = f->n;
+  if(!--p->sp)
+    return json_end(p, 0);
+  f = &p->st[p->sp-1];
+  object = JOQE_TYPE_VALUE(f->n.type) == joqe_type_none_object;
+
+complete:
+  // n is the next member of f, if there is one.
+  if(!f)
+    return json_end(p, 0);
+  if(object) {
+    f->hash = (f->hash ^ (uintptr_t)p->n.k.key) * 0x100000001b3u;
+    if(p->msp == p->mcap)
+      p->ms = stack_grow(p->ms, p->minl, &p->mcap, sizeof(*p->ms));
+    p->ms[p->msp++] = (json_member){p->n, b->ord};
+  } else if(b->index || !pack_take(&f->pk, &p->n)) {
+    // the index refers to members by their node, as with records.
+    if(!f->pk.off)
+      pack_off(&f->pk, b, &f->n);
+    joqe_nodels *ls = joqe_arena_nodels();
+    ls->n = p->n;
+    joqe_list_append((joqe_list**)&f->n.u.ls, &ls->ll);
+    if(b->index)
+      joqe_index_insert(b->index, &ls->n, f->n.ord, 0, b->ord);
+  }
+  p->state = JSON_AFTER;
+  return JSON_NEXT;
+}
+
 int
 joqe_json (joqe_build *b)
 {
-  JOQE_YYSTYPE yylval;
+  joqe_json_parser p;
+  int r;
+  json_start(&p, b);
+  while((r = json_token(&p, joqe_yylex(&p.yylval, b))) == JSON_NEXT)
+    ;
+  return r;
+}
 
-  joqe_node n = {};
-  int r = json_element(joqe_yylex(&yylval, b), &yylval, b, &n);
-  if(0 == r) {
-    joqe_ast_construct c = {json_construct, {.node = n}};
-    b->root = c;
+joqe_json_parser*
+joqe_json_parser_create (joqe_build *b)
+{
+  joqe_json_parser *p = malloc(sizeof(*p));
+  json_start(p, b);
+  return p;
+}
+
+void
+joqe_json_parser_destroy (joqe_json_parser *p)
+{
+  if(p && p->state != JSON_DONE && p->state != JSON_FAILED)
+    json_end(p, -1);
+  free(p);
+}
+
+// whether token is whole even though the input ran out reading past it.
+static int
+json_whole(int token)
+{
+  switch(token) {
+    case '{': case '}': case '[': case ']': case ',': case '+': case '-':
+    case STRING: case SHORTSTRING:
+      return 1;
+  }
+  return 0;
+}
+
+static int
+json_white(int c)
+{
+  switch(c) {
+    case '\r': case '\n': case '\t': case '\v': case '\f': case ' ':
+      return 1;
+  }
+  return 0;
+}
+
+int
+joqe_json_push (joqe_json_parser *p, const char *buf, int len)
+{
+  joqe_build *b = p->b;
+  joqe_lex_source *src = &b->src;
+  int r = JSON_NEXT;
+  if(p->state == JSON_DONE || p->state == JSON_FAILED)
+    return p->r;
+
+  joqe_lex_source_append(src, buf, len);
+  while(r == JSON_NEXT) {
+    // so a token lexed again starts where it does.
+    while(!b->mode && json_white(src->c))
+      joqe_lex_source_read(src);
+    // the character ahead of the next token is still to come.
+    if(src->c < 0 && src->more)
+      return JOQE_JSON_MORE;
+
+    // nor is a string cut short before its end could be there.
+    int q = b->mode ? b->mode : src->c;
+    if(p->cut && src->more && (q == '"' || q == '\'')) {
+      int at = src->at + p->cut;
+      if(!memchr(src->u.s + at, q, src->e - at)) {
+        p->cut = src->e - src->at;
+        return JOQE_JSON_MORE;
+      }
+    }
+
+    joqe_lex_source at = *src;
+    int mode = b->mode, token = joqe_yylex(&p->yylval, b);
+    if(src->more < 0 && !json_whole(token)) {
+      // cut short by the end of the input so far, the token is lexed
+      // again from its start once there's more.
+      if(b->current)
+        joqe_build_cancelstring(b);
+      p->cut = src->e - at.at;
+      *src = at;
+      b->mode = mode;
+      return JOQE_JSON_MORE;
+    }
+    p->cut = 0;
+    r = json_token(p, token);
   }
   return r;
 }
@@ -4,17 +4,33 @@
 #include "util.h"
 
 #include <stdint.h>
+#include <string.h>
 
 #define JOQE_TYPE_VALUE_MASK  0x0f
 #define JOQE_TYPE_KEY_MASK    0x30
+// the list of a view is borrowed from a document, which owns it.
+#define JOQE_TYPE_VIEW_MASK   0x40
+// an array of numbers, or a record, kept as a joqe_packed, not a list.
+#define JOQE_TYPE_PACKED_MASK 0x100
+// a document string short enough to be kept in the node, see u.c.
+#define JOQE_TYPE_INLINE_MASK 0x200
+// a key kept in the node the same way, see k.c. Not part of JOQE_TYPE,
+// which keys a node anew.
+#define JOQE_TYPE_KEY_INLINE_MASK 0x400
 
 #define JOQE_TYPE_KEY_NONE    0x00
 #define JOQE_TYPE_KEY_STRING  0x10
 #define JOQE_TYPE_KEY_INT     0x20
 
-#define JOQE_TYPE(k,v)        (JOQE_TYPE_KEY(k)|JOQE_TYPE_VALUE(v))
+#define JOQE_TYPE(k,v)        (JOQE_TYPE_KEY(k)|JOQE_TYPE_VALUE(v)\
+                               |JOQE_TYPE_VIEW(v)|JOQE_TYPE_PACKED(v)\
+                               |JOQE_TYPE_INLINE(v))
 #define JOQE_TYPE_VALUE(t)    (JOQE_TYPE_VALUE_MASK&(t))
 #define JOQE_TYPE_KEY(t)      (JOQE_TYPE_KEY_MASK&(t))
+#define JOQE_TYPE_VIEW(t)     (JOQE_TYPE_VIEW_MASK&(t))
+#define JOQE_TYPE_PACKED(t)   (JOQE_TYPE_PACKED_MASK&(t))
+#define JOQE_TYPE_INLINE(t)   (JOQE_TYPE_INLINE_MASK&(t))
+#define JOQE_TYPE_KEY_INLINE(t) (JOQE_TYPE_KEY_INLINE_MASK&(t))
 typedef enum {
   joqe_type_broken       = 0x00,
   joqe_type_none_true    = 0x01,
@@ -50,27 +66,296 @@ typedef enum {
 } joqe_type;
 
 typedef struct joqe_nodels joqe_nodels;
+typedef struct joqe_packed joqe_packed;
+typedef struct joqe_columns joqe_columns;
+typedef struct joqe_shape joqe_shape;
 
 typedef struct {
   joqe_type type;
+  uint32_t  ord;    // document order, 0 for values not from a document
   union {
-    const char *key;
-    int         idx;
+    const char   *key;
+    int           idx;
+    joqe_columns *cols; // of the sentinel of a document array of records
+    joqe_shape   *shape; // of the sentinel of a document object
+    char          c[8]; // an inline string made a key, as u.c
   } k;
   union {
     const char   *s;
     int64_t       i;
     double        d;
     joqe_nodels *ls;
+    joqe_packed *p;
+    char          c[8]; // up to 7 bytes and the terminator, zero padded
   } u;
 } joqe_node;
 
+// the string value of n, which goes with n if it's inline.
+static inline const char*
+joqe_node_string(const joqe_node *n)
+{
+  return JOQE_TYPE_INLINE(n->type) ? n->u.c : n->u.s;
+}
+
+// the key of member n, which goes with n if it's inline.
+static inline const char*
+joqe_member_key(const joqe_node *n)
+{
+  return JOQE_TYPE_KEY_INLINE(n->type) ? n->k.c : n->k.key;
+}
+
+// n keyed by the string s, kept in n if s is inline: keys are referred
+// to, and an inline string has nothing to refer to beyond its node.
+static inline void
+joqe_member_keyed(joqe_node *n, const joqe_node *s)
+{
+  n->type = JOQE_TYPE(joqe_type_string_none, n->type);
+  if(JOQE_TYPE_INLINE(s->type)) {
+    n->type |= JOQE_TYPE_KEY_INLINE_MASK;
+    memcpy(n->k.c, s->u.c, sizeof(n->k.c));
+  } else {
+    n->k.key = s->u.s;
+  }
+}
+
 struct joqe_nodels {
   joqe_list ll;
   joqe_node n;
 };
 
+/* Document objects listing the same keys in the same order share a
+   shape, interned per build and kept in the row of a record, or the
+   sentinel heading the list of an object of at least 8 keys; smaller
+   objects are looked through. A key is looked up in the shape once,
+   giving its slot, the position of the member in every object of the
+   shape. */
+struct joqe_shape {
+  joqe_shape   *nxt;    // of the build
+  uint32_t      id;     // unique to the process, unlike its address
+  int           count;
+  int           unique; // no key listed twice
+  int           mask;   // of map
+  int          *map;    // slot + 1 by hash of the key, 0 where empty
+  const char   *key[];
+};
+
+// the slot of key in the shape, -1 if it's not in it.
+int  joqe_shape_slot (const joqe_shape *shape, const char *key);
+
+/* Document arrays of scalars are parsed into a row of values, if it's
+   smaller than their list. So are records: objects of at least two
+   members keyed by a shape listing no key twice. The members of a row
+   take 8 bytes each, with a 16 bit type after the values unless they're
+   all integers or all reals, and their keys in the shape, rather than a
+   node in a list. Those that are objects, arrays or strings in fragments
+   are kept whole, as nodes at the end of the row, where their value
+   gives the node. With any such member, the document order of each
+   member is kept as well, as it no longer follows the one before. The
+   members are made as nodes when they're visited, and only kept as a
+   list for those who ask for it. */
+struct joqe_packed {
+  joqe_nodels *ls;    // the list, once asked for
+  int64_t      hash;  // of the subtree, see nodehash.h
+  const joqe_shape *shape; // the keys of a record, null for an array
+  uint32_t     ord;   // of the first member
+  int          count;
+  uint16_t     type;  // of every member, integer or real, 0 if typed
+  uint16_t     arena; // released with the arena it was parsed into
+  uint32_t     nodes; // members kept whole
+  union {
+    int64_t i;
+    double  d;
+  }            v[];
+};
+
+// the order of the members of a row if it keeps nodes, the types of
+// its members if it's typed, and the nodes.
+#define JOQE_PACKED_ORDS(p)  ((uint32_t*)&(p)->v[(p)->count])
+#define JOQE_PACKED_TYPES(p) \
+  ((uint16_t*)&JOQE_PACKED_ORDS(p)[(p)->nodes ? (p)->count : 0])
+#define JOQE_PACKED_NODES(p) \
+  ((joqe_node*)&(p)->v[(p)->count + ((p)->count * 6 + 7) / 8])
+
+// a member of type t is kept whole in a row.
+static inline int
+joqe_packed_whole(int t)
+{
+  switch(JOQE_TYPE_VALUE(t)) {
+    case joqe_type_none_object:
+    case joqe_type_none_array:
+    case joqe_type_none_stringls:
+      return 1;
+  }
+  return 0;
+}
+
+// member k of a packed array or record, made in *tmp unless it's kept
+// whole.
+static inline joqe_node*
+joqe_packed_at(joqe_packed *p, int k, joqe_node *tmp)
+{
+  joqe_type t = p->type ? p->type : JOQE_PACKED_TYPES(p)[k];
+  if(p->nodes && joqe_packed_whole(t))
+    return &JOQE_PACKED_NODES(p)[p->v[k].i];
+  *tmp = (joqe_node){JOQE_TYPE_KEY_INT|t, p->ord + k, {.idx = k}};
+  if(p->shape) {
+    tmp->type = JOQE_TYPE_KEY_STRING|t;
+    tmp->k.key = p->shape->key[k];
+  }
+  if(p->nodes)
+    tmp->ord = JOQE_PACKED_ORDS(p)[k];
+  memcpy(&tmp->u, &p->v[k], sizeof(p->v[k]));
+  return tmp;
+}
+
+// member k of a packed array or record.
+static inline joqe_node
+joqe_packed_member(joqe_packed *p, int k)
+{
+  joqe_node tmp;
+  return *joqe_packed_at(p, k, &tmp);
+}
+
+// the members of an object or array as a list, made for packed ones.
+joqe_nodels*  joqe_node_members  (joqe_node *n);
+
+/* A subtree shared by repeats (see cons.h) keeps the document order of
+   its first, as its members are only parsed once. The first member, of
+   a list or a row, follows the container it was parsed for, so a repeat
+   knows how far its members are off. */
+static inline uint32_t
+joqe_members_shift(const joqe_node *n)
+{
+  joqe_nodels *first;
+  if(!n->ord || !JOQE_TYPE_VIEW(n->type))
+    return 0;
+  if(JOQE_TYPE_PACKED(n->type))
+    return n->ord + 1 - n->u.p->ord;
+  switch(JOQE_TYPE_VALUE(n->type)) {
+    case joqe_type_none_object:
+    case joqe_type_none_array:
+      if(!(first = n->u.ls))
+        return 0;
+      if(first->n.type == joqe_type_ref_cnt)
+        first = (joqe_nodels*)first->ll.n;
+      return n->ord + 1 - first->n.ord;
+  }
+  return 0;
+}
+
+// m, a member of a container off by shift, made in *tmp if it is.
+static inline joqe_node*
+joqe_member_shifted(joqe_node *m, uint32_t shift, joqe_node *tmp)
+{
+  if(!shift)
+    return m;
+  *tmp = *m;
+  tmp->ord += shift;
+  return tmp;
+}
+
+/* Document arrays of objects, records, keep their members in a column
+   per key as well, in a sentinel heading the list. A column points to
+   the member each record has for its key, if it has one (the bit of the
+   record is set in valid), so a key can be looked up for all records
+   without going through their members. Only arrays of at least 8
+   records, with no more than 32 keys between them, and none repeated
+   within a record, are given columns. The members of packed records
+   aren't nodes to point to, the column has their slot instead. */
+struct joqe_column {
+  const char  *key;
+  uint64_t    *valid; // a bit per record
+  joqe_node  **v;     // the member, null where not valid or packed
+  uint8_t     *slot;  // of the member in a packed record
+};
+
+struct joqe_columns {
+  int                 rows;
+  int                 count;
+  int                 arena; // released with the arena it was parsed into
+  joqe_node         **row;   // the records, in order
+  struct joqe_column  col[];
+};
+
+// the columns of an array, null if it has none.
+joqe_columns*        joqe_node_columns (joqe_node *n);
+struct joqe_column*  joqe_column_of    (joqe_columns *cols, const char *key);
+
+// the member of record k in col, which must be valid, made in *tmp if the
+// record is packed, as by joqe_packed_at.
+static inline joqe_node*
+joqe_column_member(joqe_columns *cols, struct joqe_column *col, int k,
+                   joqe_node *tmp)
+{
+  if(col->v[k])
+    return col->v[k];
+  return joqe_packed_at(cols->row[k]->u.p, col->slot[k], tmp);
+}
+
+/* An inline cache for looking a key up in objects: the last shape seen
+   and the key's slot in it. Shapes go with their build, and another's
+   may be given the same address, so the cache goes by their id. */
+typedef struct joqe_shape_cache {
+  uint32_t  id;
+  int       slot;
+} joqe_shape_cache;
+
+// 1 with the member of object n for key in *m, found through its shape,
+// 0 if it has none. -1 if n has no shape to go by, and its members are
+// to be looked through instead. The member of a record may be made in
+// *tmp.
+int  joqe_shape_member (joqe_node *n, const char *key,
+                        joqe_shape_cache *cache, joqe_node **m,
+                        joqe_node *tmp);
+
+/* Walks the members of an object or array, packed or not, skipping the
+   sentinel at the head if there is one. A member made from a row lives in
+   the walk until the next one is taken, as does a shifted one: a walk
+   given the shift of its container numbers the members as they are found
+   there. */
+typedef struct joqe_members {
+  joqe_nodels *i, *end;
+  joqe_packed *p;
+  int          k;
+  uint32_t     shift; // of the document order, see joqe_members_shift
+  joqe_node    m;
+} joqe_members;
+
+joqe_members  joqe_members_of    (joqe_node *n);
+// the next member, null past the last.
+joqe_node*    joqe_members_next  (joqe_members *it);
+int           joqe_members_count (joqe_node *n);
+
+/* Parsed documents are never written to by evaluation, results only view
+   them. A document parsed without an arena in use may thus be queried
+   from several threads at once, each with its own results and arena.
+   The parser keeps a stack of the objects and arrays it's in rather than
+   recursing, and fails documents nesting deeper than their build allows,
+   JOQE_JSON_DEPTH levels unless it says otherwise. */
+#define JOQE_JSON_DEPTH 1000000
+
 struct joqe_build;
 int joqe_json (struct joqe_build *b);
+// releases a parsed value, its lists are only ever viewed by results.
+void joqe_json_free (joqe_node n);
+
+/* A document handed over in pieces as they arrive, for a caller that
+   can't block waiting for the rest, such as an event loop. The build is
+   made with joqe_lex_source_chunked(). Each piece pushed gives
+   JOQE_JSON_MORE until the document is complete, 0 with the root of the
+   build set as by joqe_json, or fails, as joqe_json would; a null buf ends
+   the input, which a document of a single number, null, true or false
+   needs, as its end can't be told without a delimiter. The parser keeps
+   its state on the heap between pieces, and only a token cut in two by
+   the end of one is lexed again. */
+#define JOQE_JSON_MORE 1
+
+typedef struct joqe_json_parser joqe_json_parser;
+
+joqe_json_parser* joqe_json_parser_create  (struct joqe_build *b);
+int               joqe_json_push           (joqe_json_parser *p,
+                                            const char *buf, int len);
+// the build keeps the document, if it's complete.
+void              joqe_json_parser_destroy (joqe_json_parser *p);
 
 #endif /* idempotent include guard */
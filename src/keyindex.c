@@ -0,0 +1,206 @@
+#include "keyindex.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct posting {
+  const char *key;
+  uint32_t    hash;
+  int         count;
+  int         size;
+  uint32_t   *ords;
+} posting;
+
+typedef struct indexed {
+  joqe_node  *n;
+  uint32_t    parent;
+  uint32_t    last;
+} indexed;
+
+struct joqe_index {
+  indexed    *nodes;
+  uint32_t    size;
+
+  posting    *keys;
+  uint32_t    mask;
+  uint32_t    used;
+};
+
+static uint32_t
+key_hash(const char *s)
+{
+  uint32_t h = 0x811c9dc5u;
+  for(; *s; ++s)
+    h = (h ^ (unsigned char)*s) * 0x01000193u;
+  return h;
+}
+
+static posting*
+key_slot(posting *keys, uint32_t mask, const char *key, uint32_t h)
+{
+  for(uint32_t i = h & mask;; i = (i+1) & mask) {
+    posting *p = &keys[i];
+    if(!p->key || (p->hash == h && !strcmp(p->key, key)))
+      return p;
+  }
+}
+
+static void
+key_grow(joqe_index *idx)
+{
+  uint32_t mask = idx->mask ? idx->mask*2+1 : 63;
+  posting *keys = calloc(mask+1, sizeof(*keys));
+  for(uint32_t i = 0; idx->keys && i <= idx->mask; ++i) {
+    posting *p = &idx->keys[i];
+    if(p->key)
+      *key_slot(keys, mask, p->key, p->hash) = *p;
+  }
+  free(idx->keys);
+  idx->keys = keys;
+  idx->mask = mask;
+}
+
+joqe_index*
+joqe_index_create()
+{
+  return calloc(1, sizeof(joqe_index));
+}
+
+void
+joqe_index_destroy(joqe_index *idx)
+{
+  if(!idx)
+    return;
+  for(uint32_t i = 0; idx->keys && i <= idx->mask; ++i)
+    free(idx->keys[i].ords);
+  free(idx->keys);
+  free(idx->nodes);
+  free(idx);
+}
+
+void
+joqe_index_insert(joqe_index *idx, joqe_node *n,
+                  uint32_t parent, const char *key, uint32_t last)
+{
+  uint32_t ord = n->ord;
+  if(ord >= idx->size) {
+    uint32_t size = idx->size ? idx->size : 64;
+    while(size <= ord) size *= 2;
+    idx->nodes = realloc(idx->nodes, size*sizeof(*idx->nodes));
+    memset(&idx->nodes[idx->size], 0,
+           (size-idx->size)*sizeof(*idx->nodes));
+    idx->size = size;
+  }
+  indexed x = {n, parent, last};
+  idx->nodes[ord] = x;
+
+  if(!key)
+    return;
+  if((idx->used+1)*4 > (idx->mask+1)*3)
+    key_grow(idx);
+  uint32_t h = key_hash(key);
+  posting *p = key_slot(idx->keys, idx->mask, key, h);
+  if(!p->key) {
+    p->key = key;
+    p->hash = h;
+    ++idx->used;
+  }
+  if(p->count == p->size) {
+    p->size = p->size ? p->size*2 : 4;
+    p->ords = realloc(p->ords, p->size*sizeof(*p->ords));
+  }
+  p->ords[p->count++] = ord;
+}
+
+static int
+ord_cmp(const void *a, const void *b)
+{
+  uint32_t l = *(const uint32_t*)a, r = *(const uint32_t*)b;
+  return (l > r) - (l < r);
+}
+
+void
+joqe_index_finish(joqe_index *idx)
+{
+  // members are inserted after their own subtree, sort into document order.
+  for(uint32_t i = 0; idx->keys && i <= idx->mask; ++i) {
+    posting *p = &idx->keys[i];
+    if(p->count > 1)
+      qsort(p->ords, p->count, sizeof(*p->ords), ord_cmp);
+  }
+}
+
+joqe_node*
+joqe_index_node(joqe_index *idx, joqe_node *n)
+{
+  if(!n->ord || n->ord >= idx->size)
+    return 0;
+  joqe_node *x = idx->nodes[n->ord].n;
+  if(!x || JOQE_TYPE_VALUE(x->type) != JOQE_TYPE_VALUE(n->type))
+    return 0;
+  return x;
+}
+
+typedef struct candidate {
+  uint32_t parent;
+  uint32_t ord;
+} candidate;
+
+static int
+candidate_cmp(const void *a, const void *b)
+{
+  const candidate *l = a, *r = b;
+  if(l->parent != r->parent)
+    return (l->parent > r->parent) - (l->parent < r->parent);
+  return (l->ord > r->ord) - (l->ord < r->ord);
+}
+
+int
+joqe_index_descendants(joqe_index *idx, joqe_node *n,
+                       const char *key, int parents, joqe_node ***out)
+{
+  *out = 0;
+  if(!idx->keys || !joqe_index_node(idx, n))
+    return 0;
+  posting *p = key_slot(idx->keys, idx->mask, key, key_hash(key));
+  if(!p->key)
+    return 0;
+
+  uint32_t from = n->ord, to = idx->nodes[from].last;
+  // first member past the start of the subtree.
+  int lo = 0, hi = p->count;
+  while(lo < hi) {
+    int mid = lo + (hi-lo)/2;
+    if(p->ords[mid] <= from) lo = mid+1;
+    else hi = mid;
+  }
+
+  candidate *c = malloc((p->count-lo+1)*sizeof(*c));
+  int count = 0, sorted = 1;
+  for(int i = lo; i < p->count && p->ords[i] <= to; ++i) {
+    uint32_t ord = p->ords[i];
+    if(parents) {
+      // n itself is not a descendant.
+      if((ord = idx->nodes[ord].parent) <= from)
+        continue;
+    }
+    candidate x = {idx->nodes[ord].parent, ord};
+    if(count && candidate_cmp(&c[count-1], &x) > 0)
+      sorted = 0;
+    c[count++] = x;
+  }
+  // out of order only where a member is nested in one with the same key.
+  if(!sorted)
+    qsort(c, count, sizeof(*c), candidate_cmp);
+
+  joqe_node **ls = malloc((count+1)*sizeof(*ls));
+  int found = 0;
+  for(int i = 0; i < count; ++i) {
+    if(i && c[i].ord == c[i-1].ord)
+      continue;
+    ls[found++] = idx->nodes[c[i].ord].n;
+  }
+  free(c);
+  *out = ls;
+  return found;
+}
@@ -0,0 +1,39 @@
+#ifndef __JOQE_KEYINDEX_H__
+#define __JOQE_KEYINDEX_H__
+
+#include "json.h"
+
+/* An inverted index over a parsed document, from object key to every
+   member with that key. Nodes are identified by their document ordinal,
+   and the members of a subtree are the ordinals up to the last one in
+   the subtree, so descendant queries are a range lookup. */
+
+typedef struct joqe_index joqe_index;
+
+joqe_index* joqe_index_create  ();
+void        joqe_index_destroy (joqe_index  *idx);
+
+// register a node once its subtree is complete, key is 0 for array
+// members and the root.
+void        joqe_index_insert  (joqe_index  *idx,
+                                joqe_node   *n,
+                                uint32_t     parent,
+                                const char  *key,
+                                uint32_t     last);
+void        joqe_index_finish  (joqe_index  *idx);
+
+// the indexed node a copy refers to, null if it isn't from the document.
+joqe_node*  joqe_index_node    (joqe_index  *idx,
+                                joqe_node   *n);
+
+/* Descendants of n in the order a recursive walk would find them: by
+   parent in document order, then by position among siblings. These are
+   the members keyed key or, with parents set, the nodes having such a
+   member. Returns the number of nodes, *out must be freed. */
+int         joqe_index_descendants (joqe_index   *idx,
+                                    joqe_node    *n,
+                                    const char   *key,
+                                    int           parents,
+                                    joqe_node  ***out);
+
+#endif /* idempotent include guard */
@@ -112,6 +112,7 @@ joqe_lex_source_read(joqe_lex_source *s)
 {
   if(s->mbi) // pushed utf-8 multi-bytes.
     return (s->c = s->mb[--s->mbi]);
+  s->at = s->b;
 
   int f = s->f;
   uint32_t cp = 0;
@@ -377,3 +378,76 @@ joqe_lex_source_stringarray(int i, char * const *ss)
   joqe_lex_source_read(&src);
   return src;
 }
+
+static int
+read_chunked (joqe_lex_source *s)
+{
+  if(s->b<s->e)
+    return s->u.ubuf[s->b++];
+  if(s->more)
+    s->more = -1;
+  return -1;
+}
+
+static void
+destroy_chunked (joqe_lex_source *s)
+{
+  s->read = read_eof;
+  s->destroy = destroy_eof;
+  free(s->u.buf);
+  s->u.buf = 0;
+}
+
+joqe_lex_source
+joqe_lex_source_chunked()
+{
+  // i is the size of the buffer, at -1 until the byte order is known.
+  joqe_lex_source src = {.c = -1, .at = -1, .more = 1};
+  src.read = read_chunked;
+  src.destroy = destroy_chunked;
+  return src;
+}
+
+void
+joqe_lex_source_append(joqe_lex_source *s, const char *buf, int len)
+{
+  int again = s->more < 0, bom;
+  if(!buf) {
+    s->more = 0;
+  } else {
+    // what's before the character in c is read, and won't be again.
+    if(s->at > 0) {
+      memmove(s->u.buf, s->u.buf + s->at, s->e - s->at);
+      s->b -= s->at;
+      s->e -= s->at;
+      s->at = 0;
+    }
+    if(s->e + len > s->i) {
+      while(s->e + len > s->i)
+        s->i = s->i ? 2*s->i : BUFSZ;
+      s->u.buf = realloc(s->u.buf, s->i);
+    }
+    memcpy(s->u.buf + s->e, buf, len);
+    s->e += len;
+    if(s->more)
+      s->more = 1;
+  }
+
+  if(s->at < 0) {
+    // enough of it to tell the byte order by; two bytes of which neither
+    // is NUL and the first ASCII are UTF-8, so a short document such as
+    // {} is complete without waiting for more.
+    const unsigned char *us = (const unsigned char*) s->u.s;
+    if(s->e < 4 && s->more
+       && (s->e < 2 || !us[0] || !us[1] || us[0] >= 0x80))
+      return;
+    s->f = detect_byte_order(s->u.s, s->e, &bom);
+    s->at = s->b = bom;
+    again = 1;
+  }
+  // the character read when there was none is read again.
+  if(again && s->c < 0) {
+    s->b = s->at;
+    joqe_lex_source_read(s);
+  }
+}
@@ -25,6 +25,9 @@ typedef struct joqe_lex_source
   int col;
   const char *name;
 
+  int at;   // where the character in c starts
+  int more; // input still to come, -1 when read ran out waiting for it
+
   int (*read)(struct joqe_lex_source*);
   void (*destroy)(struct joqe_lex_source*);
 }
@@ -35,6 +38,14 @@ joqe_lex_source joqe_lex_source_file(const char *path);
 joqe_lex_source joqe_lex_source_string(const char *s);
 joqe_lex_source joqe_lex_source_buffer(const char *buffer, int len);
 joqe_lex_source joqe_lex_source_stringarray(int i, char * const *ss);
+/* Input appended as it arrives, see joqe_lex_source_append. Reading
+   past what's there so far gives -1, as at the end, with more set to -1
+   until there's more or the input is ended. */
+joqe_lex_source joqe_lex_source_chunked();
+
+// len bytes to the end of a chunked source, buf 0 when there are no more.
+void            joqe_lex_source_append(joqe_lex_source *s,
+                                       const char *buf, int len);
 
 int             joqe_lex_source_push (joqe_lex_source *s,
                                       uint32_t codepoint);
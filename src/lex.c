@@ -114,6 +114,9 @@ string(lexparam l, int delimiter)
     if(c == delimiter)
     {
       consume(l);
+      if(l.builder->short_strings
+         && joqe_build_shortstring(l.builder, l.yylval->inl))
+        return SHORTSTRING;
       if(!(l.yylval->string = joqe_build_closestring(l.builder))) {
         l.yylval->integer = INVALID_OVERLONG;
         return INVALID_STRING;
@@ -0,0 +1,500 @@
+#include "match.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+const char*
+joqe_strstr(const char *h, size_t len, const char *n, size_t nlen)
+{
+  size_t i = 0, last;
+  if(!nlen)
+    return h;
+  if(nlen > len)
+    return 0;
+  if(nlen == 1)
+    return memchr(h, n[0], len);
+
+  last = len - nlen; // the last position the needle may start at
+#ifdef __SSE2__
+  __m128i first = _mm_set1_epi8(n[0]), second = _mm_set1_epi8(n[1]);
+  // both loads stay within the haystack, as the needle is 2 or longer.
+  for(; i + 16 <= last + 1; i += 16) {
+    __m128i a = _mm_loadu_si128((const __m128i*)(h + i)),
+            b = _mm_loadu_si128((const __m128i*)(h + i + 1));
+    unsigned mask = _mm_movemask_epi8(
+      _mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, second)));
+    for(; mask; mask &= mask - 1) {
+      size_t at = i + __builtin_ctz(mask);
+      if(!memcmp(h + at + 2, n + 2, nlen - 2))
+        return h + at;
+    }
+  }
+#endif
+  for(; i <= last; ++i)
+    if(h[i] == n[0] && h[i+1] == n[1] && !memcmp(h + i + 2, n + 2, nlen - 2))
+      return h + i;
+  return 0;
+}
+
+// --regular expressions--
+
+#define DSTATE_LIMIT 512
+
+enum {
+  ns_byte,  // consumes a byte of the set
+  ns_split, // to both out and out1
+  ns_jump,
+  ns_bol,   // passes at the start of the string only
+  ns_eol,   // passes at the end of the string only
+  ns_match
+};
+
+typedef struct {
+  int      type;
+  int      out, out1;
+  uint32_t set[8];
+} nstate;
+
+typedef struct dstate {
+  struct dstate *next[256]; // null until taken the first time
+  int            match;     // a match was found
+  int            match_end; // a match if the string ends here
+  uint64_t       hash;
+  uint64_t       set[];     // the NFA states
+} dstate;
+
+struct joqe_regex {
+  char      *pattern;
+  int        valid;
+
+  nstate    *ns;
+  int        count, size;
+  int        start;
+
+  int        words;    // per NFA state set
+  uint64_t  *restart;  // the start, as reached past the first byte
+  uint64_t  *scratch;
+  int       *stack;
+
+  dstate    *initial;
+  dstate   **table;    // open addressing on the set hash
+  int        dcount;
+  uint64_t   flushes;
+};
+
+// --pattern to NFA--
+
+typedef struct {
+  joqe_regex *re;
+  const char *p;
+  int         error;
+} parser;
+
+// fragments have a single jump state at the end, out to be patched.
+typedef struct { int start, end; } frag;
+
+static frag parse_alt (parser *p);
+
+static int
+state(parser *p, int type)
+{
+  joqe_regex *re = p->re;
+  if(re->count == re->size) {
+    re->size = re->size ? 2*re->size : 16;
+    re->ns = realloc(re->ns, sizeof(*re->ns) * re->size);
+  }
+  nstate s = {type, -1, -1};
+  re->ns[re->count] = s;
+  return re->count++;
+}
+
+static frag
+single(parser *p, int type)
+{
+  frag f = {state(p, type), state(p, ns_jump)};
+  p->re->ns[f.start].out = f.end;
+  return f;
+}
+
+static void
+set_add(uint32_t *set, int c)
+{
+  set[c >> 5] |= 1u << (c & 31);
+}
+
+static void
+set_range(uint32_t *set, int from, int to)
+{
+  for(int c = from; c <= to; ++c)
+    set_add(set, c);
+}
+
+// the class of an escape, 0 if it's a plain character.
+static int
+escape_class(uint32_t *set, char e)
+{
+  uint32_t x[8] = {};
+  int negate = e == 'D' || e == 'W' || e == 'S';
+  switch(e) {
+    case 'd': case 'D':
+      set_range(x, '0', '9');
+      break;
+    case 'w': case 'W':
+      set_range(x, '0', '9');
+      set_range(x, 'a', 'z');
+      set_range(x, 'A', 'Z');
+      set_add(x, '_');
+      break;
+    case 's': case 'S':
+      set_range(x, '\t', '\r');
+      set_add(x, ' ');
+      break;
+    default:
+      return 0;
+  }
+  for(int i = 0; i < 8; ++i)
+    set[i] |= negate ? ~x[i] : x[i];
+  return 1;
+}
+
+static int
+escape_char(char e)
+{
+  switch(e) {
+    case 'n': return '\n';
+    case 't': return '\t';
+    case 'r': return '\r';
+    default:  return (unsigned char)e;
+  }
+}
+
+static void
+parse_class(parser *p, uint32_t *set)
+{
+  int negate = 0, first = 1;
+  if(*p->p == '^') {
+    negate = 1;
+    p->p++;
+  }
+  // a ']' first is taken as is.
+  while(*p->p && (*p->p != ']' || first)) {
+    int c = (unsigned char)*p->p++;
+    first = 0;
+    if(c == '\\') {
+      if(!*p->p)
+        break;
+      if(escape_class(set, *p->p++))
+        continue;
+      c = escape_char(p->p[-1]);
+    }
+    if(*p->p == '-' && p->p[1] && p->p[1] != ']') {
+      int to = (unsigned char)p->p[1];
+      p->p += 2;
+      if(to == '\\') {
+        if(!*p->p)
+          break;
+        to = escape_char(*p->p++);
+      }
+      if(to < c)
+        p->error = 1;
+      set_range(set, c, to);
+    } else {
+      set_add(set, c);
+    }
+  }
+  if(*p->p != ']') {
+    p->error = 1;
+    return;
+  }
+  p->p++;
+  if(negate)
+    for(int i = 0; i < 8; ++i)
+      set[i] = ~set[i];
+}
+
+static frag
+parse_atom(parser *p)
+{
+  frag f;
+  char c = *p->p++;
+  switch(c) {
+    case '(':
+      f = parse_alt(p);
+      if(*p->p != ')')
+        p->error = 1;
+      else
+        p->p++;
+      return f;
+    case '^':
+      return single(p, ns_bol);
+    case '$':
+      return single(p, ns_eol);
+    case '*': case '+': case '?': case ')':
+      p->error = 1;
+      return single(p, ns_jump);
+  }
+
+  f = single(p, ns_byte);
+  uint32_t *set = p->re->ns[f.start].set;
+  if(c == '.') {
+    memset(set, 0xff, sizeof(uint32_t) * 8);
+  } else if(c == '[') {
+    parse_class(p, set);
+  } else if(c == '\\') {
+    if(!*p->p)
+      p->error = 1;
+    else if(!escape_class(set, *p->p++))
+      set_add(set, escape_char(p->p[-1]));
+  } else {
+    set_add(set, (unsigned char)c);
+  }
+  return f;
+}
+
+static frag
+parse_repeat(parser *p)
+{
+  frag a = parse_atom(p);
+  char q;
+  while((q = *p->p) == '*' || q == '+' || q == '?') {
+    p->p++;
+    int s = state(p, ns_split), e = state(p, ns_jump);
+    nstate *ns = p->re->ns;
+    ns[s].out = a.start;
+    ns[s].out1 = e;
+    ns[a.end].out = q == '?' ? e : s;
+    a.start = q == '+' ? a.start : s;
+    a.end = e;
+  }
+  return a;
+}
+
+static frag
+parse_concat(parser *p)
+{
+  frag f = single(p, ns_jump);
+  f.start = f.end;
+  while(*p->p && *p->p != '|' && *p->p != ')' && !p->error) {
+    frag b = parse_repeat(p);
+    p->re->ns[f.end].out = b.start;
+    f.end = b.end;
+  }
+  return f;
+}
+
+static frag
+parse_alt(parser *p)
+{
+  frag a = parse_concat(p);
+  while(*p->p == '|' && !p->error) {
+    p->p++;
+    frag b = parse_concat(p);
+    int s = state(p, ns_split), e = state(p, ns_jump);
+    nstate *ns = p->re->ns;
+    ns[s].out = a.start;
+    ns[s].out1 = b.start;
+    ns[a.end].out = e;
+    ns[b.end].out = e;
+    a.start = s;
+    a.end = e;
+  }
+  return a;
+}
+
+// --NFA to DFA--
+
+static void
+closure(joqe_regex *re, uint64_t *set, int from, int bol, int eol)
+{
+  int top = 0;
+  re->stack[top++] = from;
+  while(top) {
+    int i = re->stack[--top];
+    if(i < 0 || set[i >> 6] & (UINT64_C(1) << (i & 63)))
+      continue;
+    set[i >> 6] |= UINT64_C(1) << (i & 63);
+    nstate *s = &re->ns[i];
+    switch(s->type) {
+      case ns_split:
+        re->stack[top++] = s->out1;
+        /* fall through */
+      case ns_jump:
+        re->stack[top++] = s->out;
+        break;
+      case ns_bol:
+        if(bol)
+          re->stack[top++] = s->out;
+        break;
+      case ns_eol:
+        if(eol)
+          re->stack[top++] = s->out;
+        break;
+    }
+  }
+}
+
+static int
+has_match(joqe_regex *re, uint64_t *set)
+{
+  for(int i = 0; i < re->count; ++i)
+    if(re->ns[i].type == ns_match && set[i >> 6] & (UINT64_C(1) << (i & 63)))
+      return 1;
+  return 0;
+}
+
+static uint64_t
+set_hash(joqe_regex *re, uint64_t *set)
+{
+  uint64_t h = 0xcbf29ce484222325;
+  for(int i = 0; i < re->words; ++i)
+    h = (h ^ set[i]) * 0x100000001b3;
+  return h;
+}
+
+static void
+flush(joqe_regex *re)
+{
+  for(int i = 0; i < 2*DSTATE_LIMIT; ++i) {
+    free(re->table[i]);
+    re->table[i] = 0;
+  }
+  re->dcount = 0;
+  re->initial = 0;
+  re->flushes++;
+}
+
+// the DFA state of the set, made if it's not known.
+static dstate*
+dfa_state(joqe_regex *re, uint64_t *set)
+{
+  size_t bytes = sizeof(uint64_t) * re->words;
+  uint64_t h = set_hash(re, set);
+  int i = h & (2*DSTATE_LIMIT - 1);
+  dstate *d;
+
+  while((d = re->table[i])) {
+    if(d->hash == h && !memcmp(d->set, set, bytes))
+      return d;
+    i = (i + 1) & (2*DSTATE_LIMIT - 1);
+  }
+
+  if(re->dcount == DSTATE_LIMIT) {
+    // too many states, start over rather than grow without bounds.
+    flush(re);
+    return dfa_state(re, set);
+  }
+
+  d = calloc(1, sizeof(*d) + bytes);
+  d->hash = h;
+  memcpy(d->set, set, bytes);
+  d->match = has_match(re, set);
+  if(!d->match) {
+    memset(re->scratch, 0, bytes);
+    for(int k = 0; k < re->count; ++k)
+      if(re->ns[k].type == ns_eol && set[k >> 6] & (UINT64_C(1) << (k & 63)))
+        closure(re, re->scratch, k, 0, 1);
+    d->match_end = has_match(re, re->scratch);
+  }
+  re->table[i] = d;
+  re->dcount++;
+  return d;
+}
+
+static dstate*
+step(joqe_regex *re, dstate *d, int c)
+{
+  uint64_t *set = alloca(sizeof(uint64_t) * re->words);
+  memcpy(set, re->restart, sizeof(uint64_t) * re->words);
+  for(int i = 0; i < re->count; ++i) {
+    nstate *s = &re->ns[i];
+    if(s->type == ns_byte && d->set[i >> 6] & (UINT64_C(1) << (i & 63))
+       && s->set[c >> 5] & (1u << (c & 31)))
+      closure(re, set, s->out, 0, 0);
+  }
+
+  uint64_t flushes = re->flushes;
+  dstate *x = dfa_state(re, set);
+  // d is gone if the states were flushed.
+  if(flushes == re->flushes)
+    d->next[c] = x;
+  return x;
+}
+
+joqe_regex*
+joqe_regex_compile(const char *pattern)
+{
+  joqe_regex *re = calloc(1, sizeof(*re));
+  parser p = {re, pattern};
+
+  re->pattern = strdup(pattern);
+  frag f = parse_alt(&p);
+  if(*p.p)
+    p.error = 1;
+  int m = state(&p, ns_match);
+  re->ns[f.end].out = m;
+  re->start = f.start;
+  re->valid = !p.error;
+
+  re->words = (re->count + 63) / 64;
+  re->restart = calloc(re->words, sizeof(uint64_t));
+  re->scratch = calloc(re->words, sizeof(uint64_t));
+  // a state is pushed at most once per state that reaches it.
+  re->stack = malloc(sizeof(int) * (2*re->count + 1));
+  re->table = calloc(2*DSTATE_LIMIT, sizeof(dstate*));
+  closure(re, re->restart, re->start, 0, 0);
+  return re;
+}
+
+void
+joqe_regex_destroy(joqe_regex *re)
+{
+  if(!re)
+    return;
+  flush(re);
+  free(re->table);
+  free(re->stack);
+  free(re->scratch);
+  free(re->restart);
+  free(re->ns);
+  free(re->pattern);
+  free(re);
+}
+
+int
+joqe_regex_valid(joqe_regex *re)
+{
+  return re->valid;
+}
+
+const char*
+joqe_regex_pattern(joqe_regex *re)
+{
+  return re->pattern;
+}
+
+int
+joqe_regex_match(joqe_regex *re, const char *s, size_t len)
+{
+  dstate *d;
+  if(!re->valid)
+    return 0;
+
+  if(!(d = re->initial)) {
+    uint64_t *set = alloca(sizeof(uint64_t) * re->words);
+    memset(set, 0, sizeof(uint64_t) * re->words);
+    closure(re, set, re->start, 1, 0);
+    d = dfa_state(re, set);
+    re->initial = d;
+  }
+
+  for(size_t i = 0; i < len && !d->match; ++i) {
+    unsigned char c = s[i];
+    d = d->next[c] ? d->next[c] : step(re, d, c);
+  }
+  return d->match || d->match_end;
+}
@@ -0,0 +1,26 @@
+#ifndef __JOQE_MATCH_H__
+#define __JOQE_MATCH_H__
+
+#include <stddef.h>
+
+/* Finds needle in haystack, both of the given lengths. Candidates are
+   found 16 bytes at a time on the first two bytes of the needle, where
+   SSE2 is available, before the rest is compared. */
+const char*  joqe_strstr (const char *haystack, size_t len,
+                          const char *needle, size_t nlen);
+
+/* Regular expressions, matched by a DFA built lazily from the pattern's
+   NFA; states and transitions are kept between matches. Patterns are
+   bytes: literals, '.', classes ([a-z], [^...]), the escapes \d \w \s
+   (and \D \W \S), '*', '+', '?', '|', groups, and the anchors '^' and
+   '$'. A match anywhere in the string counts. */
+typedef struct joqe_regex joqe_regex;
+
+// never null, an invalid pattern gives a regex that isn't valid.
+joqe_regex*  joqe_regex_compile (const char *pattern);
+void         joqe_regex_destroy (joqe_regex *re);
+int          joqe_regex_valid   (joqe_regex *re);
+const char*  joqe_regex_pattern (joqe_regex *re);
+int          joqe_regex_match   (joqe_regex *re, const char *s, size_t len);
+
+#endif /* idempotent include guard */
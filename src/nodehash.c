@@ -0,0 +1,341 @@
+#include "nodehash.h"
+#include "ast.h"
+#include "arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define FNVOFFSET 0x811c9dc5u
+#define FNVPRIME  0x01000193u
+
+static uint32_t
+fnv1a(uint32_t h, const char *s)
+{
+  for(; *s; ++s) {
+    h ^= (unsigned char)*s;
+    h *= FNVPRIME;
+  }
+  return h;
+}
+
+static uint32_t
+mix64(uint64_t k)
+{
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdull;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53ull;
+  k ^= k >> 33;
+  return (uint32_t)k;
+}
+
+static uint32_t
+hash_double(double d)
+{
+  uint64_t bits;
+  if(d == 0)
+    d = 0; // -0 == 0
+  memcpy(&bits, &d, sizeof(bits));
+  return mix64(bits);
+}
+
+// subtree hashes, as kept for a document list.
+#define SUBTREE_KNOWN (INT64_C(1) << 32)
+#define SUBTREE_NAN   (INT64_C(1) << 33)
+
+/* Hashes of lists without a sentinel to keep them in are kept on the
+   side, in a table of the thread taken up when the first is hashed. Only
+   lists in the arena in use are, which go with its next reset, as does
+   the table: the arena adopts it. */
+typedef struct {
+  joqe_nodels  *ls;
+  int64_t       x;
+} subtree_slot;
+
+typedef struct {
+  subtree_slot *slot;
+  uint32_t      mask, count;
+} subtree_table;
+
+static __thread subtree_table *table;
+static __thread uint32_t       table_generation;
+
+static void
+table_free(void *t)
+{
+  free(((subtree_table*)t)->slot);
+  free(t);
+}
+
+static uint32_t
+table_hash(joqe_nodels *ls)
+{
+  return (uint32_t)((uintptr_t)ls * 0x9e3779b97f4a7c15ull >> 32);
+}
+
+// the slot of ls, or where it goes, 0 if nothing may be kept for it.
+static subtree_slot*
+table_slot(joqe_nodels *ls, int add)
+{
+  subtree_table *t = table;
+  uint32_t at, generation = joqe_arena_generation();
+  if(t && table_generation != generation)
+    t = table = 0; // released along with an arena.
+  if(!joqe_arena_owns(ls))
+    return 0;
+  if(!t) {
+    if(!add)
+      return 0;
+    t = calloc(1, sizeof(*t));
+    if(!joqe_arena_adopt(t, table_free)) {
+      free(t);
+      return 0;
+    }
+    table = t;
+    table_generation = generation;
+  }
+  if(add && 2*(t->count + 1) > t->mask + 1) {
+    subtree_slot *old = t->slot;
+    uint32_t size = old ? 2*(t->mask + 1) : 64;
+    t->slot = calloc(size, sizeof(*t->slot));
+    t->mask = size - 1;
+    for(uint32_t k = 0; old && k < size/2; ++k) {
+      if(!old[k].ls)
+        continue;
+      for(at = table_hash(old[k].ls) & t->mask; t->slot[at].ls;)
+        at = (at + 1) & t->mask;
+      t->slot[at] = old[k];
+    }
+    free(old);
+  }
+  if(!t->slot)
+    return 0;
+  for(at = table_hash(ls) & t->mask; t->slot[at].ls; at = (at + 1) & t->mask)
+    if(t->slot[at].ls == ls)
+      return &t->slot[at];
+  if(!add)
+    return 0;
+  t->count++;
+  t->slot[at].ls = ls;
+  return &t->slot[at];
+}
+
+// where the hash of a document subtree is kept, if n is one and it's
+// kept at all. add takes up a slot for one not kept yet.
+static int64_t*
+subtree_cache(joqe_node *n, int add)
+{
+  subtree_slot *s;
+  if(!JOQE_TYPE_VIEW(n->type))
+    return 0;
+  if(JOQE_TYPE_PACKED(n->type))
+    return &n->u.p->hash;
+  if(!n->u.ls)
+    return 0;
+  if(n->u.ls->n.type == joqe_type_ref_cnt)
+    return &n->u.ls->n.u.i;
+  return (s = table_slot(n->u.ls, add)) ? &s->x : 0;
+}
+
+// the hash kept for n, 0 if it isn't known yet.
+static int64_t
+subtree_known(joqe_node *n)
+{
+  int64_t x, *cache = subtree_cache(n, 0);
+  if(cache && ((x = __atomic_load_n(cache, __ATOMIC_RELAXED))
+               & SUBTREE_KNOWN))
+    return x;
+  return 0;
+}
+
+// subtrees left to hash, kept inline while the nesting is shallow.
+#define SUBTREE_INLINE 16
+
+typedef struct {
+  joqe_node    *n;
+  joqe_members  it;
+  uint64_t      h, sum;
+  int           nan;
+} subtree_frame;
+
+// m, the hash of member i, taken into that of the subtree of f. Arrays
+// combine their members in order, objects regardless of order.
+static void
+subtree_add(subtree_frame *f, joqe_node *i, int64_t m)
+{
+  f->nan |= !!(m & SUBTREE_NAN);
+  if(JOQE_TYPE_VALUE(f->n->type) == joqe_type_none_array)
+    f->h = mix64(f->h * FNVPRIME + (uint32_t)m);
+  else
+    f->sum += mix64((uint64_t)fnv1a(FNVOFFSET, joqe_member_key(i)) << 32
+                    | (uint32_t)m);
+}
+
+static int64_t
+subtree(joqe_node *n)
+{
+  subtree_frame inl[SUBTREE_INLINE], *st = inl, *f;
+  int sp = 0, cap = SUBTREE_INLINE;
+  int64_t x, *cache;
+  joqe_node *i;
+
+  if((x = subtree_known(n)))
+    return x;
+
+  // members before the subtrees they're in, walked with a stack of its
+  // own rather than recursing as documents may nest deep.
+  st[sp++] = (subtree_frame){n, joqe_members_of(n), JOQE_TYPE_VALUE(n->type)};
+  for(;;) {
+    f = &st[sp-1];
+    if((i = joqe_members_next(&f->it))) {
+      switch(JOQE_TYPE_VALUE(i->type)) {
+        case joqe_type_none_object:
+        case joqe_type_none_array:
+          if((x = subtree_known(i)))
+            break;
+          if(sp == cap) {
+            cap *= 2;
+            if(st == inl) {
+              st = malloc(sizeof(*st) * cap);
+              memcpy(st, inl, sizeof(inl));
+            } else {
+              st = realloc(st, sizeof(*st) * cap);
+            }
+          }
+          st[sp++] = (subtree_frame){
+            i, joqe_members_of(i), JOQE_TYPE_VALUE(i->type)
+          };
+          continue;
+        case joqe_type_none_real:
+          if(isnan(i->u.d)) {
+            x = SUBTREE_KNOWN|SUBTREE_NAN;
+            break;
+          }
+          /* fall through */
+        default:
+          x = SUBTREE_KNOWN|joqe_node_hash(i);
+      }
+      subtree_add(f, i, x);
+      continue;
+    }
+
+    x = SUBTREE_KNOWN | (f->nan ? SUBTREE_NAN : mix64(f->h ^ f->sum));
+    // racing threads store the same value.
+    if((cache = subtree_cache(f->n, 1)))
+      __atomic_store_n(cache, x, __ATOMIC_RELAXED);
+    if(!--sp)
+      break;
+    subtree_add(&st[sp-1], f->n, x);
+  }
+
+  if(st != inl)
+    free(st);
+  return x;
+}
+
+int
+joqe_node_hashable(joqe_node *n)
+{
+  switch(JOQE_TYPE_VALUE(n->type)) {
+    case joqe_type_none_true:
+    case joqe_type_none_false:
+    case joqe_type_none_null:
+    case joqe_type_none_string:
+    case joqe_type_none_stringls:
+    case joqe_type_none_integer:
+    case joqe_type_none_real:
+      return 1;
+    case joqe_type_none_object:
+    case joqe_type_none_array:
+      return !(subtree(n) & SUBTREE_NAN);
+    default:
+      return 0;
+  }
+}
+
+uint32_t
+joqe_node_hash(joqe_node *n)
+{
+  joqe_type t = JOQE_TYPE_VALUE(n->type);
+  switch(t) {
+    case joqe_type_none_string:
+      return fnv1a(FNVOFFSET, joqe_node_string(n));
+    case joqe_type_none_stringls: {
+      // a string split in fragments hashes as the whole string.
+      uint32_t h = FNVOFFSET;
+      joqe_nodels *i;
+      if((i = n->u.ls)) do {
+        if(i->n.type != joqe_type_ref_cnt)
+          h = fnv1a(h, joqe_node_string(&i->n));
+      } while((i = (joqe_nodels*)i->ll.n) != n->u.ls);
+      return h;
+    }
+    // integers compare equal to reals of the same value
+    case joqe_type_none_integer:
+      return hash_double((double)n->u.i);
+    case joqe_type_none_real:
+      return hash_double(n->u.d);
+    case joqe_type_none_object:
+    case joqe_type_none_array:
+      return (uint32_t)subtree(n);
+    default:
+      return mix64(t);
+  }
+}
+
+// --set--
+
+joqe_nodeset
+joqe_nodeset_create(int expected)
+{
+  joqe_nodeset set = {};
+  uint32_t size = 16;
+  while(size < 2u * expected)
+    size <<= 1;
+  set.slots = calloc(size, sizeof(joqe_nodeset_slot));
+  set.mask = size - 1;
+  return set;
+}
+
+// linear probing, the set is sized up front so it never fills up.
+void
+joqe_nodeset_add(joqe_nodeset *set, joqe_node *n)
+{
+  if(!joqe_node_hashable(n))
+    return;
+
+  uint32_t h = joqe_node_hash(n), i;
+  for(i = h & set->mask; set->slots[i].n; i = (i+1) & set->mask) {
+    joqe_nodeset_slot *s = &set->slots[i];
+    if(s->hash == h && joqe_ast_compare_nodes(joqe_ast_comp_eq, s->n, n))
+      return; // already represented
+  }
+  set->slots[i].hash = h;
+  set->slots[i].n = n;
+  set->count++;
+}
+
+joqe_node*
+joqe_nodeset_find(joqe_nodeset *set, joqe_node *n)
+{
+  if(!joqe_node_hashable(n))
+    return 0;
+
+  uint32_t h = joqe_node_hash(n), i;
+  for(i = h & set->mask; set->slots[i].n; i = (i+1) & set->mask) {
+    joqe_nodeset_slot *s = &set->slots[i];
+    if(s->hash == h && joqe_ast_compare_nodes(joqe_ast_comp_eq, n, s->n))
+      return s->n;
+  }
+  return 0;
+}
+
+void
+joqe_nodeset_destroy(joqe_nodeset *set)
+{
+  free(set->slots);
+  set->slots = 0;
+  set->mask = 0;
+  set->count = 0;
+}
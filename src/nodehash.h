@@ -0,0 +1,36 @@
+#ifndef __JOQE_NODEHASH_H__
+#define __JOQE_NODEHASH_H__
+
+#include "json.h"
+
+/* Hashing of nodes, consistent with equality as defined by
+   joqe_ast_compare_nodes: nodes that compare equal hash equal. This
+   doesn't hold for NaN, which compares equal to every number, callers
+   need to handle it separately. Objects and arrays hash by structure,
+   combining the hashes of their members; they aren't hashable if there's
+   a NaN anywhere in them. The hash of a document subtree is computed at
+   most once: it's kept in the row or the sentinel of its list if it has
+   one, or on the side while the arena in use holds the list. */
+
+int       joqe_node_hashable (joqe_node *n);
+uint32_t  joqe_node_hash     (joqe_node *n);
+
+typedef struct {
+  uint32_t      hash;
+  joqe_node    *n;
+} joqe_nodeset_slot;
+
+typedef struct {
+  joqe_nodeset_slot  *slots;
+  uint32_t            mask;
+  int                 count;
+} joqe_nodeset;
+
+joqe_nodeset  joqe_nodeset_create  (int         expected);
+void          joqe_nodeset_add     (joqe_nodeset *set,
+                                    joqe_node    *n);
+joqe_node*    joqe_nodeset_find    (joqe_nodeset *set,
+                                    joqe_node    *n);
+void          joqe_nodeset_destroy (joqe_nodeset *set);
+
+#endif /* idempotent include guard */
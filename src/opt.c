@@ -0,0 +1,538 @@
+#include "opt.h"
+#include "lex-source.h"
+#include "build.h"
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define IMPLODE 0, 0, 0
+
+/* Expressions are evaluated either for their value (r set) or as a test
+   of the current node (r null), and literals mean different things in
+   the two modes; in a test a string or integer literal matches the key
+   or index of the node, so only true/false/null and reals are constant
+   there. Every rewrite below must therefore know which mode its
+   expression is evaluated in. */
+
+typedef struct {
+  joqe_build *build;
+  int         debug;
+  int         count;
+} opt;
+
+static const char*
+describe(joqe_ast_expr *e, char *buf, int sz)
+{
+  switch(joqe_ast_expr_kind(e)) {
+    case joqe_ast_kind_fix_value:
+      return e->u.i > 0 ? "true" : e->u.i < 0 ? "null" : "false";
+    case joqe_ast_kind_string_value:
+      snprintf(buf, sz, "'%s'", e->u.s);
+      return buf;
+    case joqe_ast_kind_integer_value:
+      snprintf(buf, sz, "%" PRId64, e->u.i);
+      return buf;
+    case joqe_ast_kind_real_value:
+      snprintf(buf, sz, "%g", e->u.d);
+      return buf;
+    default:
+      return "expression";
+  }
+}
+
+static void
+report(opt *o, joqe_ast_expr *e, const char *msg, ...)
+{
+  o->count++;
+  if(!o->debug)
+    return;
+
+  char buf[64];
+  va_list ap;
+  va_start(ap, msg);
+
+  fprintf(stderr, "opt: ");
+  vfprintf(stderr, msg, ap);
+  if(e)
+    fprintf(stderr, " -> %s", describe(e, buf, sizeof(buf)));
+  fprintf(stderr, "\n");
+
+  va_end(ap);
+}
+
+// --rewriting--
+
+static void
+discard(joqe_ast_expr *e)
+{
+  e->evaluate(e, IMPLODE);
+  free(e);
+}
+
+// replace e (and its subtree) with a freshly built literal
+static void
+replace(joqe_ast_expr *e, joqe_ast_expr x)
+{
+  e->evaluate(e, IMPLODE);
+  *e = x;
+}
+
+// replace a binary expression with one of its operands
+static void
+promote(joqe_ast_expr *e, joqe_ast_expr *keep)
+{
+  joqe_ast_expr *drop = keep == e->u.b.l ? e->u.b.r : e->u.b.l;
+  discard(drop);
+  *e = *keep;
+  free(keep);
+}
+
+static joqe_ast_expr
+literal(joqe_node rx)
+{
+  if(JOQE_TYPE_VALUE(rx.type) == joqe_type_none_integer) {
+    joqe_ast_expr e = ast.integer_value(0);
+    e.u.i = rx.u.i;
+    return e;
+  }
+  return ast.real_value(rx.u.d);
+}
+
+// --constants--
+
+static int
+test_const(joqe_ast_expr *e, int *v)
+{
+  switch(joqe_ast_expr_kind(e)) {
+    case joqe_ast_kind_fix_value:
+      *v = e->u.i > 0;
+      return 1;
+    case joqe_ast_kind_real_value:
+      *v = 0;
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+static int
+value_const(joqe_ast_expr *e, int *v)
+{
+  switch(joqe_ast_expr_kind(e)) {
+    case joqe_ast_kind_fix_value:     *v = e->u.i > 0; return 1;
+    case joqe_ast_kind_string_value:  *v = !!*e->u.s; return 1;
+    case joqe_ast_kind_stringls_value:*v = !!e->u.n.u.ls; return 1;
+    case joqe_ast_kind_integer_value: *v = e->u.i != 0; return 1;
+    case joqe_ast_kind_real_value:    *v = 0; return 1;
+    default:
+      return 0;
+  }
+}
+
+static int
+value_node(joqe_ast_expr *e, joqe_node *n)
+{
+  joqe_node x = {};
+  switch(joqe_ast_expr_kind(e)) {
+    case joqe_ast_kind_fix_value:
+      x.type = e->u.i > 0 ? joqe_type_none_true
+             : e->u.i < 0 ? joqe_type_none_null
+             : joqe_type_none_false;
+      x.u.i = e->u.i;
+      break;
+    case joqe_ast_kind_string_value:
+      x.type = joqe_type_none_string;
+      x.u.s = e->u.s;
+      break;
+    case joqe_ast_kind_stringls_value:
+      x = e->u.n;
+      break;
+    case joqe_ast_kind_integer_value:
+      x.type = joqe_type_none_integer;
+      x.u.i = e->u.i;
+      break;
+    case joqe_ast_kind_real_value:
+      x.type = joqe_type_none_real;
+      x.u.d = e->u.d;
+      break;
+    default:
+      return 0;
+  }
+  *n = x;
+  return 1;
+}
+
+// --passes--
+
+static void opt_expr(opt *o, joqe_ast_expr *e, int test);
+static void opt_construct(opt *o, joqe_ast_construct *cst);
+
+static void
+opt_path(opt *o, joqe_ast_path *p)
+{
+  for(; p; p = p->punion) {
+    joqe_ast_pathelem *i;
+    if((i = p->pes)) do {
+      switch(joqe_ast_pathelem_kind(i)) {
+        case joqe_ast_kind_pefilter:
+          opt_expr(o, &i->u.expr, 1);
+          break;
+        case joqe_ast_kind_pefunction: {
+          joqe_ast_paramls *pi;
+          if((pi = i->u.func.ps.ls)) do {
+            opt_expr(o, &pi->e, 0);
+          } while((pi = (joqe_ast_paramls*)pi->ll.n) != i->u.func.ps.ls);
+        } break;
+        default:;
+      }
+    } while((i = (joqe_ast_pathelem*)i->ll.n) != p->pes);
+  }
+}
+
+static void
+opt_bor(opt *o, joqe_ast_expr *e, int test)
+{
+  joqe_ast_expr *l = e->u.b.l, *r = e->u.b.r;
+  int v;
+
+  opt_expr(o, l, test);
+  opt_expr(o, r, test);
+
+  if(test ? test_const(l, &v) : value_const(l, &v)) {
+    promote(e, v ? l : r);
+    report(o, 0, "or with constant %s operand", v ? "true" : "false");
+  } else if(test && test_const(r, &v)) {
+    // operands are free of side effects, 'x or true' is always true.
+    promote(e, v ? r : l);
+    report(o, 0, "or with constant %s operand", v ? "true" : "false");
+  }
+}
+
+static void
+opt_band(opt *o, joqe_ast_expr *e, int test)
+{
+  joqe_ast_expr *l = e->u.b.l, *r = e->u.b.r;
+  int v;
+
+  // the left operand of 'and' is always a test
+  opt_expr(o, l, 1);
+  opt_expr(o, r, test);
+
+  if(test_const(l, &v)) {
+    if(v) {
+      promote(e, r);
+      report(o, 0, "and with constant true operand");
+    } else if(test) {
+      promote(e, l);
+      report(o, e, "and with constant false operand");
+    } else if(!value_const(r, &v)) {
+      // a false 'and' still produces an empty value, only the right
+      // operand is dead.
+      replace(r, ast.false_value);
+      report(o, 0, "removed unreachable operand of and");
+    }
+  } else if(test && test_const(r, &v)) {
+    promote(e, v ? l : r);
+    report(o, 0, "and with constant %s operand", v ? "true" : "false");
+  }
+}
+
+static void
+opt_stringls(opt *o, joqe_ast_expr *e)
+{
+  joqe_nodels *i, *end = e->u.n.u.ls;
+  joqe_build *b = o->build;
+  const char *s;
+  int fragments = 0;
+
+  if(!b || !end)
+    return;
+
+  if((i = end)) do {
+    if(i->n.type == joqe_type_ref_cnt)
+      continue;
+    if(JOQE_TYPE_VALUE(i->n.type) != joqe_type_none_string)
+      return;
+    fragments++;
+  } while((i = (joqe_nodels*)i->ll.n) != end);
+
+  if((i = end)) do {
+    if(i->n.type == joqe_type_ref_cnt)
+      continue;
+    for(s = i->n.u.s; *s; ++s) {
+      if(joqe_build_appendstring(b, *s)) {
+        joqe_build_cancelstring(b);
+        return;
+      }
+    }
+  } while((i = (joqe_nodels*)i->ll.n) != end);
+
+  if(!(s = joqe_build_closestring(b))) {
+    joqe_build_cancelstring(b);
+    return;
+  }
+  // an empty list of fragments is truthy, the empty string is not.
+  if(!*s)
+    return;
+
+  replace(e, ast.string_value(s));
+  report(o, e, "merged %d string fragments", fragments);
+}
+
+static void
+opt_expr(opt *o, joqe_ast_expr *e, int test)
+{
+  joqe_node a, b, rx;
+  int v;
+
+  switch(joqe_ast_expr_kind(e)) {
+    case joqe_ast_kind_stringls_value:
+      opt_stringls(o, e);
+      break;
+    case joqe_ast_kind_bor:
+      opt_bor(o, e, test);
+      break;
+    case joqe_ast_kind_band:
+      opt_band(o, e, test);
+      break;
+    case joqe_ast_kind_compare:
+      opt_expr(o, e->u.b.l, 0);
+      opt_expr(o, e->u.b.r, 0);
+      if(value_node(e->u.b.l, &a) && value_node(e->u.b.r, &b)) {
+        v = joqe_ast_compare_nodes(e->u.b.op, &a, &b);
+        replace(e, v ? ast.true_value : ast.false_value);
+        report(o, e, "constant comparison");
+      }
+      break;
+    case joqe_ast_kind_calc:
+      opt_expr(o, e->u.b.l, 0);
+      opt_expr(o, e->u.b.r, 0);
+      if(value_node(e->u.b.l, &a) && value_node(e->u.b.r, &b)
+         && joqe_ast_calc_nodes(e->u.b.op, &a, &b, &rx)) {
+        replace(e, literal(rx));
+        report(o, e, "constant arithmetic");
+      }
+      break;
+    case joqe_ast_kind_negative:
+    case joqe_ast_kind_positive: {
+      int mul = joqe_ast_expr_kind(e) == joqe_ast_kind_negative ? -1 : 1;
+      opt_expr(o, e->u.e, 0);
+      if(value_node(e->u.e, &a) && joqe_ast_sign_node(mul, &a, &rx)) {
+        replace(e, literal(rx));
+        report(o, e, "constant sign");
+      }
+    } break;
+    case joqe_ast_kind_not:
+      opt_expr(o, e->u.e, 1);
+      if(test_const(e->u.e, &v)) {
+        replace(e, v ? ast.false_value : ast.true_value);
+        report(o, e, "constant negation");
+      } else if(test && joqe_ast_expr_kind(e->u.e) == joqe_ast_kind_not) {
+        // in a test 'not not x' is x, as a value it's x as a boolean.
+        joqe_ast_expr *inner = e->u.e, *x = inner->u.e;
+        *e = *x;
+        free(x);
+        free(inner);
+        report(o, 0, "removed double negation");
+      }
+      break;
+    case joqe_ast_kind_context:
+      opt_construct(o, &e->u.c.ctx);
+      opt_expr(o, e->u.c.e, test);
+      break;
+    case joqe_ast_kind_path:
+      opt_path(o, &e->u.path);
+      break;
+    default:;
+  }
+}
+
+static void
+opt_construct(opt *o, joqe_ast_construct *cst)
+{
+  switch(joqe_ast_construct_kind(cst)) {
+    case joqe_ast_kind_expr_construct:
+      opt_expr(o, cst->u.expr, 0);
+      break;
+    case joqe_ast_kind_object_construct: {
+      joqe_ast_objectls *i;
+      if((i = cst->u.object.ls)) do {
+        opt_construct(o, &i->en.v);
+      } while((i = (joqe_ast_objectls*)i->ll.n) != cst->u.object.ls);
+    } break;
+    case joqe_ast_kind_array_construct: {
+      joqe_ast_arrayls *i;
+      if((i = cst->u.array.ls)) do {
+        opt_construct(o, &i->en.v);
+      } while((i = (joqe_ast_arrayls*)i->ll.n) != cst->u.array.ls);
+    } break;
+    case joqe_ast_kind_object_entry:
+      opt_construct(o, cst->u.ob.key);
+      opt_construct(o, cst->u.ob.value);
+      break;
+    case joqe_ast_kind_construct_context:
+      opt_construct(o, cst->u.ctx.context);
+      opt_construct(o, cst->u.ctx.construction);
+      break;
+    default:;
+  }
+}
+
+// --hoisting--
+
+static int
+literal_expr(joqe_ast_expr *e)
+{
+  int v;
+  return value_const(e, &v);
+}
+
+// does e give the same result for every child tested by a filter?
+static int
+invariant(joqe_ast_expr *e, int test)
+{
+  joqe_ast_path *p;
+  switch(joqe_ast_expr_kind(e)) {
+    case joqe_ast_kind_fix_value:
+    case joqe_ast_kind_real_value:
+      return 1;
+    case joqe_ast_kind_string_value:
+    case joqe_ast_kind_stringls_value:
+    case joqe_ast_kind_integer_value:
+      return !test;
+    case joqe_ast_kind_bor:
+      return invariant(e->u.b.l, test) && invariant(e->u.b.r, test);
+    case joqe_ast_kind_band:
+      return invariant(e->u.b.l, 1) && invariant(e->u.b.r, test);
+    case joqe_ast_kind_compare:
+      return invariant(e->u.b.l, 0) && invariant(e->u.b.r, 0);
+    case joqe_ast_kind_calc:
+      return !test && invariant(e->u.b.l, 0) && invariant(e->u.b.r, 0);
+    case joqe_ast_kind_negative:
+    case joqe_ast_kind_positive:
+      return !test && invariant(e->u.e, 0);
+    case joqe_ast_kind_not:
+      return invariant(e->u.e, 1);
+    case joqe_ast_kind_path:
+      // anything below a context path is relative to the context.
+      for(p = &e->u.path; p; p = p->punion)
+        if(joqe_ast_path_kind(p) != joqe_ast_kind_context_path)
+          return 0;
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+static void hoist_expr(opt *o, joqe_ast_expr *e, int test,
+                       joqe_ast_pathelem *owner);
+
+static void
+hoist_path(opt *o, joqe_ast_path *p, joqe_ast_pathelem *owner)
+{
+  for(; p; p = p->punion) {
+    joqe_ast_pathelem *i;
+    if((i = p->pes)) do {
+      switch(joqe_ast_pathelem_kind(i)) {
+        case joqe_ast_kind_pefilter:
+          // nested filters see the same context, the outermost one owns
+          // anything hoisted.
+          hoist_expr(o, &i->u.expr, 1, owner ? owner : i);
+          break;
+        case joqe_ast_kind_pefunction: {
+          joqe_ast_paramls *pi;
+          if((pi = i->u.func.ps.ls)) do {
+            hoist_expr(o, &pi->e, 0, owner);
+          } while((pi = (joqe_ast_paramls*)pi->ll.n) != i->u.func.ps.ls);
+        } break;
+        default:;
+      }
+    } while((i = (joqe_ast_pathelem*)i->ll.n) != p->pes);
+  }
+}
+
+static void
+hoist_construct(opt *o, joqe_ast_construct *cst, joqe_ast_pathelem *owner)
+{
+  switch(joqe_ast_construct_kind(cst)) {
+    case joqe_ast_kind_expr_construct:
+      hoist_expr(o, cst->u.expr, 0, owner);
+      break;
+    case joqe_ast_kind_object_construct: {
+      joqe_ast_objectls *i;
+      if((i = cst->u.object.ls)) do {
+        hoist_construct(o, &i->en.v, owner);
+      } while((i = (joqe_ast_objectls*)i->ll.n) != cst->u.object.ls);
+    } break;
+    case joqe_ast_kind_array_construct: {
+      joqe_ast_arrayls *i;
+      if((i = cst->u.array.ls)) do {
+        hoist_construct(o, &i->en.v, owner);
+      } while((i = (joqe_ast_arrayls*)i->ll.n) != cst->u.array.ls);
+    } break;
+    case joqe_ast_kind_object_entry:
+      hoist_construct(o, cst->u.ob.key, owner);
+      hoist_construct(o, cst->u.ob.value, owner);
+      break;
+    case joqe_ast_kind_construct_context:
+      // the construction is evaluated with a new context.
+      hoist_construct(o, cst->u.ctx.context, owner);
+      hoist_construct(o, cst->u.ctx.construction, 0);
+      break;
+    default:;
+  }
+}
+
+static void
+hoist_expr(opt *o, joqe_ast_expr *e, int test, joqe_ast_pathelem *owner)
+{
+  if(owner && !literal_expr(e) && invariant(e, test)) {
+    *e = ast.hoisted(*e, owner);
+    report(o, 0, "hoisted context expression out of filter");
+    return;
+  }
+
+  switch(joqe_ast_expr_kind(e)) {
+    case joqe_ast_kind_bor:
+      hoist_expr(o, e->u.b.l, test, owner);
+      hoist_expr(o, e->u.b.r, test, owner);
+      break;
+    case joqe_ast_kind_band:
+      hoist_expr(o, e->u.b.l, 1, owner);
+      hoist_expr(o, e->u.b.r, test, owner);
+      break;
+    case joqe_ast_kind_compare:
+    case joqe_ast_kind_calc:
+      hoist_expr(o, e->u.b.l, 0, owner);
+      hoist_expr(o, e->u.b.r, 0, owner);
+      break;
+    case joqe_ast_kind_negative:
+    case joqe_ast_kind_positive:
+      hoist_expr(o, e->u.e, 0, owner);
+      break;
+    case joqe_ast_kind_not:
+      hoist_expr(o, e->u.e, 1, owner);
+      break;
+    case joqe_ast_kind_context:
+      hoist_construct(o, &e->u.c.ctx, owner);
+      hoist_expr(o, e->u.c.e, test, 0);
+      break;
+    case joqe_ast_kind_path:
+      hoist_path(o, &e->u.path, owner);
+      break;
+    default:;
+  }
+}
+
+int
+joqe_optimize(joqe_build *build, int debug)
+{
+  opt o = {build, debug};
+  if(build->root.construct) {
+    opt_construct(&o, &build->root);
+    hoist_construct(&o, &build->root, 0);
+  }
+  return o.count;
+}
@@ -0,0 +1,13 @@
+#ifndef __JOQE_OPT_H__
+#define __JOQE_OPT_H__
+
+#include "ast.h"
+
+struct joqe_build;
+
+/* Rewrite the expression tree of a successfully parsed build in place,
+   folding constant subexpressions. Returns the number of rewrites made,
+   each of which is reported on stderr if debug is set. */
+int joqe_optimize (struct joqe_build *build, int debug);
+
+#endif /* idempotent include guard */
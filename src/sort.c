@@ -0,0 +1,229 @@
+#include "sort.h"
+#include "ast.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define RADIX_BITS 8
+#define RADIX_SIZE (1 << RADIX_BITS)
+
+static int
+rank(joqe_node *n)
+{
+  switch(JOQE_TYPE_VALUE(n->type)) {
+    case joqe_type_none_null:     return 1;
+    case joqe_type_none_false:    return 2;
+    case joqe_type_none_true:     return 3;
+    case joqe_type_none_integer:
+    case joqe_type_none_real:     return 4;
+    case joqe_type_none_string:
+    case joqe_type_none_stringls: return 5;
+    case joqe_type_none_array:    return 6;
+    case joqe_type_none_object:   return 7;
+    default:                      return 0;
+  }
+}
+
+int
+joqe_sort_cmp(joqe_sortitem *a, joqe_sortitem *b)
+{
+  int ra = rank(&a->key), rb = rank(&b->key);
+  if(ra != rb)
+    return ra < rb ? -1 : 1;
+  if(ra == 4 || ra == 5) {
+    if(joqe_ast_compare_nodes(joqe_ast_comp_lt, &a->key, &b->key))
+      return -1;
+    if(joqe_ast_compare_nodes(joqe_ast_comp_gt, &a->key, &b->key))
+      return 1;
+  }
+  return 0;
+}
+
+static int
+string_cmp(joqe_sortitem *a, joqe_sortitem *b)
+{
+  if(a->prefix != b->prefix)
+    return a->prefix < b->prefix ? -1 : 1;
+  // interned strings are the same pointer, short ones are all prefix.
+  if(a->key.u.s == b->key.u.s || !(a->prefix & 0xff))
+    return 0;
+  return strcmp(joqe_node_string(&a->key) + 8,
+                joqe_node_string(&b->key) + 8);
+}
+
+// the first 8 bytes, big endian so they order as the string.
+static uint64_t
+string_prefix(const char *s)
+{
+  uint64_t p = 0;
+  int i;
+  for(i = 0; i < 8 && s[i]; ++i)
+    p |= (uint64_t)(unsigned char)s[i] << (56 - 8*i);
+  return p;
+}
+
+static void
+merge_sort(joqe_sortitem *v, int count,
+           int (*cmp)(joqe_sortitem*, joqe_sortitem*))
+{
+  joqe_sortitem *tmp = malloc(sizeof(*tmp) * count), *from = v, *to = tmp;
+  for(int width = 1; width < count; width *= 2) {
+    for(int lo = 0; lo < count; lo += 2*width) {
+      int mid = lo + width < count ? lo + width : count,
+          hi = lo + 2*width < count ? lo + 2*width : count,
+          i = lo, j = mid, k = lo;
+      while(i < mid && j < hi)
+        to[k++] = cmp(&from[j], &from[i]) < 0 ? from[j++] : from[i++];
+      while(i < mid)
+        to[k++] = from[i++];
+      while(j < hi)
+        to[k++] = from[j++];
+    }
+    joqe_sortitem *t = from;
+    from = to;
+    to = t;
+  }
+  if(from != v)
+    memcpy(v, from, sizeof(*v) * count);
+  free(tmp);
+}
+
+// least significant digit first, digits all keys share are skipped.
+static void
+radix_sort(joqe_sortitem *v, int count)
+{
+  joqe_sortitem *tmp = malloc(sizeof(*tmp) * count), *from = v, *to = tmp;
+  int i, shift;
+
+  for(i = 0; i < count; ++i)
+    v[i].prefix = (uint64_t)v[i].key.u.i ^ (UINT64_C(1) << 63);
+
+  for(shift = 0; shift < 64; shift += RADIX_BITS) {
+    int buckets[RADIX_SIZE] = {}, at = 0;
+    for(i = 0; i < count; ++i)
+      buckets[(from[i].prefix >> shift) & (RADIX_SIZE-1)]++;
+    if(buckets[(from[0].prefix >> shift) & (RADIX_SIZE-1)] == count)
+      continue;
+    for(i = 0; i < RADIX_SIZE; ++i) {
+      int b = buckets[i];
+      buckets[i] = at;
+      at += b;
+    }
+    for(i = 0; i < count; ++i)
+      to[buckets[(from[i].prefix >> shift) & (RADIX_SIZE-1)]++] = from[i];
+    joqe_sortitem *t = from;
+    from = to;
+    to = t;
+  }
+  if(from != v)
+    memcpy(v, from, sizeof(*v) * count);
+  free(tmp);
+}
+
+void
+joqe_sort(joqe_sortitem *v, int count)
+{
+  int i, ints = 0, strings = 0;
+  if(count < 2)
+    return;
+
+  for(i = 0; i < count; ++i) {
+    switch(JOQE_TYPE_VALUE(v[i].key.type)) {
+      case joqe_type_none_integer: ints++; break;
+      case joqe_type_none_string: strings++; break;
+      default:;
+    }
+  }
+
+  if(ints == count) {
+    radix_sort(v, count);
+  } else if(strings == count) {
+    for(i = 0; i < count; ++i)
+      v[i].prefix = string_prefix(joqe_node_string(&v[i].key));
+    merge_sort(v, count, string_cmp);
+  } else {
+    merge_sort(v, count, joqe_sort_cmp);
+  }
+}
+
+// --top k--
+
+// whether a is to be dropped before b, item order is kept in prefix.
+static int
+worse(joqe_topk *h, joqe_sortitem *a, joqe_sortitem *b)
+{
+  int cmp = joqe_sort_cmp(a, b);
+  if(h->least)
+    cmp = -cmp;
+  return cmp < 0 || (cmp == 0 && a->prefix > b->prefix);
+}
+
+static void
+sift_down(joqe_topk *h, int i)
+{
+  for(;;) {
+    int l = 2*i + 1, r = l + 1, w = i;
+    if(l < h->len && worse(h, &h->v[l], &h->v[w])) w = l;
+    if(r < h->len && worse(h, &h->v[r], &h->v[w])) w = r;
+    if(w == i)
+      return;
+    joqe_sortitem t = h->v[i];
+    h->v[i] = h->v[w];
+    h->v[w] = t;
+    i = w;
+  }
+}
+
+joqe_topk
+joqe_topk_create(int64_t cap, int least)
+{
+  joqe_topk h = {.cap = cap, .least = least};
+  return h;
+}
+
+int
+joqe_topk_push(joqe_topk *h, joqe_sortitem *x, joqe_sortitem *out)
+{
+  x->prefix = h->seq++;
+  if(h->len < h->cap) {
+    if(h->len == h->size) {
+      h->size = h->size ? 2*h->size : 16;
+      if(h->size > h->cap)
+        h->size = h->cap;
+      h->v = realloc(h->v, sizeof(*h->v) * h->size);
+    }
+    // the worst item is kept at the root.
+    int i = h->len++;
+    while(i && worse(h, x, &h->v[(i-1)/2])) {
+      h->v[i] = h->v[(i-1)/2];
+      i = (i-1)/2;
+    }
+    h->v[i] = *x;
+    return 0;
+  }
+  if(!h->len || !worse(h, &h->v[0], x)) {
+    *out = *x;
+    return 1;
+  }
+  *out = h->v[0];
+  h->v[0] = *x;
+  sift_down(h, 0);
+  return 1;
+}
+
+joqe_sortitem*
+joqe_topk_finish(joqe_topk *h, int *count)
+{
+  joqe_sortitem *v = h->v;
+  *count = h->len;
+  // taking the worst off the heap leaves the best in front.
+  while(h->len > 1) {
+    joqe_sortitem t = v[0];
+    v[0] = v[--h->len];
+    v[h->len] = t;
+    sift_down(h, 0);
+  }
+  h->v = 0;
+  h->len = 0;
+  return v;
+}
@@ -0,0 +1,43 @@
+#ifndef __JOQE_SORT_H__
+#define __JOQE_SORT_H__
+
+#include "json.h"
+
+/* Stable sorting of values by a key each. Keys of different types order
+   as: missing (type broken), null, false, true, numbers, strings, arrays
+   and objects. Numbers order by value, strings byte by byte, arrays and
+   objects only by type. The kernel is picked by the keys: a radix sort
+   when they're all integers, a merge sort on an 8 byte prefix when
+   they're all plain strings, and a merge sort on the full order
+   otherwise. */
+
+typedef struct joqe_sortitem {
+  joqe_node  key;
+  joqe_node  value;
+  uint64_t   prefix; // used by the kernels
+} joqe_sortitem;
+
+void  joqe_sort     (joqe_sortitem *v, int count);
+// the order above, as a comparison.
+int   joqe_sort_cmp (joqe_sortitem *a, joqe_sortitem *b);
+
+/* A bounded heap keeping the cap greatest items pushed (or least, with
+   least set), in O(cap) memory and O(log cap) time per item. Of equal
+   items the ones pushed first are kept. */
+typedef struct joqe_topk {
+  joqe_sortitem *v;
+  int            len;
+  int            size;
+  int64_t        cap;
+  int            least;
+  uint64_t       seq;
+} joqe_topk;
+
+joqe_topk       joqe_topk_create (int64_t cap, int least);
+// returns 1 with the item that doesn't make it in *out, x or a former one.
+int             joqe_topk_push   (joqe_topk *h, joqe_sortitem *x,
+                                  joqe_sortitem *out);
+// the items kept, best first; the caller frees them.
+joqe_sortitem*  joqe_topk_finish (joqe_topk *h, int *count);
+
+#endif /* idempotent include guard */
@@ -3,13 +3,33 @@
 #include "build.h"
 #include "joqe.tab.h"
 #include "lex.h"
+#include "opt.h"
+#include "vm.h"
+#include "keyindex.h"
+#include "cons.h"
+#include "arena.h"
 
 #include <assert.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
 
 int check(const char *exp, joqe_node *in, const char *out);
+int untouched(joqe_node n);
+int concurrent(joqe_node *doc);
+int shared(joqe_arena *a);
+int deep();
+int pushed();
+int badpatterns();
+int reshaped();
+int rows();
+
+joqe_index *docindex;
+// parse errors expected, not reported.
+int parse_quiet;
+__thread joqe_arena *arena;
 
 const char *testDocument = "{"
   "'status':'success',"
@@ -28,7 +48,15 @@ const char *testDocument = "{"
     "{'color':'magenta','hex':'#f0f'},"
     "{'color':'yellow','hex':'#ff0'},"
     "{'color':'black','hex':'#000'},"
-  "]"
+  "],"
+  "'samples': [3, 1, 4, 1, 5, 9, 2, 6, 5, 3],"
+  "'stock': ["
+    "{'sku':'a','qty':1},{'sku':'b','qty':5},{'sku':'c','qty':3},"
+    "{'sku':'d'},{'sku':'e','qty':4,'note':'n'},{'qty':2.5,'sku':'f'},"
+    "{'sku':'g','qty':'x'},{'sku':'h','qty':7}"
+  "],"
+  "'pairs': [{'x':1,'y':2},{'y':3,'x':4},{'x':5,'x':6},{'x':7,'y':8}],"
+  "'sequence': 0"
 "}";
 
 int cases(joqe_node *doc)
@@ -51,11 +79,118 @@ int cases(joqe_node *doc)
       || check("results[0 and color].color", doc, "'red'")
       || check("results[0].color or null", doc, "'red'")
       || check("'abc''def' = 'abc''def'", doc, "true")
+      || check("{'a''b': 1}", doc, "{'ab':1}")
+      || check("{(concat(status, ' and ', message)): 1}", doc,
+        "{'success and ok':1}")
       || check("'abc''def' = 'abcdef'", doc, "true")
       || check("'abc''def' = 'ab''cd''ef'", doc, "true")
       || check("'abc''def' = 'ab''dc''ef'", doc, "false")
       || check("meta['prio''rity']", doc, "1")
       || check("meta.concat(tags[0],' ',tags[1]) = 'ok information'", doc, "true")
+      || check("[results[not tags].color]", doc,
+        "['cyan','magenta','yellow','black']")
+      || check("[results[tags[] = 'ok' or color = 'black']::hex]", doc,
+        "['#0f0','#000']")
+      || check("[meta.priority + meta.sequence, -meta.priority]", doc,
+        "[3246,-1]")
+      || check("(results[1] :: color)", doc, "'green'")
+      || check("[1 + 2 * 3, 7 / 2, 1 - 0.5]", doc, "[7,3,0.5]")
+      || check("results[6 and (true or color = 'red')].hex", doc, "'#000'")
+      || check("[results[not (not tags) and false or color = 'cyan'].hex]", doc,
+        "['#0ff']")
+      || check("[results[not (not tags)].color]", doc, "['red','green','blue']")
+      || check("[false and meta, 'x' or meta, 0 or 'y']", doc, "['x','y']")
+      || check("[results[hex = /results[3].hex or color = 'red'].color]", doc,
+        "['red','cyan']")
+      || check("[results[/meta.missing or color = 'blue'].color]", doc,
+        "['blue']")
+      || check("[meta.sequence | meta.priority | meta.sequence]", doc,
+        "[1,3245]")
+      || check("[meta.tags[] | ..tags[0]]", doc,
+        "['ok','information','warning','ok','information']")
+      || check("[..[true] = ..hex, ..color > ..tags[], ..[true] < ..tags[],"
+               " ..color != ..hex, ..color = ..tags[], ..[true] = ..none]",
+               doc, "[true,true,true,true,false,false]")
+      || check("[..sequence]", doc, "[0,3245]")
+      || check("[..[sequence]::sequence]", doc, "[3245]")
+      || check("[results..[color = 'blue' and tags].hex]", doc, "['#00f']")
+      || check("{'t': ..tags[0], 'c': (results[hex] :: color),"
+               " 'n': -..priority}", doc, "{'t':'ok','c':'red','n':-1}")
+      || check("[(..[true] :: color), results[0].concat(hex, '!') = '#f00!']",
+               doc, "['red','green','blue','cyan','magenta','yellow','black',"
+                    "true]")
+      || check("[results[0] = results[0], results[0] = results[1],"
+               " ({'tags': ['information'], 'hex': '#00f', 'color': 'blue'}"
+               " :: .) = results[2], (['information', 'ok'] :: .) != meta.tags,"
+               " ([1, {'a': 2.5}] :: .) = ([1.0, {'a': 2.5}] :: .),"
+               " ..[true] = results[], results = meta]",
+               doc, "[true,false,true,true,true,true,false]")
+      || check("[..[. = (['ok', 'information'] :: .)]]", doc,
+               "[['ok','information']]")
+      || check("[count(..tags[]), sum(meta[]), min(meta[]), max(..sequence),"
+               " avg(meta.priority | meta.sequence), count(..none),"
+               " sum(..none), min(..none)]",
+               doc, "[8,3367.9,1,3245,1623.0,0,0]")
+      || check("[results[count(tags[]) > 1].color]", doc, "['red','green']")
+      || check("[meta.tags.sort(), results.sort_by(color)[0].color,"
+               " sort_by(results[], tags[0])[].color]", doc,
+               "[['information','ok'],'black','cyan','magenta','yellow',"
+               "'black','blue','green','red']")
+      || check("[sort(([3, -1, 2000000000, -2000000000, 256, 255] :: .[])),"
+               " sort(([true, 'ab', 2, null, [1], {}, false, 1.5,"
+               " 'abcdefghij', 'abcdefghia', 'abcdefgh'] :: .[]))]", doc,
+               "[[-2000000000,-1,3,255,256,2000000000],"
+               "[null,false,true,1.5,2,'ab','abcdefgh','abcdefghia',"
+               "'abcdefghij',[1],{}]]")
+      || check("[top(2, ., meta[]), bottom(3, color, results[])[].hex,"
+               " [limit(2, ..color)], [limit(0, ..color)], top(0, ., ..tags)]",
+               doc, "[[['ok','information'],3245],'#000','#00f','#0ff',"
+                    "['red','green'],[],[]]")
+      || check("[results[color.contains('ee')].color,"
+               " results[].color.starts_with('bl'), ..tags[].ends_with('ure'),"
+               " results[hex.matches('^#(f|0)0[f0]$')].color,"
+               " results[color.matches('^[^aeiou]+[ae]')].hex,"
+               " results[color.matches('c\\\\w+n|(el)+l')].color,"
+               " results[hex.contains((['zz', 'f0'] :: .[]))].color,"
+               " meta[].matches('1')]",
+               doc, "['green','blue','black','failure','red','blue',"
+                    "'magenta','black','#f00','#0f0','#0ff','#f0f','#ff0',"
+                    "'#000','cyan','yellow','red','green','magenta','yellow']")
+      || check("[3000000000 * 4, (9223372036854775807 + 1) / 2"
+               " = 4611686018427387904, -(-9223372036854775807 - 1) > 0,"
+               " 7 % -1, sum(([1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,"
+               " 15, 16, 17, 18, 19, 20] :: .[]) * 1000),"
+               " min(([1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16,"
+               " 17, 18, 19, 20] :: .[]) * 0.5),"
+               " ([1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17,"
+               " 18, 19, 20] :: .[]) > 20, 19.5 < ([1, 2, 3, 4, 5, 6, 7, 8,"
+               " 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20] :: .[])]",
+               doc, "[12000000000,true,true,0,210000,0.5,false,true]")
+      || check("[samples[4], samples[10], ..samples[9], sum(samples[]),"
+               " [samples[. > 4]], samples.sort()[9], top(1, ., samples[]),"
+               " samples = ([3, 1, 4, 1, 5, 9, 2, 6, 5, 3] :: .),"
+               " samples = ([3, 1, 4, 1, 5, 9, 2, 6, 5, 3.5] :: .),"
+               " max(samples[] * 2), samples[5] = 9.0]",
+               doc, "[5,3,39,[5,9,6,5],9,[9],true,false,18,true]")
+      || check("[stock[qty > 2].sku, count(stock[qty]),"
+               " stock[2 < qty and sku != 'c'].qty, stock[qty = 'x'].sku,"
+               " [stock[].note], stock[qty >= 4 or note].sku,"
+               " [stock[sku = 'h'].qty], [stock[none > 1]], [stock[].none],"
+               " count(stock[true or sku]), stock[5].qty]",
+               doc, "['b','c','e','f','h',7,5,4,2.5,7,'g',['n'],'b','e','h',"
+                    "[7],[],[],8,2.5]")
+      || check("[pairs[].x, pairs[].y, count(pairs[x > 1]), pairs[3].y,"
+               " [pairs[].z]]", doc, "[1,4,5,6,7,2,3,8,3,8,[]]")
+      || check("[{(results[0].color): results[1].hex}, sort(stock[].sku)[7],"
+               " concat(message, stock[1].sku) = 'okb', message.ends_with('k'),"
+               " results[hex = '#0ff'].color]",
+               doc, "[{'red':'#0f0'},'h',true,'ok','cyan']")
+      || check("[({(message): 1, (meta.tags[1]): 2} :: ok),"
+               " ({(message): 1} :: .[]::name())]", doc, "[1,'ok']")
+      || check("[results[3] = ({'hex':'#0ff','color':'cyan'} :: .),"
+               " results[3] = results[4], [results[4][]], count(stock[2][]),"
+               " stock[1].qty + stock[7].qty]",
+               doc, "[true,false,['magenta','#f0f'],2,12]")
   ;
 }
 
@@ -77,18 +212,31 @@ main(int argc, char **argv)
     return 0;
   }
   joqe_build inb  = joqe_build_init(joqe_lex_source_string(testDocument));
+  docindex = inb.index = joqe_index_create();
   if (joqe_json(&inb)) return fail("Unable to parse input: %s", testDocument);
 
-  int r = cases(&inb.root.u.node);
+  arena = joqe_arena_create();
+  int r = cases(&inb.root.u.node)
+       || concurrent(&inb.root.u.node)
+       || untouched(inb.root.u.node)
+       || shared(0)
+       || shared(arena)
+       || deep()
+       || pushed()
+       || badpatterns()
+       || reshaped()
+       || rows();
 
   joqe_build_destroy(&inb);
+  joqe_arena_destroy(arena);
   return r;
 }
 
 int
 joqe_yyerror(joqe_build *build, const char *msg)
 {
-  fail("Parsing failed: %s", msg);
+  if(!parse_quiet)
+    fail("Parsing failed: %s", msg);
   return 0;
 }
 
@@ -97,7 +245,14 @@ int equal(joqe_nodels *actual, joqe_nodels *expected)
   int r;
   joqe_nodels *aend = actual,
               *eend = expected;
-  if(actual && !expected) {
+  // ref count sentinels only ever lead a list.
+  if(actual && actual->n.type == joqe_type_ref_cnt)
+    actual = (joqe_nodels*) actual->ll.n;
+  if(expected && expected->n.type == joqe_type_ref_cnt)
+    expected = (joqe_nodels*) expected->ll.n;
+  if(!actual && !expected) {
+    return 0;
+  } else if(actual && !expected) {
     return fail("Found something but expected nothing");
   } else if(!actual && expected) {
     return fail("Found nothing but expected something");
@@ -105,7 +260,12 @@ int equal(joqe_nodels *actual, joqe_nodels *expected)
 
   do {
     joqe_type t, et;
-    if((t = actual->n.type) != (et = expected->n.type)
+    t = actual->n.type & ~(JOQE_TYPE_VIEW_MASK|JOQE_TYPE_PACKED_MASK
+                           |JOQE_TYPE_INLINE_MASK|JOQE_TYPE_KEY_INLINE_MASK);
+    et = expected->n.type & ~(JOQE_TYPE_VIEW_MASK|JOQE_TYPE_PACKED_MASK
+                              |JOQE_TYPE_INLINE_MASK
+                              |JOQE_TYPE_KEY_INLINE_MASK);
+    if(t != et
       && (JOQE_TYPE_KEY(et) != joqe_type_broken
         ||JOQE_TYPE_VALUE(et) != JOQE_TYPE_VALUE(t))
       )
@@ -113,14 +273,16 @@ int equal(joqe_nodels *actual, joqe_nodels *expected)
         actual->n.type, expected->n.type);
     else if(JOQE_TYPE_KEY(t) == joqe_type_string_none
           && JOQE_TYPE_KEY(et) == joqe_type_string_none
-          && 0 != strcmp(actual->n.k.key, expected->n.k.key))
+          && 0 != strcmp(joqe_member_key(&actual->n),
+                         joqe_member_key(&expected->n)))
         return fail("Key missmatch: %s (expected: %s)",
-          actual->n.k.key, expected->n.k.key);
+          joqe_member_key(&actual->n), joqe_member_key(&expected->n));
     else switch(JOQE_TYPE_VALUE(t)) {
       case joqe_type_none_string:
-        if(0 != strcmp(actual->n.u.s, expected->n.u.s))
+        if(0 != strcmp(joqe_node_string(&actual->n),
+                       joqe_node_string(&expected->n)))
           return fail("Value missmatch: \"%s\" (expected: \"%s\")",
-            actual->n.u.s, expected->n.u.s);
+            joqe_node_string(&actual->n), joqe_node_string(&expected->n));
         break;
       case joqe_type_none_integer:
         if(actual->n.u.i != expected->n.u.i)
@@ -135,7 +297,8 @@ int equal(joqe_nodels *actual, joqe_nodels *expected)
       case joqe_type_none_object:
       case joqe_type_none_array:
       case joqe_type_none_stringls:
-        if((r = equal(actual->n.u.ls, expected->n.u.ls)))
+        if((r = equal(joqe_node_members(&actual->n),
+                      joqe_node_members(&expected->n))))
           return r;
         break;
     }
@@ -154,6 +317,320 @@ int equal(joqe_nodels *actual, joqe_nodels *expected)
     return fail("Missing nodes");
 }
 
+// results only view the document, evaluating must leave it as parsed.
+int untouched(joqe_node n)
+{
+  joqe_nodels *i;
+  if(JOQE_TYPE_PACKED(n.type)) {
+    for(int k = 0; k < n.u.p->nodes; ++k)
+      if(untouched(JOQE_PACKED_NODES(n.u.p)[k]))
+        return 1;
+    return 0;
+  }
+  switch(JOQE_TYPE_VALUE(n.type)) {
+    case joqe_type_none_object:
+    case joqe_type_none_array:
+    case joqe_type_none_stringls:
+      if((i = n.u.ls)) do {
+        // the parser leads a list with a sentinel only to keep its
+        // columns or shape in.
+        if(i->n.type == joqe_type_ref_cnt && (i != n.u.ls || !i->n.k.shape))
+          return fail("Document modified by evaluation");
+        if(untouched(i->n))
+          return 1;
+      } while((i = (joqe_nodels*)i->ll.n) != n.u.ls);
+  }
+  return 0;
+}
+
+static void*
+worker(void *doc)
+{
+  arena = joqe_arena_create();
+  long r = cases(doc);
+  joqe_arena_destroy(arena);
+  return (void*)r;
+}
+
+static joqe_node*
+member(joqe_node *n, int k)
+{
+  joqe_members it = joqe_members_of(n);
+  joqe_node *m;
+  while((m = joqe_members_next(&it)) && k--)
+    ;
+  return m;
+}
+
+// repeated subtrees parsed with hash-consing, into an arena or not.
+int shared(joqe_arena *a)
+{
+  joqe_build b = joqe_build_init(joqe_lex_source_string(
+      "{'a': [{'x': [1, 2], 'y': {}}, {'x': [1, 2], 'y': {}},"
+      " {'x': [1.0, 2], 'y': {}}], 'b': {'x': [1, 2], 'y': {}},"
+      " 'c': [{'u': 1, 'v': 2}, {'u': 1, 'v': 2}, {'u': 1, 'v': 2},"
+      " {'u': 1, 'v': 2}, {'u': 1, 'v': 2}, {'u': 1, 'v': 2},"
+      " {'u': 1, 'v': 2}, {'u': 1, 'v': 2}], 'd': {'u': 1, 'v': 2}}"));
+  b.cons = joqe_cons_create();
+  joqe_arena_use(a);
+  int r = joqe_json(&b);
+  if(!r) {
+    joqe_node *root = &b.root.u.node, *ls = member(root, 0);
+    r = member(ls, 0)->u.ls != member(ls, 1)->u.ls
+     || member(ls, 0)->u.ls == member(ls, 2)->u.ls
+     || member(ls, 0)->u.ls != member(root, 1)->u.ls
+     || b.ord != 50 || b.dropped != 24;
+    // members are numbered where they're found, a union keeps them all.
+    // Not in the arena, which goes with each query.
+    if(!r && !a)
+      r = check("count(a[].x[] | b.x[])", root, "8")
+       || check("count(..[. = 2] | b.x[1])", root, "13")
+       || check("count(c[].u | d.u)", root, "9")
+       || check("count(c[u = 1].v | d.v)", root, "9");
+  }
+  if(a) {
+    // the arena takes the document with it.
+    b.root.construct = 0;
+    joqe_arena_reset(a);
+  }
+  joqe_arena_use(0);
+  joqe_build_destroy(&b);
+  return r ? fail("Subtrees weren't shared (%s)", a ? "arena" : "heap") : 0;
+}
+
+// a document nesting deeper than the C stack would allow recursing
+// into, and the same document over a lower limit.
+int deep()
+{
+  int depth = 200000, r;
+  char *s = malloc(2*depth + 1);
+  memset(s, '[', depth);
+  memset(s + depth, ']', depth);
+  s[2*depth] = 0;
+
+  joqe_build b = joqe_build_init(joqe_lex_source_string(s));
+  if(!(r = joqe_json(&b)))
+    r = check("count(..[true])", &b.root.u.node, "199999");
+  joqe_build_destroy(&b);
+
+  b = joqe_build_init(joqe_lex_source_string(s));
+  b.depth = depth - 1;
+  parse_quiet = 1;
+  if(!r && !joqe_json(&b))
+    r = fail("Parsed a document nested too deep");
+  parse_quiet = 0;
+  joqe_build_destroy(&b);
+  free(s);
+  if(r)
+    return r;
+
+  // two copies of an object as deep, compared member by member.
+  depth = 100000;
+  char *o = s = malloc(2*(6*depth + 2) + 2);
+  *o++ = '[';
+  for(int copy = 0; copy < 2; ++copy) {
+    for(int i = 0; i < depth; ++i)
+      o = memcpy(o, "{'a':", 5) + 5;
+    *o++ = '1';
+    memset(o, '}', depth);
+    o += depth;
+    *o++ = copy ? ']' : ',';
+  }
+  *o = 0;
+
+  b = joqe_build_init(joqe_lex_source_string(s));
+  if(!(r = joqe_json(&b)))
+    r = check("[. = ., .[0] = .[1], .[0] != .[1].a]", &b.root.u.node,
+              "[true,true,true]");
+  joqe_build_destroy(&b);
+  free(s);
+  return r;
+}
+
+// literal patterns that don't compile fail the query, not every match.
+int badpatterns()
+{
+  const char *exps[] = {
+    "matches('(')", "matches('[')", "matches('[]')", "matches('\\\\')"
+  };
+  int r = 0;
+  parse_quiet = 1;
+  for(int i = 0; !r && i < sizeof(exps)/sizeof(*exps); ++i) {
+    joqe_build b = joqe_build_init(joqe_lex_source_string(exps[i]));
+    if(!joqe_yyparse(&b))
+      r = fail("Parsed an invalid pattern: %s", exps[i]);
+    joqe_build_destroy(&b);
+  }
+  parse_quiet = 0;
+  return r;
+}
+
+// s pushed n bytes at a time, to be as parsed in one go.
+static int
+push(const char *s, int n)
+{
+  joqe_build b = joqe_build_init(joqe_lex_source_chunked());
+  joqe_json_parser *p = joqe_json_parser_create(&b);
+  int len = strlen(s), r = JOQE_JSON_MORE;
+  for(int i = 0; r == JOQE_JSON_MORE && i < len; i += n)
+    r = joqe_json_push(p, s + i, i + n < len ? n : len - i);
+  if(r == JOQE_JSON_MORE)
+    r = joqe_json_push(p, 0, 0);
+  joqe_json_parser_destroy(p);
+  b.src.destroy(&b.src);
+  if(!r)
+    r = check(".", &b.root.u.node, s);
+  joqe_build_destroy(&b);
+  return r ? fail("Pushed %d bytes at a time, failed", n) : 0;
+}
+
+// s pushed in one piece, complete without the end of the input.
+static int
+complete(const char *s)
+{
+  joqe_build b = joqe_build_init(joqe_lex_source_chunked());
+  joqe_json_parser *p = joqe_json_parser_create(&b);
+  int r = joqe_json_push(p, s, strlen(s));
+  joqe_json_parser_destroy(p);
+  b.src.destroy(&b.src);
+  if(r == JOQE_JSON_MORE)
+    r = fail("Pushed %s, still waiting for more", s);
+  else if(!r)
+    r = check(".", &b.root.u.node, s);
+  joqe_build_destroy(&b);
+  return r;
+}
+
+// documents pushed in pieces, cut anywhere, even within a character or
+// a string longer than a block.
+int pushed()
+{
+  int len = 70000, r = 0;
+  char *s = malloc(2*len + 16);
+  strcpy(s, "['\\u00e9");
+  for(int i = 8; i < 2*len; i += 2)
+    memcpy(s + i, "\xc3\xa9", 2);
+  strcpy(s + 2*len, "', -1.5e1]");
+
+  int sizes[] = {1, 2, 3, 7, 4096, 1<<20};
+  for(int i = 0; !r && i < sizeof(sizes)/sizeof(*sizes); ++i)
+    r = push(testDocument, sizes[i])
+     || push(s, sizes[i])
+     || push("-12", sizes[i]);
+  free(s);
+  const char *shorts[] = {"{}", "[]", "[1]", "\"\"", "{ }"};
+  for(int i = 0; !r && i < sizeof(shorts)/sizeof(*shorts); ++i)
+    r = complete(shorts[i]);
+  return r;
+}
+
+// one query over documents parsed one after the other, each of which may
+// be given its shapes where those of the one before were.
+int reshaped()
+{
+  const char *docs[] = {
+    "{'b': 1}", "{'a': 2}", "{'b': 1, 'c': 'x'}", "{'a': 2, 'c': 'y'}"
+  };
+  joqe_build expb = joqe_build_init(joqe_lex_source_string("a"));
+  if(joqe_yyparse(&expb))
+    return fail("Unable to parse expression: a");
+  joqe_vm_program *vm = joqe_vm_compile(&expb.root);
+  int r = 0;
+  for(int i = 0; !r && i < 4; ++i) {
+    joqe_build b = joqe_build_init(joqe_lex_source_string(docs[i]));
+    joqe_json(&b);
+    for(int usevm = 0; !r && usevm < 2; ++usevm) {
+      joqe_result jr = {};
+      joqe_ctx ctx = {NULL, &b.root.u.node};
+      if(usevm)
+        joqe_vm_run(vm, ctx.node, &ctx, &jr);
+      else
+        expb.root.construct(&expb.root, ctx.node, &ctx, &jr);
+      // every other document has an 'a', 2.
+      if(i % 2 ? !jr.ls || jr.ls->n.u.i != 2 : jr.ls != 0)
+        r = fail("Found 'a' through a stale shape (%s)",
+                 usevm ? "vm" : "tree");
+      joqe_result_destroy(&jr);
+    }
+    joqe_build_destroy(&b);
+  }
+  joqe_vm_destroy(vm);
+  joqe_build_destroy(&expb);
+  return r;
+}
+
+// a record with objects and arrays among its members, and arrays of
+// mixed scalars, kept in rows of their own.
+int rows()
+{
+  joqe_build b = joqe_build_init(joqe_lex_source_string(
+      "{'r': {'id': 1, 'name': 'abcdefghij', 'tags': ['a', 2, true, null],"
+      " 'at': 2.5, 'more': {'x': 1}}, 'n': [1, 'b', 3.5]}"));
+  int r = joqe_json(&b);
+  if(!r) {
+    joqe_node *root = &b.root.u.node, *rec = member(root, 0);
+    r = !JOQE_TYPE_PACKED(rec->type) || rec->u.p->nodes != 2
+     || !JOQE_TYPE_PACKED(member(rec, 2)->type)
+     || !JOQE_TYPE_PACKED(member(root, 1)->type);
+    // members are numbered in document order, around the nested ones.
+    if(!r)
+      r = check("[n[1] | r.at | r.tags[0] | r.more.x]", root,
+                "['a', 2.5, 1, 'b']")
+       || check("count(..[true])", root, "15")
+       || check("[r[]::name()]", root,
+                "['id', 'name', 'tags', 'at', 'more']")
+       || check("r.tags[2]", root, "true")
+       || check("/[tags[1] = 2].more", root, "{'x': 1}")
+       || untouched(b.root.u.node);
+  }
+  joqe_build_destroy(&b);
+  return r ? fail("Rows weren't kept") : 0;
+}
+
+// the same queries from several threads against the one document.
+int concurrent(joqe_node *doc)
+{
+  pthread_t t[4];
+  int i, started, r = 0;
+  for(started = 0; started < 4; ++started)
+    if(pthread_create(&t[started], 0, worker, doc))
+      break;
+  for(i = 0; i < started; ++i) {
+    void *tr;
+    pthread_join(t[i], &tr);
+    r |= tr != 0;
+  }
+  if(started < 4)
+    return fail("Unable to start threads");
+  return r ? fail("Concurrent evaluation failed") : 0;
+}
+
+int run(const char *exp, const char *engine, joqe_build *expb,
+        joqe_node *in, joqe_nodels *outls, int usevm, joqe_index *index)
+{
+  joqe_result jr = {};
+  joqe_ctx ctx = {NULL, in, index};
+  joqe_vm_program *vm = 0;
+
+  joqe_arena_use(arena);
+
+  if(usevm) {
+    vm = joqe_vm_compile(&expb->root);
+    joqe_vm_run(vm, in, &ctx, &jr);
+  } else {
+    expb->root.construct(&expb->root, in, &ctx, &jr);
+  }
+
+  int r = equal(jr.ls, outls);
+  if(r) fail("Expectation failed for '%s' (%s)", exp, engine);
+
+  joqe_result_destroy(&jr);
+  joqe_vm_destroy(vm);
+  joqe_arena_reset(arena);
+  joqe_arena_use(0);
+  return r;
+}
+
 int check(const char *exp, joqe_node *in, const char *out)
 {
   joqe_build expb = joqe_build_init(joqe_lex_source_string(exp));
@@ -162,20 +639,19 @@ int check(const char *exp, joqe_node *in, const char *out)
   if (joqe_json(&outb)) return fail("Unable to parse output: %s", out);
   if (joqe_yyparse(&expb)) return fail("Unable to parse expression: %s", exp);
 
-  joqe_result jr = {};
-  joqe_ctx ctx = {NULL, in};
-  expb.root.construct(&expb.root, in, &ctx, &jr);
-
   joqe_nodels outls = {.n = outb.root.u.node};
   outls.ll.n = outls.ll.p = &outls.ll;
 
-  int r = equal(jr.ls, &outls);
-  if(r) fail("Expectation failed for '%s'", exp);
-
-  joqe_result_destroy(&jr);
+  int r = run(exp, "tree", &expb, in, &outls, 0, 0);
+  if(!r) {
+    joqe_optimize(&expb, 0);
+    r = run(exp, "optimized", &expb, in, &outls, 0, 0)
+     || run(exp, "vm", &expb, in, &outls, 1, 0)
+     || run(exp, "indexed", &expb, in, &outls, 0, docindex)
+     || run(exp, "indexed vm", &expb, in, &outls, 1, docindex);
+  }
 
   joqe_build_destroy(&outb);
   joqe_build_destroy(&expb);
   return r;
 }
-
@@ -0,0 +1,939 @@
+#include "vm.h"
+#include "keyindex.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <assert.h>
+
+/* The compiler flattens a construct tree into one linear instruction
+   array. Expressions evaluated for their value leave a node set on the
+   value stack, expressions evaluated in a boolean context (filters and
+   the operands of and/or/not) leave their result in the test flag.
+   Filter predicates and context expressions are compiled into
+   subroutines appended after the main program, and are invoked once per
+   candidate node. Paths are evaluated a step at a time on a cursor of
+   node pointers, copies are only made once the path is complete.
+   Anything the compiler doesn't understand (e.g. function calls) is
+   delegated to the tree walker. */
+
+typedef enum {
+  vm_op_ret,          // return the top of stack
+  vm_op_rett,         // return the test flag
+
+  vm_op_fix,          // push true/false/null
+  vm_op_string,
+  vm_op_stringls,
+  vm_op_integer,
+  vm_op_real,
+  vm_op_eval,         // tree walker fallbacks, a: first node only
+  vm_op_evalt,
+  vm_op_construct,
+
+  vm_op_testkey,      // string literal in boolean context
+  vm_op_testidx,      // integer literal in boolean context
+  vm_op_testfix,      // constant test flag
+
+  vm_op_compare,
+  vm_op_comparet,
+  vm_op_calc,
+  vm_op_calct,
+  vm_op_sign,
+  vm_op_signt,
+  vm_op_not,
+  vm_op_bool,         // push the test flag as a boolean
+
+  vm_op_jf,           // jump if the test flag is false
+  vm_op_jt,           // jump if the test flag is true
+  vm_op_jfempty,      // push an empty set and jump if the flag is false
+  vm_op_jrv,          // jump if the top of stack evaluated to true
+  vm_op_drop,
+  vm_op_concat,
+  vm_op_union,        // turn the top of stack into a set
+
+  vm_op_ctx,          // run a subroutine for each node in a context
+  vm_op_ctxt,
+
+  vm_op_local,        // path cursor operations
+  vm_op_context,
+  vm_op_name,
+  vm_op_flex,
+  vm_op_filter,
+  vm_op_path,         // push the cursor as a node set
+  vm_op_patht,        // test flag if the cursor is non-empty
+
+  vm_op_object,
+  vm_op_array,
+  vm_op_entry
+} vm_op;
+
+typedef struct {
+  vm_op   op;
+  int     a;
+  joqe_shape_cache shape; // of vm_op_name
+  union {
+    const char         *s;
+    int64_t             i;
+    double              d;
+    joqe_ast_expr      *e;
+    joqe_ast_construct *cst;
+    joqe_ast_pathelem  *pe;
+  } u;
+} vm_insn;
+
+typedef enum {
+  vm_sub_expr,
+  vm_sub_test,
+  vm_sub_construct
+} vm_sub_kind;
+
+typedef struct {
+  int           at;
+  vm_sub_kind   kind;
+  void         *node;
+} vm_pending;
+
+struct joqe_vm_program {
+  vm_insn    *code;
+  int         len, cap;
+  int         depth;
+
+  // compile time only
+  int         sp;
+  vm_pending *pending;
+  int         npending, cappending;
+};
+
+// --compiler--
+
+static int
+emit(joqe_vm_program *p, vm_op op, int a, int effect)
+{
+  if(p->len == p->cap) {
+    p->cap = p->cap ? p->cap*2 : 64;
+    p->code = realloc(p->code, sizeof(vm_insn) * p->cap);
+  }
+  vm_insn *in = &p->code[p->len];
+  memset(in, 0, sizeof(*in));
+  in->op = op;
+  in->a = a;
+
+  p->sp += effect;
+  assert(p->sp >= 0);
+  if(p->sp > p->depth)
+    p->depth = p->sp;
+
+  return p->len++;
+}
+
+static void
+patch(joqe_vm_program *p, int at)
+{
+  p->code[at].a = p->len;
+}
+
+static void
+pend(joqe_vm_program *p, int at, vm_sub_kind kind, void *node)
+{
+  if(p->npending == p->cappending) {
+    p->cappending = p->cappending ? p->cappending*2 : 16;
+    p->pending = realloc(p->pending, sizeof(vm_pending) * p->cappending);
+  }
+  vm_pending pd = {at, kind, node};
+  p->pending[p->npending++] = pd;
+}
+
+static void compile_expr(joqe_vm_program *p, joqe_ast_expr *e, int test);
+static void compile_construct(joqe_vm_program *p, joqe_ast_construct *cst);
+
+static int
+path_compilable(joqe_ast_path *path)
+{
+  for(; path; path = path->punion) {
+    joqe_ast_pathelem *i;
+    switch(joqe_ast_path_kind(path)) {
+      case joqe_ast_kind_local_path:
+      case joqe_ast_kind_context_path:
+        break;
+      default:
+        return 0;
+    }
+    if((i = path->pes)) do {
+      switch(joqe_ast_pathelem_kind(i)) {
+        case joqe_ast_kind_peflex:
+        case joqe_ast_kind_pename:
+        case joqe_ast_kind_pefilter:
+          break;
+        default:
+          return 0;
+      }
+    } while((i = (joqe_ast_pathelem*)i->ll.n) != path->pes);
+  }
+  return 1;
+}
+
+static void
+compile_path_branch(joqe_vm_program *p, joqe_ast_path *path)
+{
+  joqe_ast_pathelem *i;
+  int at;
+
+  if(joqe_ast_path_kind(path) == joqe_ast_kind_local_path)
+    emit(p, vm_op_local, 0, 0);
+  else
+    emit(p, vm_op_context, path->i, 0);
+
+  if((i = path->pes)) do {
+    switch(joqe_ast_pathelem_kind(i)) {
+      case joqe_ast_kind_pename:
+        at = emit(p, vm_op_name, 0, 0);
+        p->code[at].u.s = i->u.key;
+        break;
+      case joqe_ast_kind_peflex:
+        emit(p, vm_op_flex, 0, 0);
+        break;
+      case joqe_ast_kind_pefilter:
+        at = emit(p, vm_op_filter, -1, 0);
+        p->code[at].u.pe = i;
+        pend(p, at, vm_sub_test, &i->u.expr);
+        break;
+      default:
+        assert(!"uncompilable path element");
+    }
+  } while((i = (joqe_ast_pathelem*)i->ll.n) != path->pes);
+}
+
+static void
+compile_path(joqe_vm_program *p, joqe_ast_path *path, int test)
+{
+  // pending jumps to the end are chained through their targets.
+  int chain = -1, branches = 0, next;
+  for(; path; path = path->punion, branches++) {
+    compile_path_branch(p, path);
+    if(test) {
+      emit(p, vm_op_patht, 0, 0);
+      if(path->punion)
+        chain = emit(p, vm_op_jt, chain, 0);
+    } else {
+      emit(p, vm_op_path, 0, 1);
+      if(branches)
+        emit(p, vm_op_concat, 0, -1);
+    }
+  }
+  for(; chain >= 0; chain = next) {
+    next = p->code[chain].a;
+    patch(p, chain);
+  }
+  if(!test && branches > 1)
+    emit(p, vm_op_union, 0, 0);
+}
+
+static void
+compile_expr(joqe_vm_program *p, joqe_ast_expr *e, int test)
+{
+  int at;
+  switch(joqe_ast_expr_kind(e)) {
+    case joqe_ast_kind_fix_value:
+      if(test) emit(p, vm_op_testfix, e->u.i > 0, 0);
+      else emit(p, vm_op_fix, (int)e->u.i, 1);
+      break;
+    case joqe_ast_kind_string_value:
+      at = emit(p, test ? vm_op_testkey : vm_op_string, 0, test ? 0 : 1);
+      p->code[at].u.s = e->u.s;
+      break;
+    case joqe_ast_kind_stringls_value:
+      at = emit(p, test ? vm_op_evalt : vm_op_stringls, 0, test ? 0 : 1);
+      p->code[at].u.e = e;
+      break;
+    case joqe_ast_kind_integer_value:
+      at = emit(p, test ? vm_op_testidx : vm_op_integer, 0, test ? 0 : 1);
+      p->code[at].u.i = e->u.i;
+      break;
+    case joqe_ast_kind_real_value:
+      if(test) {
+        emit(p, vm_op_testfix, 0, 0);
+      } else {
+        at = emit(p, vm_op_real, 0, 1);
+        p->code[at].u.d = e->u.d;
+      }
+      break;
+    case joqe_ast_kind_bor:
+      if(test) {
+        compile_expr(p, e->u.b.l, 1);
+        at = emit(p, vm_op_jt, -1, 0);
+        compile_expr(p, e->u.b.r, 1);
+      } else {
+        compile_expr(p, e->u.b.l, 0);
+        at = emit(p, vm_op_jrv, -1, 0);
+        emit(p, vm_op_drop, 0, -1);
+        compile_expr(p, e->u.b.r, 0);
+      }
+      patch(p, at);
+      break;
+    case joqe_ast_kind_band:
+      compile_expr(p, e->u.b.l, 1);
+      at = emit(p, test ? vm_op_jf : vm_op_jfempty, -1, 0);
+      compile_expr(p, e->u.b.r, test);
+      patch(p, at);
+      break;
+    case joqe_ast_kind_compare:
+      compile_expr(p, e->u.b.l, 0);
+      compile_expr(p, e->u.b.r, 0);
+      emit(p, test ? vm_op_comparet : vm_op_compare, e->u.b.op, test ? -2 : -1);
+      break;
+    case joqe_ast_kind_calc:
+      compile_expr(p, e->u.b.l, 0);
+      compile_expr(p, e->u.b.r, 0);
+      emit(p, test ? vm_op_calct : vm_op_calc, e->u.b.op, test ? -2 : -1);
+      break;
+    case joqe_ast_kind_negative:
+    case joqe_ast_kind_positive:
+      compile_expr(p, e->u.e, 0);
+      emit(p, test ? vm_op_signt : vm_op_sign,
+           joqe_ast_expr_kind(e) == joqe_ast_kind_negative ? -1 : 1,
+           test ? -1 : 0);
+      break;
+    case joqe_ast_kind_not:
+      compile_expr(p, e->u.e, 1);
+      emit(p, vm_op_not, 0, 0);
+      if(!test)
+        emit(p, vm_op_bool, 0, 1);
+      break;
+    case joqe_ast_kind_context:
+      compile_construct(p, &e->u.c.ctx);
+      at = emit(p, test ? vm_op_ctxt : vm_op_ctx, -1, test ? -1 : 0);
+      pend(p, at, test ? vm_sub_test : vm_sub_expr, e->u.c.e);
+      break;
+    case joqe_ast_kind_path:
+      if(path_compilable(&e->u.path)) {
+        compile_path(p, &e->u.path, test);
+        break;
+      }
+      /* fall through */
+    default:
+      at = emit(p, test ? vm_op_evalt : vm_op_eval, 0, test ? 0 : 1);
+      p->code[at].u.e = e;
+      break;
+  }
+}
+
+static int
+path_flexes(joqe_ast_path *path)
+{
+  joqe_ast_pathelem *i;
+  if(path->punion)
+    return 0;
+  if((i = path->pes)) do {
+    if(joqe_ast_pathelem_kind(i) == joqe_ast_kind_peflex)
+      return 1;
+  } while((i = (joqe_ast_pathelem*)i->ll.n) != path->pes);
+  return 0;
+}
+
+/* Only the first node of an object entry's key and value is used. The
+   cursor takes each path step for all nodes at once, so a descendant
+   search is handed to the tree walker instead, which stops at the first
+   hit. */
+static void
+compile_first(joqe_vm_program *p, joqe_ast_construct *cst)
+{
+  if(joqe_ast_construct_kind(cst) == joqe_ast_kind_expr_construct
+     && joqe_ast_expr_kind(cst->u.expr) == joqe_ast_kind_path
+     && path_flexes(&cst->u.expr->u.path))
+  {
+    int at = emit(p, vm_op_eval, 1, 1);
+    p->code[at].u.e = cst->u.expr;
+  } else {
+    compile_construct(p, cst);
+  }
+}
+
+static void
+compile_construct(joqe_vm_program *p, joqe_ast_construct *cst)
+{
+  int at, count = 0;
+  switch(joqe_ast_construct_kind(cst)) {
+    case joqe_ast_kind_expr_construct:
+      compile_expr(p, cst->u.expr, 0);
+      break;
+    case joqe_ast_kind_object_construct: {
+      joqe_ast_objectls *i;
+      if((i = cst->u.object.ls)) do {
+        compile_construct(p, &i->en.v);
+        count++;
+      } while((i = (joqe_ast_objectls*)i->ll.n) != cst->u.object.ls);
+      emit(p, vm_op_object, count, 1-count);
+    } break;
+    case joqe_ast_kind_array_construct: {
+      joqe_ast_arrayls *i;
+      if((i = cst->u.array.ls)) do {
+        compile_construct(p, &i->en.v);
+        count++;
+      } while((i = (joqe_ast_arrayls*)i->ll.n) != cst->u.array.ls);
+      emit(p, vm_op_array, count, 1-count);
+    } break;
+    case joqe_ast_kind_object_entry:
+      compile_first(p, cst->u.ob.key);
+      compile_first(p, cst->u.ob.value);
+      p->code[emit(p, vm_op_entry, 0, -1)].u.cst = cst;
+      break;
+    case joqe_ast_kind_construct_context:
+      compile_construct(p, cst->u.ctx.context);
+      at = emit(p, vm_op_ctx, -1, 0);
+      pend(p, at, vm_sub_construct, cst->u.ctx.construction);
+      break;
+    default:
+      at = emit(p, vm_op_construct, 0, 1);
+      p->code[at].u.cst = cst;
+      break;
+  }
+}
+
+joqe_vm_program*
+joqe_vm_compile(joqe_ast_construct *root)
+{
+  joqe_vm_program *p = calloc(1, sizeof(*p));
+  int i;
+
+  compile_construct(p, root);
+  emit(p, vm_op_ret, 0, -1);
+
+  // subroutines may add further subroutines while being compiled.
+  for(i = 0; i < p->npending; ++i) {
+    vm_pending pd = p->pending[i];
+    patch(p, pd.at);
+    p->sp = 0;
+    switch(pd.kind) {
+      case vm_sub_expr:
+        compile_expr(p, pd.node, 0);
+        emit(p, vm_op_ret, 0, -1);
+        break;
+      case vm_sub_test:
+        compile_expr(p, pd.node, 1);
+        emit(p, vm_op_rett, 0, 0);
+        break;
+      case vm_sub_construct:
+        compile_construct(p, pd.node);
+        emit(p, vm_op_ret, 0, -1);
+        break;
+    }
+  }
+
+  free(p->pending);
+  p->pending = 0;
+  p->npending = p->cappending = 0;
+  return p;
+}
+
+void
+joqe_vm_destroy(joqe_vm_program *p)
+{
+  if(p) {
+    free(p->code);
+    free(p);
+  }
+}
+
+// --interpreter--
+
+typedef struct {
+  joqe_nodels *ls;
+  int          rv;
+} vm_slot;
+
+#define CURSOR_INLINE 16
+typedef struct {
+  joqe_node **v;
+  int         len, cap;
+  joqe_node  *inl[CURSOR_INLINE];
+} vm_cursor;
+
+static void
+cursor_init(vm_cursor *cu)
+{
+  cu->v = cu->inl;
+  cu->len = 0;
+  cu->cap = CURSOR_INLINE;
+}
+
+static void
+cursor_push(vm_cursor *cu, joqe_node *n)
+{
+  if(cu->len == cu->cap) {
+    cu->cap *= 2;
+    if(cu->v == cu->inl) {
+      cu->v = malloc(sizeof(*cu->v) * cu->cap);
+      memcpy(cu->v, cu->inl, sizeof(cu->inl));
+    } else {
+      cu->v = realloc(cu->v, sizeof(*cu->v) * cu->cap);
+    }
+  }
+  cu->v[cu->len++] = n;
+}
+
+static void
+cursor_free(vm_cursor *cu)
+{
+  if(cu->v != cu->inl)
+    free(cu->v);
+}
+
+static inline int
+container(joqe_node *n)
+{
+  joqe_type t = JOQE_TYPE_VALUE(n->type);
+  return t == joqe_type_none_object || t == joqe_type_none_array;
+}
+
+static joqe_nodels*
+single(joqe_result *f, joqe_node n)
+{
+  joqe_nodels *ls = joqe_result_alloc_node(f);
+  ls->n = n;
+  ls->ll.n = ls->ll.p = &ls->ll;
+  return ls;
+}
+
+static inline void
+append(joqe_nodels **set, joqe_nodels *ls)
+{
+  joqe_list_append((joqe_list**)set, &ls->ll);
+}
+
+// m, a member of a container off by shift (see joqe_members_shift), as
+// a node that lives as long as the run, kept in held if it's made.
+static joqe_node*
+shifted(joqe_node *m, uint32_t shift, joqe_result *f, joqe_nodels **held)
+{
+  if(!shift)
+    return m;
+  joqe_nodels *ls = single(f, *m);
+  ls->n.ord += shift;
+  append(held, ls);
+  return &ls->n;
+}
+
+// preorder: the node itself followed by all its descendants.
+static void
+descend(vm_cursor *dst, joqe_node *m, joqe_result *f, joqe_nodels **held)
+{
+  typedef struct { joqe_nodels *e, *i; uint32_t shift; } iter;
+  iter inl[CURSOR_INLINE], *st = inl;
+  int sp = 0, cap = CURSOR_INLINE;
+
+  cursor_push(dst, m);
+  if(!container(m) || !m->u.ls)
+    return;
+
+  // cursors keep pointers to the members, packed ones need their list.
+  st[sp].e = st[sp].i = joqe_node_members(m);
+  st[sp++].shift = joqe_members_shift(m);
+  while(sp) {
+    joqe_nodels *i = st[sp-1].i;
+    if(!i) {
+      sp--;
+      continue;
+    }
+    st[sp-1].i = (joqe_nodels*)i->ll.n == st[sp-1].e ? 0
+               : (joqe_nodels*)i->ll.n;
+    if(i->n.type == joqe_type_ref_cnt)
+      continue;
+
+    joqe_node *n = shifted(&i->n, st[sp-1].shift, f, held);
+    cursor_push(dst, n);
+    if(container(n) && n->u.ls) {
+      if(sp == cap) {
+        cap *= 2;
+        if(st == inl) {
+          st = malloc(sizeof(iter) * cap);
+          memcpy(st, inl, sizeof(inl));
+        } else {
+          st = realloc(st, sizeof(iter) * cap);
+        }
+      }
+      st[sp].e = st[sp].i = joqe_node_members(n);
+      st[sp++].shift = joqe_members_shift(n);
+    }
+  }
+
+  if(st != inl)
+    free(st);
+}
+
+static int vm_exec(joqe_vm_program *p, int pc, joqe_node *n, joqe_ctx *c,
+                   joqe_result *r);
+
+/* A flex step directly followed by a name or a filter the key index can
+   narrow down takes both steps at once, reading the candidates from the
+   index rather than visiting every descendant. */
+static int
+flex_indexed(joqe_vm_program *p, vm_insn *follow,
+             vm_cursor *cur, vm_cursor *nxt,
+             joqe_ctx *c, joqe_result *f)
+{
+  joqe_index *idx = joqe_ctx_index(c);
+  const char *key;
+  int parents = 0, k;
+
+  if(!idx)
+    return 0;
+  if(follow->op == vm_op_name)
+    key = follow->u.s;
+  else if(follow->op != vm_op_filter
+          || !joqe_ast_filter_key(&follow->u.pe->u.expr, &key, &parents))
+    return 0;
+  for(k = 0; k < cur->len; ++k)
+    if(!joqe_index_node(idx, cur->v[k]))
+      return 0;
+
+  for(k = 0; k < cur->len; ++k) {
+    joqe_node **ls;
+    int count = joqe_index_descendants(idx, cur->v[k], key, parents, &ls);
+    if(follow->op == vm_op_filter)
+      follow->u.pe->epoch++;
+    for(int i = 0; i < count; ++i)
+      if(follow->op == vm_op_name || vm_exec(p, follow->a, ls[i], c, f))
+        cursor_push(nxt, ls[i]);
+    free(ls);
+  }
+  return 1;
+}
+
+static int
+vm_exec(joqe_vm_program *p, int pc, joqe_node *n, joqe_ctx *c,
+        joqe_result *r)
+{
+  vm_slot stack[p->depth+1], *sp = stack;
+  vm_cursor cursors[2], *cur = &cursors[0], *nxt = &cursors[1], *swp;
+  joqe_result f = joqe_result_push(r);
+  joqe_nodels *held = 0; // members of shared subtrees, see shifted()
+  int t = 0, rv = 0, k;
+
+  cursor_init(cur);
+  cursor_init(nxt);
+
+#define PUSH(set, v) do { sp->ls = (set); sp->rv = (v); sp++; } while(0)
+#define SWAP() do { swp = cur; cur = nxt; nxt = swp; } while(0)
+
+  for(;;) {
+    vm_insn *in = &p->code[pc++];
+    switch(in->op) {
+      case vm_op_ret:
+        --sp;
+        assert(sp == stack);
+        rv = sp->rv;
+        if(sp->ls)
+          joqe_list_append((joqe_list**)&r->ls, &sp->ls->ll);
+        goto done;
+      case vm_op_rett:
+        assert(sp == stack);
+        rv = t;
+        goto done;
+
+      case vm_op_fix: {
+        joqe_node x = {in->a > 0 ? joqe_type_none_true
+                     : in->a < 0 ? joqe_type_none_null
+                     : joqe_type_none_false, .u = {.i = in->a}};
+        PUSH(single(&f, x), in->a > 0);
+      } break;
+      case vm_op_string: {
+        joqe_node x = {joqe_type_none_string, .u = {.s = in->u.s}};
+        PUSH(single(&f, x), !!*in->u.s);
+      } break;
+      case vm_op_stringls: {
+        // copy the tree node itself, the reference count lives there.
+        joqe_node *s = &in->u.e->u.n;
+        PUSH(single(&f, joqe_result_copy_node(s)), s->u.ls ? 1 : 0);
+      } break;
+      case vm_op_integer: {
+        joqe_node x = {joqe_type_none_integer, .u = {.i = in->u.i}};
+        PUSH(single(&f, x), in->u.i != 0);
+      } break;
+      case vm_op_real: {
+        joqe_node x = {joqe_type_none_real, .u = {.d = in->u.d}};
+        PUSH(single(&f, x), 0);
+      } break;
+      case vm_op_eval: {
+        joqe_result sub = joqe_result_push(&f);
+        sub.first = in->a;
+        sp->rv = in->u.e->evaluate(in->u.e, n, c, &sub);
+        sp->ls = sub.ls;
+        sub.ls = 0;
+        joqe_result_pop(&f, &sub);
+        sp++;
+      } break;
+      case vm_op_evalt:
+        t = in->u.e->evaluate(in->u.e, n, c, 0);
+        break;
+      case vm_op_construct: {
+        joqe_result sub = joqe_result_push(&f);
+        sp->rv = in->u.cst->construct(in->u.cst, n, c, &sub);
+        sp->ls = sub.ls;
+        sub.ls = 0;
+        joqe_result_pop(&f, &sub);
+        sp++;
+      } break;
+
+      case vm_op_testkey:
+        t = JOQE_TYPE_KEY(n->type) == joqe_type_string_none
+          && joqe_member_key(n) && 0 == strcmp(joqe_member_key(n), in->u.s);
+        break;
+      case vm_op_testidx:
+        t = JOQE_TYPE_KEY(n->type) == joqe_type_int_none
+          && n->k.idx == in->u.i;
+        break;
+      case vm_op_testfix:
+        t = in->a;
+        break;
+
+      case vm_op_compare:
+      case vm_op_comparet: {
+        vm_slot b = *--sp, a = *--sp;
+        int x = joqe_ast_compare_sets(in->a, a.ls, b.ls);
+        joqe_result_free_list(a.ls, &f);
+        joqe_result_free_list(b.ls, &f);
+        if(in->op == vm_op_compare) {
+          joqe_node x_ = {x ? joqe_type_none_true : joqe_type_none_false};
+          PUSH(single(&f, x_), x);
+        } else {
+          t = x;
+        }
+      } break;
+      case vm_op_calc:
+      case vm_op_calct: {
+        vm_slot b = *--sp, a = *--sp;
+        joqe_nodels *li, *ri, *out = 0;
+        int x = 0;
+        if((li = a.ls)) do {
+          if((ri = b.ls)) do {
+            joqe_node rx;
+            if(!joqe_ast_calc_nodes(in->a, &li->n, &ri->n, &rx))
+              continue;
+            if(in->op == vm_op_calc) {
+              x++;
+              append(&out, single(&f, rx));
+            } else if(joqe_ast_bool_node(rx, n)) {
+              x = 1;
+              goto calculated;
+            }
+          } while((ri = (joqe_nodels*)ri->ll.n) != b.ls);
+        } while((li = (joqe_nodels*)li->ll.n) != a.ls);
+        calculated:
+        joqe_result_free_list(a.ls, &f);
+        joqe_result_free_list(b.ls, &f);
+        if(in->op == vm_op_calc) PUSH(out, x);
+        else t = x;
+      } break;
+      case vm_op_sign:
+      case vm_op_signt: {
+        vm_slot a = *--sp;
+        joqe_nodels *i, *out = 0;
+        int x = 0;
+        if((i = a.ls)) do {
+          joqe_node rx;
+          if(!joqe_ast_sign_node(in->a, &i->n, &rx))
+            continue;
+          if(in->op == vm_op_sign) {
+            x++;
+            append(&out, single(&f, rx));
+          } else if(joqe_ast_bool_node(rx, n)) {
+            x = 1;
+            break;
+          }
+        } while((i = (joqe_nodels*)i->ll.n) != a.ls);
+        joqe_result_free_list(a.ls, &f);
+        if(in->op == vm_op_sign) PUSH(out, x);
+        else t = x;
+      } break;
+      case vm_op_not:
+        t = !t;
+        break;
+      case vm_op_bool: {
+        joqe_node x = {t ? joqe_type_none_true : joqe_type_none_false};
+        PUSH(single(&f, x), t);
+      } break;
+
+      case vm_op_jf:
+        if(!t) pc = in->a;
+        break;
+      case vm_op_jt:
+        if(t) pc = in->a;
+        break;
+      case vm_op_jfempty:
+        if(!t) {
+          PUSH(0, 0);
+          pc = in->a;
+        }
+        break;
+      case vm_op_jrv:
+        if(sp[-1].rv) pc = in->a;
+        break;
+      case vm_op_drop:
+        --sp;
+        joqe_result_free_list(sp->ls, &f);
+        break;
+      case vm_op_concat:
+        --sp;
+        if(sp->ls)
+          append(&sp[-1].ls, sp->ls);
+        sp[-1].rv += sp->rv;
+        break;
+      case vm_op_union:
+        sp[-1].rv = joqe_result_union(&sp[-1].ls, &f);
+        break;
+
+      case vm_op_ctx:
+      case vm_op_ctxt: {
+        vm_slot a = *--sp;
+        joqe_nodels *i;
+        int x = 0;
+        // f.ls is otherwise unused, let it collect the subroutine results.
+        assert(!f.ls);
+        if((i = a.ls)) do {
+          joqe_ctx stacked = {c, &i->n};
+          x += vm_exec(p, in->a, &i->n, &stacked, &f);
+        } while((i = (joqe_nodels*)i->ll.n) != a.ls);
+        joqe_result_free_list(a.ls, &f);
+        if(in->op == vm_op_ctx) {
+          PUSH(f.ls, x);
+          f.ls = 0;
+        } else {
+          t = x;
+        }
+      } break;
+
+      case vm_op_local:
+        cur->len = 0;
+        cursor_push(cur, n);
+        break;
+      case vm_op_context: {
+        joqe_ctx *cc = c;
+        for(k = in->a; k > 0 && cc; --k)
+          cc = cc->stack;
+        cur->len = 0;
+        if(cc)
+          cursor_push(cur, cc->node);
+      } break;
+      case vm_op_name:
+        nxt->len = 0;
+        for(k = 0; k < cur->len; ++k) {
+          joqe_node *m = cur->v[k], *sm;
+          joqe_nodels *i, *e;
+          if(JOQE_TYPE_VALUE(m->type) != joqe_type_none_object)
+            continue;
+          uint32_t shift = joqe_members_shift(m);
+          // cursors keep pointers to the members, records need their list.
+          int found = JOQE_TYPE_PACKED(m->type) ? -1
+            : joqe_shape_member(m, in->u.s, &in->shape, &sm, 0);
+          if(found >= 0) {
+            if(found)
+              cursor_push(nxt, shifted(sm, shift, &f, &held));
+            continue;
+          }
+          if((e = i = joqe_node_members(m))) do {
+            if(JOQE_TYPE_KEY(i->n.type) == joqe_type_string_none
+               && 0 == strcmp(joqe_member_key(&i->n), in->u.s))
+              cursor_push(nxt, shifted(&i->n, shift, &f, &held));
+          } while((i = (joqe_nodels*)i->ll.n) != e);
+        }
+        SWAP();
+        break;
+      case vm_op_flex:
+        nxt->len = 0;
+        if(flex_indexed(p, &p->code[pc], cur, nxt, c, &f)) {
+          // the name or filter step has been taken as well.
+          pc++;
+        } else {
+          for(k = 0; k < cur->len; ++k)
+            descend(nxt, cur->v[k], &f, &held);
+        }
+        SWAP();
+        break;
+      case vm_op_filter:
+        nxt->len = 0;
+        for(k = 0; k < cur->len; ++k) {
+          joqe_node *m = cur->v[k];
+          joqe_nodels *i, *e;
+          if(!container(m))
+            continue;
+          uint32_t shift = joqe_members_shift(m);
+          in->u.pe->epoch++;
+          if((e = i = joqe_node_members(m))) do {
+            if(i->n.type == joqe_type_ref_cnt)
+              continue;
+            joqe_node tmp, *x = joqe_member_shifted(&i->n, shift, &tmp);
+            if(vm_exec(p, in->a, x, c, &f))
+              cursor_push(nxt, shifted(&i->n, shift, &f, &held));
+          } while((i = (joqe_nodels*)i->ll.n) != e);
+        }
+        SWAP();
+        break;
+      case vm_op_path: {
+        joqe_nodels *out = 0;
+        for(k = 0; k < cur->len; ++k)
+          append(&out, single(&f, joqe_result_copy_node(cur->v[k])));
+        PUSH(out, cur->len);
+      } break;
+      case vm_op_patht:
+        t = cur->len > 0;
+        break;
+
+      case vm_op_object:
+      case vm_op_array: {
+        joqe_nodels *ls = 0;
+        sp -= in->a;
+        for(k = 0; k < in->a; ++k)
+          if(sp[k].ls)
+            append(&ls, sp[k].ls);
+
+        joqe_node o = {in->op == vm_op_object ? joqe_type_none_object
+                                              : joqe_type_none_array,
+                       .u = {.ls = ls}};
+        if(in->op == vm_op_array) {
+          int idx = 0;
+          joqe_nodels *ni;
+          if((ni = ls)) do {
+            ni->n.type = JOQE_TYPE(joqe_type_int_none, ni->n.type);
+            ni->n.k.idx = idx++;
+            ni->n.ord = 0;
+          } while((ni = (joqe_nodels*)ni->ll.n) != ls);
+        }
+        PUSH(single(&f, o), 1);
+      } break;
+      case vm_op_entry: {
+        vm_slot v = *--sp, key = *--sp;
+        joqe_nodels *en = 0;
+        joqe_node k;
+        if(key.ls && v.ls && joqe_ast_entry_key(in->u.cst, &key.ls->n, &k)) {
+          en = (joqe_nodels*) joqe_list_detach((joqe_list**)&v.ls, &v.ls->ll);
+          joqe_member_keyed(&en->n, &k);
+          en->n.ord = 0;
+        }
+        joqe_result_free_list(key.ls, &f);
+        joqe_result_free_list(v.ls, &f);
+        PUSH(en, en ? 1 : 0);
+      } break;
+    }
+  }
+#undef SWAP
+#undef PUSH
+
+  done:
+  cursor_free(cur);
+  cursor_free(nxt);
+  joqe_result_free_list(held, &f);
+  joqe_result_pop(r, &f);
+  return rv;
+}
+
+int
+joqe_vm_run(joqe_vm_program *p, joqe_node *n, joqe_ctx *c, joqe_result *r)
+{
+  if(r)
+    return vm_exec(p, 0, n, c, r);
+
+  joqe_result tmp = {};
+  int rv = vm_exec(p, 0, n, c, &tmp);
+  joqe_result_destroy(&tmp);
+  return rv;
+}
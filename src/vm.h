@@ -0,0 +1,15 @@
+#ifndef __JOQE_VM_H__
+#define __JOQE_VM_H__
+
+#include "ast.h"
+
+typedef struct joqe_vm_program joqe_vm_program;
+
+joqe_vm_program*  joqe_vm_compile (joqe_ast_construct *root);
+int               joqe_vm_run     (joqe_vm_program    *prog,
+                                   joqe_node          *n,
+                                   joqe_ctx           *c,
+                                   joqe_result        *r);
+void              joqe_vm_destroy (joqe_vm_program    *prog);
+
+#endif /* idempotent include guard */